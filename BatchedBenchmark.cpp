@@ -0,0 +1,79 @@
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Matrix.h"
+#include "MatrixBatch.h"
+
+// Usage: BatchedBenchmark [sizes...] [--count=N] [--simd=scalar|avx2|avx512]
+// Prints GFLOP/s of BatchedMultiply on `count` independent n x n double products against
+// a loop calling Matrix<double>::operator* on each pair.
+
+double GFlops(size_t count, size_t n, double seconds) {
+    return 2.0 * count * n * n * n / seconds * 1e-9;
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    size_t count = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--count=", 0) == 0) {
+            count = std::stoul(arg.substr(8));
+        } else if (!ParseSimdFlag(arg)) {
+            sizes.push_back(std::stoul(arg));
+        }
+    }
+    if (sizes.empty()) {
+        sizes = {8, 16, 32, 64};
+    }
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    std::cout << std::setw(6) << "n" << std::setw(8) << "count" << std::setw(14) << "loop" << std::setw(14)
+              << "batched" << std::setw(10) << "speedup" << "   (GFLOP/s)\n";
+    for (size_t n : sizes) {
+        // About 2^28 multiply-adds per size unless given
+        size_t batch = count != 0 ? count : std::max((static_cast<size_t>(1) << 28) / (n * n * n),
+                                                     static_cast<size_t>(1));
+        std::vector<Matrix<double>> a, b, loop;
+        MatrixBatch<double> batchA(batch, n, n), batchB(batch, n, n), batchC(batch, n, n);
+        for (size_t index = 0; index != batch; ++index) {
+            a.emplace_back(n, n);
+            b.emplace_back(n, n);
+            for (size_t i = 0; i != n; ++i) {
+                for (size_t j = 0; j != n; ++j) {
+                    a.back()[i][j] = dist(rng);
+                    b.back()[i][j] = dist(rng);
+                }
+            }
+            batchA.Set(index, a.back());
+            batchB.Set(index, b.back());
+        }
+
+        double loopTime = Seconds([&] {
+            for (size_t index = 0; index != batch; ++index) {
+                loop.push_back(a[index] * b[index]);
+            }
+        });
+        double batchedTime = Seconds([&] { BatchedMultiply(batchA, batchB, batchC); });
+
+        double maxError = 0;
+        for (size_t index = 0; index != batch; ++index) {
+            for (size_t i = 0; i != n; ++i) {
+                for (size_t j = 0; j != n; ++j) {
+                    maxError = std::max(maxError, std::abs(loop[index][i][j] - batchC.At(index, i, j)));
+                }
+            }
+        }
+        std::cout << std::setw(6) << n << std::setw(8) << batch << std::fixed << std::setprecision(2)
+                  << std::setw(14) << GFlops(batch, n, loopTime)
+                  << std::setw(14) << GFlops(batch, n, batchedTime)
+                  << std::setw(9) << loopTime / batchedTime << 'x'
+                  << "   max error " << std::scientific << maxError << std::defaultfloat << '\n';
+    }
+}
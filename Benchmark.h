@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#include "MatrixSimd.h"
+
+// Helpers shared by the *Benchmark.cpp programs
+
+// Mean wall time of repeats calls of function
+template<typename Function>
+double Seconds(Function&& function, size_t repeats = 1) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i != repeats; ++i) {
+        function();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+}
+
+// Applies --simd=scalar|avx2|avx512 and returns true, false for any other argument. A level the
+// CPU lacks is lowered to the detected one with a warning.
+inline bool ParseSimdFlag(const std::string& arg) {
+    if (arg.rfind("--simd=", 0) != 0) {
+        return false;
+    }
+    std::string level = arg.substr(7);
+    SimdLevel requested = level == "avx512" ? SimdLevel::Avx512 :
+                          level == "avx2" ? SimdLevel::Avx2 : SimdLevel::Scalar;
+    if (SetSimdLevel(requested) != requested) {
+        std::cerr << arg << " isn't supported by this CPU, using the detected level\n";
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+
+// Complex is the long double one; the FFT in PolynomialMultiply.h works on ComplexNumber<double>
+template<typename Real>
+struct ComplexNumber {
+  Real re = 0, im = 0;
+  ComplexNumber(Real _re = 0, Real _im = 0) : re(_re), im(_im) {}
+
+  Real abs() const {
+      return std::sqrt(re * re + im * im);
+  }
+
+  ComplexNumber conj() const {
+      return ComplexNumber(re, -im);
+  }
+
+  ComplexNumber operator+(const ComplexNumber other) const {
+      return ComplexNumber(re + other.re, im + other.im);
+  }
+  ComplexNumber operator-(const ComplexNumber other) const {
+      return ComplexNumber(re - other.re, im - other.im);
+  }
+  ComplexNumber operator*(const ComplexNumber other) const {
+      return ComplexNumber(re * other.re - im * other.im, re * other.im + im * other.re);
+  }
+  ComplexNumber operator/(const ComplexNumber other) const {
+      Real z = other.re * other.re + other.im * other.im;
+      return ComplexNumber((re * other.re + im * other.im) / z, (im * other.re - re * other.im) / z);
+  }
+  bool operator==(const ComplexNumber other) const {
+      return ((re == other.re) && (im == other.im));
+  }
+  bool operator!=(const ComplexNumber other) const {
+      return !(*this == other);
+  }
+
+  // Friends rather than templates, so a plain number on the left still converts to Real
+  friend ComplexNumber operator-(const Real ch, const ComplexNumber other) {
+      return ComplexNumber(ch) - other;
+  }
+  friend ComplexNumber operator+(const Real ch, const ComplexNumber other) {
+      return ComplexNumber(ch) + other;
+  }
+  friend ComplexNumber operator*(const Real ch, const ComplexNumber other) {
+      return ComplexNumber(ch) * other;
+  }
+  friend ComplexNumber operator/(const Real ch, const ComplexNumber other) {
+      return ComplexNumber(ch) / other;
+  }
+  friend bool operator==(const Real ch, const ComplexNumber other) {
+      return ComplexNumber(ch) == other;
+  }
+  friend bool operator!=(const Real ch, const ComplexNumber other) {
+      return ComplexNumber(ch) != other;
+  }
+};
+
+using Complex = ComplexNumber<long double>;
+
+template<typename Real>
+std::ostream& operator<<(std::ostream &out, const ComplexNumber<Real> ch) {
+    out << ch.re << ' ' << ch.im;
+    return out;
+}
+
+template<typename Real>
+std::istream& operator>>(std::istream &in, ComplexNumber<Real> &ch) {
+    in >> ch.re >> ch.im;
+    return in;
+}
@@ -0,0 +1,577 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Gemm.h"
+#include "Matrix.h"
+#include "Reduction.h"
+#include "ThreadPool.h"
+
+// Cholesky (A = L L^T) and Householder QR (A = QR) factorizations, blocked so that all but
+// a thin panel of the work is done by the parallel Gemm. Companions of LuDecomposition.
+
+constexpr size_t kCholeskyBlock = 64;
+constexpr size_t kQrBlock = 16;
+// Row chunk of the tall-skinny least squares, small enough to stay in L2 while it's factored
+constexpr size_t kTsqrRows = 1024;
+
+template<typename ValueType = double>
+class CholeskyDecomposition {
+ public:
+    explicit CholeskyDecomposition(const Matrix<ValueType>& matrix);
+
+    [[nodiscard]] size_t Size() const;
+
+    // False when a nonpositive pivot stopped the factorization
+    [[nodiscard]] bool PositiveDefinite() const;
+
+    // Lower triangular L, zeros above the diagonal
+    const Matrix<ValueType>& Factor() const;
+
+    ValueType Determinant() const;
+
+    std::vector<ValueType> Solve(const std::vector<ValueType>& rhs) const;
+
+    Matrix<ValueType> Solve(const Matrix<ValueType>& rhs) const;
+ private:
+    // Unblocked factorization of the diagonal block at (from, from)
+    bool FactorDiagonal(size_t from, size_t width);
+
+    Matrix<ValueType> l;
+    bool positiveDefinite = true;
+};
+
+template<typename ValueType>
+CholeskyDecomposition<ValueType>::CholeskyDecomposition(const Matrix<ValueType>& matrix) : l(matrix) {
+    if (l.Rows() != l.Columns()) {
+        THROW(invalid_argument, "Only square matrices can be factored")
+    }
+    size_t n = Size();
+    for (size_t k = 0; k < n; k += kCholeskyBlock) {
+        size_t width = std::min(kCholeskyBlock, n - k);
+        if (!FactorDiagonal(k, width)) {
+            positiveDefinite = false;
+            break;
+        }
+        size_t next = k + width;
+        if (next == n) {
+            break;
+        }
+        // L21 = A21 L11^-T, rows are independent
+        size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / (width * width), static_cast<size_t>(1));
+        ThreadPool::Instance().ParallelFor(next, n, grain, [&](size_t from, size_t to) {
+            for (size_t i = from; i != to; ++i) {
+                ValueType* row = l[i].data();
+                for (size_t j = k; j != next; ++j) {
+                    ValueType sum = row[j];
+                    for (size_t p = k; p != j; ++p) {
+                        sum -= row[p] * l[j][p];
+                    }
+                    row[j] = sum / l[j][j];
+                }
+            }
+        });
+        // A22 -= L21 L21^T, one block row at a time so only the lower triangle is computed
+        for (size_t i = next; i < n; i += kCholeskyBlock) {
+            size_t height = std::min(kCholeskyBlock, n - i);
+            Gemm(height, i + height - next, width, ValueType(-1),
+                 l.Data() + i * n + k, n, static_cast<size_t>(1),
+                 l.Data() + next * n + k, static_cast<size_t>(1), n,
+                 l.Data() + i * n + next, n);
+        }
+    }
+    for (size_t i = 0; i != n; ++i) {
+        std::fill(l[i].begin() + i + 1, l[i].end(), ValueType(0));
+    }
+}
+
+template<typename ValueType>
+bool CholeskyDecomposition<ValueType>::FactorDiagonal(size_t from, size_t width) {
+    using std::sqrt;
+    for (size_t j = from; j != from + width; ++j) {
+        ValueType diagonal = l[j][j];
+        for (size_t p = from; p != j; ++p) {
+            diagonal -= l[j][p] * l[j][p];
+        }
+        if (!(diagonal > ValueType(0))) {
+            return false;
+        }
+        l[j][j] = sqrt(diagonal);
+        for (size_t i = j + 1; i != from + width; ++i) {
+            ValueType sum = l[i][j];
+            for (size_t p = from; p != j; ++p) {
+                sum -= l[i][p] * l[j][p];
+            }
+            l[i][j] = sum / l[j][j];
+        }
+    }
+    return true;
+}
+
+template<typename ValueType>
+size_t CholeskyDecomposition<ValueType>::Size() const {
+    return l.Rows();
+}
+
+template<typename ValueType>
+bool CholeskyDecomposition<ValueType>::PositiveDefinite() const {
+    return positiveDefinite;
+}
+
+template<typename ValueType>
+const Matrix<ValueType>& CholeskyDecomposition<ValueType>::Factor() const {
+    return l;
+}
+
+template<typename ValueType>
+ValueType CholeskyDecomposition<ValueType>::Determinant() const {
+    if (!positiveDefinite) {
+        THROW(runtime_error, "Matrix is not positive definite")
+    }
+    ValueType ans(1);
+    for (size_t i = 0; i != Size(); ++i) {
+        ans *= l[i][i] * l[i][i];
+    }
+    return ans;
+}
+
+template<typename ValueType>
+Matrix<ValueType> CholeskyDecomposition<ValueType>::Solve(const Matrix<ValueType>& rhs) const {
+    if (rhs.Rows() != Size()) {
+        THROW(out_of_range, "Right-hand side differs in size")
+    }
+    if (!positiveDefinite) {
+        THROW(runtime_error, "Matrix is not positive definite")
+    }
+    size_t n = Size(), width = rhs.Columns();
+    Matrix<ValueType> x(rhs);
+    size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / (kCholeskyBlock * kCholeskyBlock),
+                            static_cast<size_t>(1));
+    // L y = b
+    for (size_t k = 0; k < n; k += kCholeskyBlock) {
+        size_t height = std::min(kCholeskyBlock, n - k);
+        if (k != 0) {
+            Gemm(height, width, k, ValueType(-1),
+                 l.Data() + k * n, n, static_cast<size_t>(1),
+                 x.Data(), x.Stride(), static_cast<size_t>(1),
+                 x.Data() + k * x.Stride(), x.Stride());
+        }
+        ThreadPool::Instance().ParallelFor(0, width, grain, [&](size_t from, size_t to) {
+            for (size_t i = k; i != k + height; ++i) {
+                ValueType* row = x[i].data();
+                for (size_t j = k; j != i; ++j) {
+                    for (size_t c = from; c != to; ++c) {
+                        row[c] -= l[i][j] * x[j][c];
+                    }
+                }
+                for (size_t c = from; c != to; ++c) {
+                    row[c] /= l[i][i];
+                }
+            }
+        });
+    }
+    // L^T x = y, the transposed factor is read through Gemm strides
+    for (size_t end = n; end != 0;) {
+        size_t height = std::min(kCholeskyBlock, end);
+        size_t k = end - height;
+        if (end != n) {
+            Gemm(height, width, n - end, ValueType(-1),
+                 l.Data() + end * n + k, static_cast<size_t>(1), n,
+                 x.Data() + end * x.Stride(), x.Stride(), static_cast<size_t>(1),
+                 x.Data() + k * x.Stride(), x.Stride());
+        }
+        ThreadPool::Instance().ParallelFor(0, width, grain, [&](size_t from, size_t to) {
+            for (size_t i = end; i-- != k;) {
+                ValueType* row = x[i].data();
+                for (size_t j = i + 1; j != end; ++j) {
+                    for (size_t c = from; c != to; ++c) {
+                        row[c] -= l[j][i] * x[j][c];
+                    }
+                }
+                for (size_t c = from; c != to; ++c) {
+                    row[c] /= l[i][i];
+                }
+            }
+        });
+        end = k;
+    }
+    return x;
+}
+
+template<typename ValueType>
+std::vector<ValueType> CholeskyDecomposition<ValueType>::Solve(const std::vector<ValueType>& rhs) const {
+    Matrix<ValueType> column(rhs.size(), 1);
+    std::copy(rhs.begin(), rhs.end(), column.Data());
+    Matrix<ValueType> x = Solve(column);
+    return {x.Data(), x.Data() + x.Rows()};
+}
+
+// Reflector H = I - tau v v^T with H x = (beta, 0, ..., 0) and v[0] = 1. x (length elements,
+// stride apart) is overwritten with beta followed by v[1..], tau is returned (zero if H = I).
+template<typename ValueType>
+ValueType HouseholderReflector(size_t length, ValueType* x, size_t stride) {
+    using std::sqrt;
+    ValueType sigma(0);
+    for (size_t i = 1; i < length; ++i) {
+        sigma += x[i * stride] * x[i * stride];
+    }
+    if (sigma == ValueType(0)) {
+        return ValueType(0);
+    }
+    ValueType alpha = x[0];
+    ValueType norm = sqrt(alpha * alpha + sigma);
+    ValueType beta = alpha > ValueType(0) ? -norm : norm;
+    ValueType scale = ValueType(1) / (alpha - beta);
+    for (size_t i = 1; i < length; ++i) {
+        x[i * stride] *= scale;
+    }
+    x[0] = beta;
+    return (beta - alpha) / beta;
+}
+
+// w = V^T c for the height x width block of reflectors v (unit diagonal, zeros above it, as
+// stored by HouseholderQr) and a height x columns block c. w is width x columns, dense.
+template<typename ValueType>
+void HouseholderProjection(size_t height, size_t width, const ValueType* v, size_t ldv,
+                           const ValueType* c, size_t ldc, size_t columns, ValueType* w) {
+    std::fill(w, w + width * columns, ValueType(0));
+    if (height > width) {
+        Gemm(width, columns, height - width, ValueType(1),
+             v + width * ldv, static_cast<size_t>(1), ldv,
+             c + width * ldc, ldc, static_cast<size_t>(1), w, columns);
+    }
+    for (size_t i = 0; i != width; ++i) {
+        const ValueType* row = c + i * ldc;
+        for (size_t p = 0; p <= i; ++p) {
+            const ValueType factor = p == i ? ValueType(1) : v[i * ldv + p];
+            ValueType* out = w + p * columns;
+            for (size_t j = 0; j != columns; ++j) {
+                out[j] += factor * row[j];
+            }
+        }
+    }
+}
+
+// c -= V w, the counterpart of HouseholderProjection
+template<typename ValueType>
+void HouseholderSubtract(size_t height, size_t width, const ValueType* v, size_t ldv,
+                         const ValueType* w, size_t columns, ValueType* c, size_t ldc) {
+    if (height > width) {
+        Gemm(height - width, columns, width, ValueType(-1),
+             v + width * ldv, ldv, static_cast<size_t>(1),
+             w, columns, static_cast<size_t>(1), c + width * ldc, ldc);
+    }
+    for (size_t i = 0; i != width; ++i) {
+        ValueType* row = c + i * ldc;
+        for (size_t p = 0; p <= i; ++p) {
+            const ValueType factor = p == i ? ValueType(1) : v[i * ldv + p];
+            const ValueType* in = w + p * columns;
+            for (size_t j = 0; j != columns; ++j) {
+                row[j] -= factor * in[j];
+            }
+        }
+    }
+}
+
+// Upper triangular T of the compact WY form H_1 ... H_width = I - V T V^T
+template<typename ValueType>
+Matrix<ValueType> HouseholderBlockFactor(size_t height, size_t width, const ValueType* v, size_t ldv,
+                                         const ValueType* tau) {
+    // Gram matrix of the reflectors, g[p][j] = v_p . v_j, only p < j is used
+    Matrix<ValueType> g(width, width), t(width, width);
+    if (height > width) {
+        Gemm(width, width, height - width, ValueType(1),
+             v + width * ldv, static_cast<size_t>(1), ldv,
+             v + width * ldv, ldv, static_cast<size_t>(1), g.Data(), g.Stride());
+    }
+    for (size_t i = 0; i != width; ++i) {
+        for (size_t j = 0; j <= i; ++j) {
+            const ValueType vj = j == i ? ValueType(1) : v[i * ldv + j];
+            for (size_t p = 0; p != j; ++p) {
+                g[p][j] += v[i * ldv + p] * vj;
+            }
+        }
+    }
+    for (size_t j = 0; j != width; ++j) {
+        t[j][j] = tau[j];
+        for (size_t i = 0; i != j; ++i) {
+            ValueType sum(0);
+            for (size_t p = i; p != j; ++p) {
+                sum += t[i][p] * g[p][j];
+            }
+            t[i][j] = -tau[j] * sum;
+        }
+    }
+    return t;
+}
+
+// c = (I - V T V^T)^T c = Q^T c for one block of reflectors
+template<typename ValueType>
+void HouseholderApplyTransposed(size_t height, size_t width, const ValueType* v, size_t ldv,
+                                const Matrix<ValueType>& t, ValueType* c, size_t ldc, size_t columns) {
+    std::vector<ValueType, AlignedAllocator<ValueType>> w(width * columns);
+    HouseholderProjection(height, width, v, ldv, c, ldc, columns, w.data());
+    // w = T^T w, from the last row up so every row still reads the old ones above it
+    for (size_t i = width; i-- != 0;) {
+        ValueType* out = w.data() + i * columns;
+        for (size_t j = 0; j != columns; ++j) {
+            out[j] *= t[i][i];
+        }
+        for (size_t p = 0; p != i; ++p) {
+            const ValueType factor = t[p][i];
+            const ValueType* in = w.data() + p * columns;
+            for (size_t j = 0; j != columns; ++j) {
+                out[j] += factor * in[j];
+            }
+        }
+    }
+    HouseholderSubtract(height, width, v, ldv, w.data(), columns, c, ldc);
+}
+
+// Unblocked QR of a height x width panel, the reflector pass over the rows runs in parallel.
+// v^T A is summed over fixed blocks of rows merged in index order, so the result doesn't depend
+// on the thread count or scheduling.
+template<typename ValueType>
+void HouseholderPanel(size_t height, size_t width, ValueType* a, size_t lda, ValueType* tau) {
+    for (size_t j = 0; j != width && j != height; ++j) {
+        tau[j] = HouseholderReflector(height - j, a + j * lda + j, lda);
+        size_t rest = width - j - 1;
+        if (tau[j] == ValueType(0) || rest == 0) {
+            continue;
+        }
+        // w = v^T A, then A -= tau v w^T on the columns right of j
+        std::vector<ValueType> w(a + j * lda + j + 1, a + j * lda + width);
+        size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / rest, static_cast<size_t>(1));
+        size_t blockRows = std::max(kReductionBlock / rest, static_cast<size_t>(1));
+        std::vector<ValueType> sum = ReduceBlocks(height - j - 1, blockRows, std::vector<ValueType>(rest, ValueType(0)),
+                                                  [&](size_t from, size_t to) {
+            std::vector<ValueType> partial(rest, ValueType(0));
+            for (size_t i = j + 1 + from; i != j + 1 + to; ++i) {
+                const ValueType* row = a + i * lda;
+                for (size_t c = 0; c != rest; ++c) {
+                    partial[c] += row[j] * row[j + 1 + c];
+                }
+            }
+            return partial;
+        }, [](std::vector<ValueType> first, const std::vector<ValueType>& second) {
+            for (size_t c = 0; c != first.size(); ++c) {
+                first[c] += second[c];
+            }
+            return first;
+        });
+        for (size_t c = 0; c != rest; ++c) {
+            w[c] = (w[c] + sum[c]) * tau[j];
+            a[j * lda + j + 1 + c] -= w[c];
+        }
+        ThreadPool::Instance().ParallelFor(j + 1, height, grain, [&](size_t from, size_t to) {
+            for (size_t i = from; i != to; ++i) {
+                ValueType* row = a + i * lda;
+                for (size_t c = 0; c != rest; ++c) {
+                    row[j + 1 + c] -= row[j] * w[c];
+                }
+            }
+        });
+    }
+}
+
+// In-place blocked QR of an m x n block: R on and above the diagonal, reflectors below it,
+// min(m, n) factors in tau. The compact WY factor of every block is appended to blockFactors
+// when it isn't null.
+template<typename ValueType>
+void HouseholderQr(size_t m, size_t n, ValueType* a, size_t lda, ValueType* tau,
+                   std::vector<Matrix<ValueType>>* blockFactors) {
+    size_t steps = std::min(m, n);
+    for (size_t k = 0; k < steps; k += kQrBlock) {
+        size_t width = std::min(kQrBlock, steps - k);
+        ValueType* panel = a + k * lda + k;
+        HouseholderPanel(m - k, width, panel, lda, tau + k);
+        if (k + width == n && blockFactors == nullptr) {
+            continue;
+        }
+        Matrix<ValueType> t = HouseholderBlockFactor(m - k, width, panel, lda, tau + k);
+        if (k + width != n) {
+            HouseholderApplyTransposed(m - k, width, panel, lda, t, panel + width, lda, n - k - width);
+        }
+        if (blockFactors != nullptr) {
+            blockFactors->push_back(std::move(t));
+        }
+    }
+}
+
+// x = R^-1 x for the upper triangular n x n R and n x columns x
+template<typename ValueType>
+void SolveUpperTriangular(size_t n, const ValueType* r, size_t ldr, ValueType* x, size_t ldx, size_t columns) {
+    for (size_t i = n; i-- != 0;) {
+        if (r[i * ldr + i] == ValueType(0)) {
+            THROW(runtime_error, "Matrix is rank deficient")
+        }
+        ValueType* row = x + i * ldx;
+        for (size_t j = i + 1; j != n; ++j) {
+            const ValueType factor = r[i * ldr + j];
+            const ValueType* other = x + j * ldx;
+            for (size_t c = 0; c != columns; ++c) {
+                row[c] -= factor * other[c];
+            }
+        }
+        for (size_t c = 0; c != columns; ++c) {
+            row[c] /= r[i * ldr + i];
+        }
+    }
+}
+
+// A = QR with Q kept as blocks of Householder reflectors in compact WY form
+template<typename ValueType = double>
+class QrDecomposition {
+ public:
+    explicit QrDecomposition(const Matrix<ValueType>& matrix);
+
+    [[nodiscard]] size_t Rows() const;
+
+    [[nodiscard]] size_t Columns() const;
+
+    // min(Rows(), Columns()) x Columns() upper trapezoidal factor
+    Matrix<ValueType> R() const;
+
+    // R on and above the diagonal, Householder vectors below it
+    const Matrix<ValueType>& Factors() const;
+
+    // rhs = Q^T rhs, rhs has Rows() rows
+    void ApplyQTransposed(Matrix<ValueType>& rhs) const;
+
+    // Minimizes |Ax - b| for every column b of rhs, A needs full column rank and Rows() >= Columns()
+    Matrix<ValueType> Solve(const Matrix<ValueType>& rhs) const;
+
+    std::vector<ValueType> Solve(const std::vector<ValueType>& rhs) const;
+ private:
+    Matrix<ValueType> qr;
+    std::vector<ValueType> tau;
+    std::vector<Matrix<ValueType>> blockFactors;
+};
+
+template<typename ValueType>
+QrDecomposition<ValueType>::QrDecomposition(const Matrix<ValueType>& matrix) :
+    qr(matrix), tau(std::min(matrix.Rows(), matrix.Columns())) {
+    HouseholderQr(Rows(), Columns(), qr.Data(), qr.Stride(), tau.data(), &blockFactors);
+}
+
+template<typename ValueType>
+size_t QrDecomposition<ValueType>::Rows() const {
+    return qr.Rows();
+}
+
+template<typename ValueType>
+size_t QrDecomposition<ValueType>::Columns() const {
+    return qr.Columns();
+}
+
+template<typename ValueType>
+Matrix<ValueType> QrDecomposition<ValueType>::R() const {
+    Matrix<ValueType> ans(std::min(Rows(), Columns()), Columns());
+    for (size_t i = 0; i != ans.Rows(); ++i) {
+        std::copy(qr[i].begin() + i, qr[i].end(), ans[i].begin() + i);
+    }
+    return ans;
+}
+
+template<typename ValueType>
+const Matrix<ValueType>& QrDecomposition<ValueType>::Factors() const {
+    return qr;
+}
+
+template<typename ValueType>
+void QrDecomposition<ValueType>::ApplyQTransposed(Matrix<ValueType>& rhs) const {
+    if (rhs.Rows() != Rows()) {
+        THROW(out_of_range, "Right-hand side differs in size")
+    }
+    for (size_t block = 0; block != blockFactors.size(); ++block) {
+        size_t k = block * kQrBlock;
+        HouseholderApplyTransposed(Rows() - k, blockFactors[block].Rows(), qr.Data() + k * qr.Stride() + k,
+                                   qr.Stride(), blockFactors[block], rhs.Data() + k * rhs.Stride(),
+                                   rhs.Stride(), rhs.Columns());
+    }
+}
+
+template<typename ValueType>
+Matrix<ValueType> QrDecomposition<ValueType>::Solve(const Matrix<ValueType>& rhs) const {
+    if (Rows() < Columns()) {
+        THROW(invalid_argument, "Least squares needs at least as many rows as columns")
+    }
+    Matrix<ValueType> projected(rhs);
+    ApplyQTransposed(projected);
+    Matrix<ValueType> ans(Columns(), rhs.Columns());
+    std::copy(projected.Data(), projected.Data() + ans.Rows() * ans.Stride(), ans.Data());
+    SolveUpperTriangular(Columns(), qr.Data(), qr.Stride(), ans.Data(), ans.Stride(), ans.Columns());
+    return ans;
+}
+
+template<typename ValueType>
+std::vector<ValueType> QrDecomposition<ValueType>::Solve(const std::vector<ValueType>& rhs) const {
+    Matrix<ValueType> column(rhs.size(), 1);
+    std::copy(rhs.begin(), rhs.end(), column.Data());
+    Matrix<ValueType> x = Solve(column);
+    return {x.Data(), x.Data() + x.Rows()};
+}
+
+// R of the QR factorization of [a | b] (width x width, width = a.Columns() + b.Columns()).
+// Tall-skinny QR: chunks of rows are copied and factored independently, their R factors are
+// stacked and factored again, so a is read once and never copied as a whole.
+template<typename ValueType>
+Matrix<ValueType> TallSkinnyR(const Matrix<ValueType>& a, const Matrix<ValueType>& b) {
+    size_t m = a.Rows(), width = a.Columns() + b.Columns();
+    size_t chunkRows = std::max(kTsqrRows, 4 * width);
+    size_t chunks = (m + chunkRows - 1) / chunkRows;
+    Matrix<ValueType> stacked(std::max(chunks, static_cast<size_t>(1)) * width, width);
+    ThreadPool::Instance().ParallelFor(0, chunks, 1, [&](size_t from, size_t to) {
+        for (size_t chunk = from; chunk != to; ++chunk) {
+            size_t first = chunk * chunkRows, rows = std::min(chunkRows, m - first);
+            Matrix<ValueType> block(rows, width);
+            for (size_t i = 0; i != rows; ++i) {
+                std::copy(a[first + i].begin(), a[first + i].end(), block[i].begin());
+                std::copy(b[first + i].begin(), b[first + i].end(), block[i].begin() + a.Columns());
+            }
+            std::vector<ValueType> tau(std::min(rows, width));
+            HouseholderQr(rows, width, block.Data(), block.Stride(), tau.data(),
+                          static_cast<std::vector<Matrix<ValueType>>*>(nullptr));
+            for (size_t i = 0; i != std::min(rows, width); ++i) {
+                std::copy(block[i].begin() + i, block[i].end(), stacked[chunk * width + i].begin() + i);
+            }
+        }
+    });
+    if (chunks <= 1) {
+        return Matrix<ValueType>(stacked);
+    }
+    return TallSkinnyR(stacked, Matrix<ValueType>(stacked.Rows(), 0));
+}
+
+// x minimizing |Ax - b| for every column of b, A needs full column rank and at least as many
+// rows as columns. Tall A goes through TallSkinnyR, others through QrDecomposition.
+template<typename ValueType>
+Matrix<ValueType> LeastSquares(const Matrix<ValueType>& a, const Matrix<ValueType>& b) {
+    if (a.Rows() != b.Rows()) {
+        THROW(out_of_range, "Right-hand side differs in size")
+    }
+    if (a.Rows() < a.Columns()) {
+        THROW(invalid_argument, "Least squares needs at least as many rows as columns")
+    }
+    size_t n = a.Columns();
+    if (a.Rows() <= std::max(kTsqrRows, 4 * (n + b.Columns()))) {
+        return QrDecomposition<ValueType>(a).Solve(b);
+    }
+    Matrix<ValueType> r = TallSkinnyR(a, b);
+    Matrix<ValueType> ans(n, b.Columns());
+    for (size_t i = 0; i != n; ++i) {
+        std::copy(r[i].begin() + n, r[i].end(), ans[i].begin());
+    }
+    SolveUpperTriangular(n, r.Data(), r.Stride(), ans.Data(), ans.Stride(), ans.Columns());
+    return ans;
+}
+
+template<typename ValueType>
+std::vector<ValueType> LeastSquares(const Matrix<ValueType>& a, const std::vector<ValueType>& b) {
+    Matrix<ValueType> column(b.size(), 1);
+    std::copy(b.begin(), b.end(), column.Data());
+    Matrix<ValueType> x = LeastSquares(a, column);
+    return {x.Data(), x.Data() + x.Rows()};
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <iostream>
+#include <stdexcept>
+
+#define THROW(TYPE, TEXT) {                                 \
+    std::cerr << "Exception at line " << __LINE__ << '\n'   \
+              << TEXT << '\n';                              \
+    throw std::TYPE("");                                    \
+}
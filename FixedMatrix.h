@@ -0,0 +1,222 @@
+#pragma once
+
+#include <array>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "Matrix.h"
+
+// Small matrix with dimensions fixed at compile time, stored inline like StackVector.
+// Every loop is a fold over an index_sequence, so operations are constexpr and fully unrolled,
+// and the compiler packs the unrolled rows into vector registers. Mismatched dimensions don't
+// compile. Meant for sizes up to about 8x8, larger ones belong in Matrix.
+template<typename ValueType, size_t RowCount, size_t ColumnCount>
+class FixedMatrix {
+ public:
+    using value_type = ValueType;
+
+    constexpr FixedMatrix() : contents{} {}
+
+    constexpr explicit FixedMatrix(const ValueType& value) : contents{} {
+        Unrolled<kSize>([&](size_t k) { contents[k] = value; });
+    }
+
+    // FixedMatrix<int, 2, 2>({{1, 2}, {3, 4}})
+    constexpr FixedMatrix(const ValueType (&values)[RowCount][ColumnCount]) : contents{} {
+        Unrolled<kSize>([&](size_t k) { contents[k] = values[k / ColumnCount][k % ColumnCount]; });
+    }
+
+    explicit FixedMatrix(const Matrix<ValueType>& other) : contents{} {
+        if (other.Rows() != RowCount || other.Columns() != ColumnCount) {
+            THROW(out_of_range, "Matrices differ in size")
+        }
+        for (size_t i = 0; i != RowCount; ++i) {
+            for (size_t j = 0; j != ColumnCount; ++j) {
+                (*this)[i][j] = other[i][j];
+            }
+        }
+    }
+
+    explicit operator Matrix<ValueType>() const {
+        Matrix<ValueType> ans(RowCount, ColumnCount);
+        for (size_t i = 0; i != RowCount; ++i) {
+            for (size_t j = 0; j != ColumnCount; ++j) {
+                ans[i][j] = (*this)[i][j];
+            }
+        }
+        return ans;
+    }
+
+    static constexpr FixedMatrix Unit() {
+        static_assert(RowCount == ColumnCount, "Unit matrix has to be square");
+        FixedMatrix ans;
+        Unrolled<RowCount>([&](size_t i) { ans[i][i] = ValueType(1); });
+        return ans;
+    }
+
+    static constexpr size_t Rows() {
+        return RowCount;
+    }
+
+    static constexpr size_t Columns() {
+        return ColumnCount;
+    }
+
+    constexpr ValueType* Data() {
+        return contents.data();
+    }
+
+    constexpr const ValueType* Data() const {
+        return contents.data();
+    }
+
+    // Pointer to the first element of row idx, so m[i][j] works as for Matrix
+    constexpr ValueType* operator[](size_t idx) {
+        return contents.data() + idx * ColumnCount;
+    }
+
+    constexpr const ValueType* operator[](size_t idx) const {
+        return contents.data() + idx * ColumnCount;
+    }
+
+    constexpr const ValueType& At(size_t i, size_t j) const {
+        return contents[i * ColumnCount + j];
+    }
+
+    constexpr bool operator==(const FixedMatrix& other) const {
+        bool equal = true;
+        Unrolled<kSize>([&](size_t k) { equal = equal && contents[k] == other.contents[k]; });
+        return equal;
+    }
+
+    constexpr bool operator!=(const FixedMatrix& other) const {
+        return !(*this == other);
+    }
+
+    constexpr FixedMatrix operator-() const {
+        FixedMatrix ans;
+        Unrolled<kSize>([&](size_t k) { ans.contents[k] = -contents[k]; });
+        return ans;
+    }
+
+    constexpr FixedMatrix& operator+=(const FixedMatrix& other) {
+        Unrolled<kSize>([&](size_t k) { contents[k] += other.contents[k]; });
+        return *this;
+    }
+
+    constexpr FixedMatrix& operator-=(const FixedMatrix& other) {
+        Unrolled<kSize>([&](size_t k) { contents[k] -= other.contents[k]; });
+        return *this;
+    }
+
+    constexpr FixedMatrix& operator*=(const ValueType& other) {
+        Unrolled<kSize>([&](size_t k) { contents[k] *= other; });
+        return *this;
+    }
+
+    constexpr FixedMatrix& operator/=(const ValueType& other) {
+        Unrolled<kSize>([&](size_t k) { contents[k] /= other; });
+        return *this;
+    }
+
+    constexpr FixedMatrix operator+(const FixedMatrix& other) const {
+        FixedMatrix ans(*this);
+        return ans += other;
+    }
+
+    constexpr FixedMatrix operator-(const FixedMatrix& other) const {
+        FixedMatrix ans(*this);
+        return ans -= other;
+    }
+
+    constexpr FixedMatrix operator*(const ValueType& other) const {
+        FixedMatrix ans(*this);
+        return ans *= other;
+    }
+
+    constexpr FixedMatrix operator/(const ValueType& other) const {
+        FixedMatrix ans(*this);
+        return ans /= other;
+    }
+
+    // Row i of the result is a sum of whole rows of other, which keeps every step a vector operation
+    template<size_t Width>
+    constexpr FixedMatrix<ValueType, RowCount, Width> operator*(
+        const FixedMatrix<ValueType, ColumnCount, Width>& other) const {
+        FixedMatrix<ValueType, RowCount, Width> ans;
+        Unrolled<RowCount>([&](size_t i) {
+            ValueType* out = ans[i];
+            Unrolled<ColumnCount>([&](size_t l) {
+                const ValueType value = At(i, l);
+                const ValueType* row = other[l];
+                Unrolled<Width>([&](size_t j) { out[j] += value * row[j]; });
+            });
+        });
+        return ans;
+    }
+
+    constexpr FixedMatrix& operator*=(const FixedMatrix& other) {
+        static_assert(RowCount == ColumnCount, "Only square matrices can be multiplied in place");
+        return *this = *this * other;
+    }
+
+    constexpr ValueType Tr() const {
+        static_assert(RowCount == ColumnCount, "Trace is defined for square matrices");
+        ValueType ans{};
+        Unrolled<RowCount>([&](size_t i) { ans += At(i, i); });
+        return ans;
+    }
+
+    constexpr FixedMatrix<ValueType, ColumnCount, RowCount> Transponed() const {
+        FixedMatrix<ValueType, ColumnCount, RowCount> ans;
+        Unrolled<kSize>([&](size_t k) { ans[k % ColumnCount][k / ColumnCount] = contents[k]; });
+        return ans;
+    }
+
+    constexpr FixedMatrix Pow(size_t pow) const {
+        static_assert(RowCount == ColumnCount, "Only square matrices have powers");
+        FixedMatrix ans = Unit(), mult(*this);
+        while (pow != 0) {
+            if (pow & 1U) {
+                ans *= mult;
+            }
+            mult *= mult;
+            pow >>= 1U;
+        }
+        return ans;
+    }
+
+ private:
+    static constexpr size_t kSize = RowCount * ColumnCount;
+
+    template<size_t Count, typename Function>
+    static constexpr void Unrolled(Function&& function) {
+        Unrolled(function, std::make_index_sequence<Count>());
+    }
+
+    template<typename Function, size_t... Index>
+    static constexpr void Unrolled(Function& function, std::index_sequence<Index...>) {
+        (function(Index), ...);
+    }
+
+    std::array<ValueType, kSize> contents;
+};
+
+template<typename ValueType, size_t RowCount, size_t ColumnCount>
+constexpr FixedMatrix<ValueType, RowCount, ColumnCount> operator*(
+    const ValueType& first, const FixedMatrix<ValueType, RowCount, ColumnCount>& second) {
+    return second * first;
+}
+
+template<typename ValueType, size_t RowCount, size_t ColumnCount>
+std::ostream& operator<<(std::ostream& out, const FixedMatrix<ValueType, RowCount, ColumnCount>& mrx) {
+    for (size_t i = 0; i != RowCount; ++i) {
+        for (size_t j = 0; j != ColumnCount; ++j) {
+            out << mrx[i][j] << ' ';
+        }
+        out << '\n';
+    }
+    return out;
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "MatrixSimd.h"
+#include "MatrixStorage.h"
+#include "ThreadPool.h"
+
+// Goto-style blocking: B is packed in kc x nc panels (L3), A in mc x kc blocks (L2),
+// the micro-kernel streams one kc x nr sliver of B (L1) against an mr x kc sliver of A.
+// All sizes are in elements and can be changed at runtime through GemmBlockSizes<ValueType>().
+struct GemmBlocking {
+    size_t mc;
+    size_t kc;
+    size_t nc;
+};
+
+template<typename ValueType>
+GemmBlocking& GemmBlockSizes() {
+    static GemmBlocking sizes{96, 256, 4096};
+    return sizes;
+}
+
+// Computes mr x nr tile c += a * b, where a and b are packed slivers of length kc
+template<typename ValueType>
+struct GemmKernel {
+    using Function = void (*)(size_t kc, const ValueType* a, const ValueType* b,
+                              ValueType* c, size_t ldc);
+
+    size_t mr;
+    size_t nr;
+    Function run;
+};
+
+template<typename ValueType, size_t MR, size_t NR>
+void GemmMicroKernel(size_t kc, const ValueType* a, const ValueType* b, ValueType* c, size_t ldc) {
+    ValueType acc[MR][NR]{};
+    for (size_t p = 0; p != kc; ++p) {
+        for (size_t i = 0; i != MR; ++i) {
+            for (size_t j = 0; j != NR; ++j) {
+                acc[i][j] += a[i] * b[j];
+            }
+        }
+        a += MR;
+        b += NR;
+    }
+    for (size_t i = 0; i != MR; ++i) {
+        for (size_t j = 0; j != NR; ++j) {
+            c[i * ldc + j] += acc[i][j];
+        }
+    }
+}
+
+// FMA kernels for float/double when the CPU has them, the generic template otherwise
+template<typename ValueType>
+GemmKernel<ValueType> SelectGemmKernel() {
+    const SimdKernels<ValueType>& simd = SimdKernels<ValueType>::Get();
+    if (simd.gemm != nullptr) {
+        return {simd.mr, simd.nr, simd.gemm};
+    }
+    return {4, 4, GemmMicroKernel<ValueType, 4, 4>};
+}
+
+// Packs rows x cols block of x (element (i, j) at x[i * rs + j * cs]) into slivers of
+// `width` rows, each sliver stored column after column. Tails are padded with zeros.
+template<typename ValueType>
+void GemmPackA(size_t rows, size_t cols, ValueType alpha, const ValueType* x, size_t rs, size_t cs,
+               size_t width, ValueType* packed) {
+    for (size_t from = 0; from < rows; from += width) {
+        size_t count = std::min(width, rows - from);
+        for (size_t p = 0; p != cols; ++p) {
+            const ValueType* column = x + from * rs + p * cs;
+            for (size_t i = 0; i != count; ++i) {
+                packed[i] = alpha * column[i * rs];
+            }
+            for (size_t i = count; i != width; ++i) {
+                packed[i] = ValueType(0);
+            }
+            packed += width;
+        }
+    }
+}
+
+// Same as GemmPackA, but slivers are `width` columns wide and stored row after row
+template<typename ValueType>
+void GemmPackB(size_t rows, size_t cols, const ValueType* x, size_t rs, size_t cs,
+               size_t width, ValueType* packed) {
+    for (size_t from = 0; from < cols; from += width) {
+        size_t count = std::min(width, cols - from);
+        for (size_t p = 0; p != rows; ++p) {
+            const ValueType* row = x + p * rs + from * cs;
+            for (size_t j = 0; j != count; ++j) {
+                packed[j] = row[j * cs];
+            }
+            for (size_t j = count; j != width; ++j) {
+                packed[j] = ValueType(0);
+            }
+            packed += width;
+        }
+    }
+}
+
+// Runs the micro-kernel over packed mc x kc block of A and kc x nc panel of B
+template<typename ValueType>
+void GemmMacroKernel(const GemmKernel<ValueType>& kernel, size_t mc, size_t nc, size_t kc,
+                     const ValueType* packedA, const ValueType* packedB, ValueType* c, size_t ldc) {
+    thread_local std::vector<ValueType> tile;
+    tile.resize(kernel.mr * kernel.nr);
+    for (size_t jr = 0; jr < nc; jr += kernel.nr) {
+        size_t cols = std::min(kernel.nr, nc - jr);
+        for (size_t ir = 0; ir < mc; ir += kernel.mr) {
+            size_t rows = std::min(kernel.mr, mc - ir);
+            const ValueType* a = packedA + ir * kc;
+            const ValueType* b = packedB + jr * kc;
+            ValueType* out = c + ir * ldc + jr;
+            if (rows == kernel.mr && cols == kernel.nr) {
+                kernel.run(kc, a, b, out, ldc);
+                continue;
+            }
+            std::fill(tile.begin(), tile.end(), ValueType(0));
+            kernel.run(kc, a, b, tile.data(), kernel.nr);
+            for (size_t i = 0; i != rows; ++i) {
+                for (size_t j = 0; j != cols; ++j) {
+                    out[i * ldc + j] += tile[i * kernel.nr + j];
+                }
+            }
+        }
+    }
+}
+
+// c += alpha * a * b, a is m x k, b is k x n, c is row-major m x n with leading dimension ldc.
+// Element (i, j) of a is a[i * rsA + j * csA] (same for b), so transposed operands are free.
+template<typename ValueType>
+void Gemm(size_t m, size_t n, size_t k, ValueType alpha,
+          const ValueType* a, size_t rsA, size_t csA,
+          const ValueType* b, size_t rsB, size_t csB,
+          ValueType* c, size_t ldc) {
+    if (m == 0 || n == 0 || k == 0) {
+        return;
+    }
+    const GemmKernel<ValueType> kernel = SelectGemmKernel<ValueType>();
+    const GemmBlocking blocking = GemmBlockSizes<ValueType>();
+    size_t mc = std::max(blocking.mc / kernel.mr, static_cast<size_t>(1)) * kernel.mr;
+    size_t kc = std::max(blocking.kc, static_cast<size_t>(1));
+    size_t nc = std::max(blocking.nc / kernel.nr, static_cast<size_t>(1)) * kernel.nr;
+    nc = std::min(nc, (n + kernel.nr - 1) / kernel.nr * kernel.nr);
+    kc = std::min(kc, k);
+
+    // Tasks are (block of A rows, slice of the B panel) pairs, the panel is sliced only when
+    // there are too few row blocks to keep every thread busy
+    size_t blocksA = (m + mc - 1) / mc;
+    size_t threads = ThreadPool::Instance().ThreadCount();
+    size_t slivers = (nc + kernel.nr - 1) / kernel.nr;
+    size_t slices = std::min(std::max(threads / blocksA, static_cast<size_t>(1)), slivers);
+    ArenaScope scope;
+    std::vector<ValueType, ArenaAllocator<ValueType>> packedB(kc * nc);
+
+    for (size_t jc = 0; jc < n; jc += nc) {
+        size_t ncCur = std::min(nc, n - jc);
+        size_t sliversCur = (ncCur + kernel.nr - 1) / kernel.nr;
+        for (size_t pc = 0; pc < k; pc += kc) {
+            size_t kcCur = std::min(kc, k - pc);
+            GemmPackB(kcCur, ncCur, b + pc * rsB + jc * csB, rsB, csB, kernel.nr, packedB.data());
+
+            size_t taskWork = std::min(mc, m) * kcCur * ncCur / slices + 1;
+            size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / taskWork, static_cast<size_t>(1));
+            ThreadPool::Instance().ParallelFor(0, blocksA * slices, grain, [&](size_t from, size_t to) {
+                // Chunks never yield to other tasks, so a per-thread buffer can't be clobbered
+                thread_local std::vector<ValueType, AlignedAllocator<ValueType>> packedA;
+                packedA.resize(std::max(packedA.size(), mc * kcCur));
+                size_t packedBlock = static_cast<size_t>(-1);
+                for (size_t task = from; task != to; ++task) {
+                    size_t block = task / slices, slice = task % slices;
+                    size_t ic = block * mc;
+                    size_t mcCur = std::min(mc, m - ic);
+                    if (block != packedBlock) {
+                        GemmPackA(mcCur, kcCur, alpha, a + ic * rsA + pc * csA, rsA, csA,
+                                  kernel.mr, packedA.data());
+                        packedBlock = block;
+                    }
+                    size_t firstSliver = sliversCur * slice / slices;
+                    size_t lastSliver = sliversCur * (slice + 1) / slices;
+                    if (firstSliver == lastSliver) {
+                        continue;
+                    }
+                    size_t jr = firstSliver * kernel.nr;
+                    size_t cols = std::min(lastSliver * kernel.nr, ncCur) - jr;
+                    GemmMacroKernel(kernel, mcCur, cols, kcCur, packedA.data(),
+                                    packedB.data() + jr * kcCur, c + ic * ldc + jc + jr, ldc);
+                }
+            });
+        }
+    }
+}
+
+template<typename ValueType>
+void Gemm(MatrixBlock<const ValueType> a, MatrixBlock<const ValueType> b, MatrixBlock<ValueType> c,
+          ValueType alpha = ValueType(1)) {
+    Gemm(c.Rows(), c.Columns(), a.Columns(), alpha,
+         a.Data(), a.Stride(), static_cast<size_t>(1),
+         b.Data(), b.Stride(), static_cast<size_t>(1),
+         c.Data(), c.Stride());
+}
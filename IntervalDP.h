@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// Interval dynamic programming over [0, n):
+//     best(i, i) = 0, best(l, r) = min over l <= k < r of best(l, k) + best(k + 1, r) + cost(l, k, r)
+// with any cost callable, e.g. the matrix-chain models in MatrixChain.h.
+// Cells are filled one interval length (anti-diagonal) at a time and the cells of a length are
+// split over the pool. Costs are kept twice, in a row-major upper triangle for best(l, k) and a
+// column-major one for best(k + 1, r), so both operands of the loop over k are contiguous; the
+// splits live in a separate array. Memory is n^2 values plus n^2 / 2 splits.
+
+struct IntervalDPOptions {
+    // Knuth's speed-up: searches k only in [split(l, r - 1), split(l + 1, r)], O(n^2) in total.
+    // Exact only for costs satisfying the quadrangle inequality and monotone under inclusion,
+    // typically cost(l, k, r) = w(l, r) like optimal merge or search trees; matrix-chain
+    // products don't in general.
+    bool knuthPruning = false;
+};
+
+template<typename Value>
+class IntervalDP {
+ public:
+    template<typename CostFunction>
+    static IntervalDP Solve(size_t n, const CostFunction& cost, const IntervalDPOptions& options = {});
+
+    [[nodiscard]] size_t Size() const {
+        return n;
+    }
+
+    // best(l, r), l <= r
+    Value Cost(size_t l, size_t r) const {
+        return costs[Index(l, r)];
+    }
+
+    // Optimal k for l < r: [l, r] = [l, k] + [k + 1, r]
+    [[nodiscard]] size_t Split(size_t l, size_t r) const {
+        return splits[Index(l, r)];
+    }
+
+ private:
+    explicit IntervalDP(size_t n) : n(n), costs(n * (n + 1) / 2), splits(n * (n + 1) / 2) {}
+
+    // Row l holds r = l..n-1
+    [[nodiscard]] size_t Index(size_t l, size_t r) const {
+        return l * n - l * (l + 1) / 2 + r;
+    }
+
+    size_t n;
+    std::vector<Value> costs;
+    std::vector<uint32_t> splits;
+};
+
+template<typename Value>
+template<typename CostFunction>
+IntervalDP<Value> IntervalDP<Value>::Solve(size_t n, const CostFunction& cost, const IntervalDPOptions& options) {
+    IntervalDP ans(n);
+    // Column r holds l = 0..r
+    std::vector<Value> columns(n * (n + 1) / 2);
+    auto columnIndex = [](size_t l, size_t r) {
+        return r * (r + 1) / 2 + l;
+    };
+    for (size_t i = 0; i != n; ++i) {
+        ans.costs[ans.Index(i, i)] = Value();
+        columns[columnIndex(i, i)] = Value();
+        ans.splits[ans.Index(i, i)] = static_cast<uint32_t>(i);
+    }
+    for (size_t length = 2; length <= n; ++length) {
+        size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / length, static_cast<size_t>(1));
+        ThreadPool::Instance().ParallelFor(0, n - length + 1, grain, [&](size_t from, size_t to) {
+            for (size_t l = from; l != to; ++l) {
+                size_t r = l + length - 1;
+                size_t low = l, high = r - 1;
+                if (options.knuthPruning) {
+                    low = std::max<size_t>(low, ans.splits[ans.Index(l, r - 1)]);
+                    high = std::max(std::min<size_t>(high, ans.splits[ans.Index(l + 1, r)]), low);
+                }
+                // row[k] = best(l, k), column[k + 1] = best(k + 1, r)
+                const Value* row = ans.costs.data() + ans.Index(l, l) - l;
+                const Value* column = columns.data() + columnIndex(0, r);
+                Value best = row[low] + column[low + 1] + cost(l, low, r);
+                size_t split = low;
+                for (size_t k = low + 1; k <= high; ++k) {
+                    Value current = row[k] + column[k + 1] + cost(l, k, r);
+                    if (current < best) {
+                        best = current;
+                        split = k;
+                    }
+                }
+                ans.costs[ans.Index(l, r)] = best;
+                columns[columnIndex(l, r)] = best;
+                ans.splits[ans.Index(l, r)] = static_cast<uint32_t>(split);
+            }
+        });
+    }
+    return ans;
+}
+
+// IntervalDP with the value type the cost callable returns
+template<typename CostFunction>
+auto SolveIntervalDP(size_t n, const CostFunction& cost, const IntervalDPOptions& options = {}) {
+    using Value = std::decay_t<decltype(cost(size_t(), size_t(), size_t()))>;
+    return IntervalDP<Value>::Solve(n, cost, options);
+}
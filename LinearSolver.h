@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "Gemm.h"
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+// PA = LU with partial pivoting, factored once and reused for any number of right-hand sides.
+// Right-looking and blocked: a panel of kLuBlock columns is factored with row operations, the
+// block row to its right is solved against L11, and the trailing matrix is updated with one
+// parallel Gemm (alpha = -1), which is where almost all of the n^3 / 3 multiplications happen.
+// A pivot that is exactly zero marks the matrix singular.
+
+constexpr size_t kLuBlock = 64;
+
+template<typename ValueType = double>
+class LuDecomposition {
+ public:
+    explicit LuDecomposition(const Matrix<ValueType>& matrix);
+
+    [[nodiscard]] size_t Size() const;
+
+    [[nodiscard]] bool Singular() const;
+
+    // L below the diagonal (its unit diagonal isn't stored) and U on and above it
+    const Matrix<ValueType>& Factors() const;
+
+    // Row i of PA is row Permutation()[i] of the original matrix
+    const std::vector<size_t>& Permutation() const;
+
+    ValueType Determinant() const;
+
+    std::vector<ValueType> Solve(const std::vector<ValueType>& rhs) const;
+
+    // Solves for every column of rhs at once
+    Matrix<ValueType> Solve(const Matrix<ValueType>& rhs) const;
+
+    Matrix<ValueType> Inverse() const;
+ private:
+    // Unblocked factorization of columns [from, from + width) from row `from` down
+    void FactorPanel(size_t from, size_t width);
+
+    // x = L^-1 x, then x = U^-1 x, x holds the already permuted right-hand sides
+    void SolveLower(Matrix<ValueType>& x) const;
+
+    void SolveUpper(Matrix<ValueType>& x) const;
+
+    Matrix<ValueType> lu;
+    std::vector<size_t> permutation;
+    bool oddSwaps = false;
+    bool singular = false;
+};
+
+template<typename ValueType>
+LuDecomposition<ValueType>::LuDecomposition(const Matrix<ValueType>& matrix) : lu(matrix) {
+    if (lu.Rows() != lu.Columns()) {
+        THROW(invalid_argument, "Only square matrices can be factored")
+    }
+    size_t n = Size();
+    permutation.resize(n);
+    for (size_t i = 0; i != n; ++i) {
+        permutation[i] = i;
+    }
+    for (size_t k = 0; k < n; k += kLuBlock) {
+        size_t width = std::min(kLuBlock, n - k);
+        FactorPanel(k, width);
+        size_t next = k + width;
+        if (next == n) {
+            break;
+        }
+        // U12 = L11^-1 A12, columns of the block row are independent
+        size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / (width * width), static_cast<size_t>(1));
+        ThreadPool::Instance().ParallelFor(next, n, grain, [&](size_t from, size_t to) {
+            for (size_t i = k + 1; i != next; ++i) {
+                ValueType* row = lu[i].data();
+                for (size_t j = k; j != i; ++j) {
+                    const ValueType factor = row[j];
+                    const ValueType* pivotRow = lu[j].data();
+                    for (size_t c = from; c != to; ++c) {
+                        row[c] -= factor * pivotRow[c];
+                    }
+                }
+            }
+        });
+        // A22 -= L21 * U12
+        Gemm(n - next, n - next, width, ValueType(-1),
+             lu.Data() + next * n + k, n, static_cast<size_t>(1),
+             lu.Data() + k * n + next, n, static_cast<size_t>(1),
+             lu.Data() + next * n + next, n);
+    }
+}
+
+template<typename ValueType>
+void LuDecomposition<ValueType>::FactorPanel(size_t from, size_t width) {
+    using std::abs;
+    size_t n = Size();
+    for (size_t j = from; j != from + width; ++j) {
+        size_t pivot = j;
+        for (size_t i = j + 1; i != n; ++i) {
+            if (abs(lu[i][j]) > abs(lu[pivot][j])) {
+                pivot = i;
+            }
+        }
+        if (pivot != j) {
+            std::swap_ranges(lu[j].begin(), lu[j].end(), lu[pivot].begin());
+            std::swap(permutation[j], permutation[pivot]);
+            oddSwaps = !oddSwaps;
+        }
+        if (lu[j][j] == ValueType(0)) {
+            singular = true;
+            continue;
+        }
+        const ValueType* pivotRow = lu[j].data();
+        size_t last = from + width;
+        size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / width, static_cast<size_t>(1));
+        ThreadPool::Instance().ParallelFor(j + 1, n, grain, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i != end; ++i) {
+                ValueType* row = lu[i].data();
+                row[j] /= pivotRow[j];
+                const ValueType factor = row[j];
+                for (size_t c = j + 1; c != last; ++c) {
+                    row[c] -= factor * pivotRow[c];
+                }
+            }
+        });
+    }
+}
+
+template<typename ValueType>
+size_t LuDecomposition<ValueType>::Size() const {
+    return lu.Rows();
+}
+
+template<typename ValueType>
+bool LuDecomposition<ValueType>::Singular() const {
+    return singular;
+}
+
+template<typename ValueType>
+const Matrix<ValueType>& LuDecomposition<ValueType>::Factors() const {
+    return lu;
+}
+
+template<typename ValueType>
+const std::vector<size_t>& LuDecomposition<ValueType>::Permutation() const {
+    return permutation;
+}
+
+template<typename ValueType>
+ValueType LuDecomposition<ValueType>::Determinant() const {
+    if (singular) {
+        return ValueType(0);
+    }
+    ValueType ans(1);
+    for (size_t i = 0; i != Size(); ++i) {
+        ans *= lu[i][i];
+    }
+    return oddSwaps ? -ans : ans;
+}
+
+template<typename ValueType>
+void LuDecomposition<ValueType>::SolveLower(Matrix<ValueType>& x) const {
+    size_t n = Size(), width = x.Columns();
+    for (size_t k = 0; k < n; k += kLuBlock) {
+        size_t height = std::min(kLuBlock, n - k);
+        if (k != 0) {
+            Gemm(height, width, k, ValueType(-1),
+                 lu.Data() + k * n, n, static_cast<size_t>(1),
+                 x.Data(), x.Stride(), static_cast<size_t>(1),
+                 x.Data() + k * x.Stride(), x.Stride());
+        }
+        size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / (height * height), static_cast<size_t>(1));
+        ThreadPool::Instance().ParallelFor(0, width, grain, [&](size_t from, size_t to) {
+            for (size_t i = k + 1; i != k + height; ++i) {
+                ValueType* row = x[i].data();
+                for (size_t j = k; j != i; ++j) {
+                    const ValueType factor = lu[i][j];
+                    const ValueType* other = x[j].data();
+                    for (size_t c = from; c != to; ++c) {
+                        row[c] -= factor * other[c];
+                    }
+                }
+            }
+        });
+    }
+}
+
+template<typename ValueType>
+void LuDecomposition<ValueType>::SolveUpper(Matrix<ValueType>& x) const {
+    size_t n = Size(), width = x.Columns();
+    for (size_t end = n; end != 0;) {
+        size_t height = std::min(kLuBlock, end);
+        size_t k = end - height;
+        if (end != n) {
+            Gemm(height, width, n - end, ValueType(-1),
+                 lu.Data() + k * n + end, n, static_cast<size_t>(1),
+                 x.Data() + end * x.Stride(), x.Stride(), static_cast<size_t>(1),
+                 x.Data() + k * x.Stride(), x.Stride());
+        }
+        size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / (height * height), static_cast<size_t>(1));
+        ThreadPool::Instance().ParallelFor(0, width, grain, [&](size_t from, size_t to) {
+            for (size_t i = end; i-- != k;) {
+                ValueType* row = x[i].data();
+                for (size_t j = i + 1; j != end; ++j) {
+                    const ValueType factor = lu[i][j];
+                    const ValueType* other = x[j].data();
+                    for (size_t c = from; c != to; ++c) {
+                        row[c] -= factor * other[c];
+                    }
+                }
+                const ValueType diagonal = lu[i][i];
+                for (size_t c = from; c != to; ++c) {
+                    row[c] /= diagonal;
+                }
+            }
+        });
+        end = k;
+    }
+}
+
+template<typename ValueType>
+Matrix<ValueType> LuDecomposition<ValueType>::Solve(const Matrix<ValueType>& rhs) const {
+    if (rhs.Rows() != Size()) {
+        THROW(out_of_range, "Right-hand side differs in size")
+    }
+    if (singular) {
+        THROW(runtime_error, "Matrix is singular")
+    }
+    Matrix<ValueType> x(rhs.Rows(), rhs.Columns());
+    for (size_t i = 0; i != Size(); ++i) {
+        std::copy(rhs[permutation[i]].begin(), rhs[permutation[i]].end(), x[i].begin());
+    }
+    SolveLower(x);
+    SolveUpper(x);
+    return x;
+}
+
+template<typename ValueType>
+std::vector<ValueType> LuDecomposition<ValueType>::Solve(const std::vector<ValueType>& rhs) const {
+    Matrix<ValueType> column(rhs.size(), 1);
+    std::copy(rhs.begin(), rhs.end(), column.Data());
+    Matrix<ValueType> x = Solve(column);
+    return {x.Data(), x.Data() + x.Rows()};
+}
+
+template<typename ValueType>
+Matrix<ValueType> LuDecomposition<ValueType>::Inverse() const {
+    return Solve(Matrix<ValueType>::Unit(Size()));
+}
+
+template<typename ValueType>
+std::vector<ValueType> Solve(const Matrix<ValueType>& matrix, const std::vector<ValueType>& rhs) {
+    return LuDecomposition<ValueType>(matrix).Solve(rhs);
+}
+
+template<typename ValueType>
+Matrix<ValueType> Solve(const Matrix<ValueType>& matrix, const Matrix<ValueType>& rhs) {
+    return LuDecomposition<ValueType>(matrix).Solve(rhs);
+}
+
+template<typename ValueType>
+ValueType Determinant(const Matrix<ValueType>& matrix) {
+    return LuDecomposition<ValueType>(matrix).Determinant();
+}
+
+template<typename ValueType>
+Matrix<ValueType> Inverse(const Matrix<ValueType>& matrix) {
+    return LuDecomposition<ValueType>(matrix).Inverse();
+}
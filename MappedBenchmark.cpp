@@ -0,0 +1,57 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "MappedMatrix.h"
+
+// Usage: MappedBenchmark [n] [--tile=T] [--budget=MB] [--dir=PATH]
+// Writes two random n x n tiled files, multiplies them out of core with MappedMultiply and prints
+// the streaming statistics. A few entries of the product are checked against direct dot products.
+
+int main(int argc, char** argv) {
+    size_t n = 4096, tile = kMappedTile, budget = 256;
+    std::string dir = "/tmp";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--tile=", 0) == 0) {
+            tile = std::stoul(arg.substr(7));
+        } else if (arg.rfind("--budget=", 0) == 0) {
+            budget = std::stoul(arg.substr(9));
+        } else if (arg.rfind("--dir=", 0) == 0) {
+            dir = arg.substr(6);
+        } else {
+            n = std::stoul(arg);
+        }
+    }
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    auto a = MappedMatrix<double>::Create(dir + "/mapped_a.bin", n, n, tile);
+    auto b = MappedMatrix<double>::Create(dir + "/mapped_b.bin", n, n, tile);
+    for (size_t i = 0; i != n; ++i) {
+        for (size_t j = 0; j != n; ++j) {
+            a.At(i, j) = dist(rng);
+            b.At(i, j) = dist(rng);
+        }
+    }
+    a.Flush();
+    b.Flush();
+    auto c = MappedMatrix<double>::Create(dir + "/mapped_c.bin", n, n, tile);
+
+    StreamingOptions options;
+    options.memoryBudget = budget << 20;
+    StreamingStats stats = MappedMultiply(a, b, c, options);
+    std::cout << "n = " << n << ", tile " << tile << ", budget " << budget << " MB\n" << stats << '\n';
+
+    double maxError = 0;
+    for (size_t probe = 0; probe != 16; ++probe) {
+        size_t i = rng() % n, j = rng() % n;
+        double expected = 0;
+        for (size_t k = 0; k != n; ++k) {
+            expected += a.At(i, k) * b.At(k, j);
+        }
+        maxError = std::max(maxError, std::abs(expected - c.At(i, j)));
+    }
+    std::cout << "max error " << maxError << '\n';
+}
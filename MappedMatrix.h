@@ -0,0 +1,595 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Gemm.h"
+#include "Matrix.h"
+#include "MatrixStorage.h"
+
+// Disk-backed matrix: a file of square tiles memory-mapped as a whole, so it can be far larger
+// than RAM. Layout: a one-page header, then tile (ti, tj) at tile index ti * TileColumns() + tj,
+// each tile a dense row-major TileSize() x TileSize() block. Edge tiles are padded with zeros.
+// POSIX only.
+
+constexpr size_t kMappedTile = 512;
+constexpr size_t kMappedHeaderSize = 4096;
+
+struct MappedMatrixHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t elementSize;
+    uint64_t rows;
+    uint64_t columns;
+    uint64_t tile;
+};
+
+constexpr char kMappedMagic[8] = {'M', 'T', 'X', 'T', 'I', 'L', 'E', '\0'};
+constexpr uint32_t kMappedVersion = 1;
+
+template<typename ValueType = double>
+class MappedMatrix {
+ public:
+    // New zero-filled file, replaces an existing one
+    static MappedMatrix Create(const std::string& path, size_t rows, size_t columns, size_t tile = kMappedTile);
+
+    static MappedMatrix Create(const std::string& path, const Matrix<ValueType>& matrix, size_t tile = kMappedTile);
+
+    static MappedMatrix Open(const std::string& path, bool writable = false);
+
+    MappedMatrix(const MappedMatrix&) = delete;
+
+    MappedMatrix& operator=(const MappedMatrix&) = delete;
+
+    MappedMatrix(MappedMatrix&& other) noexcept;
+
+    MappedMatrix& operator=(MappedMatrix&& other) noexcept;
+
+    ~MappedMatrix();
+
+    [[nodiscard]] size_t Rows() const;
+
+    [[nodiscard]] size_t Columns() const;
+
+    [[nodiscard]] size_t TileSize() const;
+
+    [[nodiscard]] size_t TileRows() const;
+
+    [[nodiscard]] size_t TileColumns() const;
+
+    [[nodiscard]] bool Writable() const;
+
+    // First element of tile (ti, tj), rows of the tile are TileSize() apart. The mutable accessors
+    // throw on a read-only open, whose mapping would fault on the first write; read such a
+    // matrix through a const reference.
+    ValueType* Tile(size_t ti, size_t tj);
+
+    const ValueType* Tile(size_t ti, size_t tj) const;
+
+    ValueType& At(size_t i, size_t j);
+
+    const ValueType& At(size_t i, size_t j) const;
+
+    // Reads everything into memory, only for matrices that fit
+    Matrix<ValueType> ToMatrix() const;
+
+    // Asks the kernel to start reading the tile in the background
+    void Prefetch(size_t ti, size_t tj) const;
+
+    // Drops the tile's pages from this process, the file keeps the data
+    void Release(size_t ti, size_t tj) const;
+
+    // Writes dirty pages back to the file
+    void Flush();
+
+    void Flush(size_t ti, size_t tj);
+ private:
+    MappedMatrix(int descriptor, void* mapping, size_t bytes, size_t rows, size_t columns, size_t tile,
+                 bool writable);
+
+    [[nodiscard]] size_t TileElements() const;
+
+    // Whole pages of tile (ti, tj), for madvise
+    [[nodiscard]] std::pair<char*, size_t> TilePages(size_t ti, size_t tj) const;
+
+    int descriptor = -1;
+    void* mapping = nullptr;
+    size_t bytes = 0;
+    size_t rows = 0;
+    size_t columns = 0;
+    size_t tile = 0;
+    bool writable = false;
+};
+
+template<typename ValueType>
+MappedMatrix<ValueType>::MappedMatrix(int descriptor, void* mapping, size_t bytes, size_t rows, size_t columns,
+                                      size_t tile, bool writable) :
+    descriptor(descriptor), mapping(mapping), bytes(bytes), rows(rows), columns(columns), tile(tile),
+    writable(writable) {}
+
+template<typename ValueType>
+MappedMatrix<ValueType> MappedMatrix<ValueType>::Create(const std::string& path, size_t rows, size_t columns,
+                                                        size_t tile) {
+    if (tile == 0) {
+        THROW(invalid_argument, "Tile size has to be positive")
+    }
+    size_t tileRows = (rows + tile - 1) / tile, tileColumns = (columns + tile - 1) / tile;
+    size_t bytes = kMappedHeaderSize + tileRows * tileColumns * tile * tile * sizeof(ValueType);
+    int descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0) {
+        THROW(runtime_error, "Can't create " << path)
+    }
+    if (::ftruncate(descriptor, static_cast<off_t>(bytes)) != 0) {
+        ::close(descriptor);
+        THROW(runtime_error, "Can't resize " << path)
+    }
+    void* mapping = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(descriptor);
+        THROW(runtime_error, "Can't map " << path)
+    }
+    MappedMatrixHeader header{};
+    std::memcpy(header.magic, kMappedMagic, sizeof(header.magic));
+    header.version = kMappedVersion;
+    header.elementSize = sizeof(ValueType);
+    header.rows = rows;
+    header.columns = columns;
+    header.tile = tile;
+    std::memcpy(mapping, &header, sizeof(header));
+    return {descriptor, mapping, bytes, rows, columns, tile, true};
+}
+
+template<typename ValueType>
+MappedMatrix<ValueType> MappedMatrix<ValueType>::Create(const std::string& path, const Matrix<ValueType>& matrix,
+                                                        size_t tile) {
+    MappedMatrix ans = Create(path, matrix.Rows(), matrix.Columns(), tile);
+    for (size_t i = 0; i != matrix.Rows(); ++i) {
+        for (size_t j = 0; j != matrix.Columns(); ++j) {
+            ans.At(i, j) = matrix[i][j];
+        }
+    }
+    return ans;
+}
+
+template<typename ValueType>
+MappedMatrix<ValueType> MappedMatrix<ValueType>::Open(const std::string& path, bool writable) {
+    int descriptor = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (descriptor < 0) {
+        THROW(runtime_error, "Can't open " << path)
+    }
+    struct stat status{};
+    MappedMatrixHeader header{};
+    if (::fstat(descriptor, &status) != 0 || static_cast<size_t>(status.st_size) < kMappedHeaderSize ||
+        ::pread(descriptor, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+        ::close(descriptor);
+        THROW(runtime_error, "Can't read header of " << path)
+    }
+    size_t bytes = static_cast<size_t>(status.st_size);
+    size_t tile = header.tile;
+    bool valid = std::memcmp(header.magic, kMappedMagic, sizeof(header.magic)) == 0 &&
+                 header.version == kMappedVersion && header.elementSize == sizeof(ValueType) && tile != 0;
+    if (valid) {
+        size_t tileRows = (header.rows + tile - 1) / tile, tileColumns = (header.columns + tile - 1) / tile;
+        valid = bytes == kMappedHeaderSize + tileRows * tileColumns * tile * tile * sizeof(ValueType);
+    }
+    if (!valid) {
+        ::close(descriptor);
+        THROW(runtime_error, path << " isn't a tiled matrix of this element type")
+    }
+    void* mapping = ::mmap(nullptr, bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, descriptor, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(descriptor);
+        THROW(runtime_error, "Can't map " << path)
+    }
+    return {descriptor, mapping, bytes, header.rows, header.columns, tile, writable};
+}
+
+template<typename ValueType>
+MappedMatrix<ValueType>::MappedMatrix(MappedMatrix&& other) noexcept :
+    descriptor(std::exchange(other.descriptor, -1)), mapping(std::exchange(other.mapping, nullptr)),
+    bytes(other.bytes), rows(other.rows), columns(other.columns), tile(other.tile), writable(other.writable) {}
+
+template<typename ValueType>
+MappedMatrix<ValueType>& MappedMatrix<ValueType>::operator=(MappedMatrix&& other) noexcept {
+    std::swap(descriptor, other.descriptor);
+    std::swap(mapping, other.mapping);
+    std::swap(bytes, other.bytes);
+    std::swap(rows, other.rows);
+    std::swap(columns, other.columns);
+    std::swap(tile, other.tile);
+    std::swap(writable, other.writable);
+    return *this;
+}
+
+template<typename ValueType>
+MappedMatrix<ValueType>::~MappedMatrix() {
+    if (mapping != nullptr) {
+        ::munmap(mapping, bytes);
+    }
+    if (descriptor >= 0) {
+        ::close(descriptor);
+    }
+}
+
+template<typename ValueType>
+size_t MappedMatrix<ValueType>::Rows() const {
+    return rows;
+}
+
+template<typename ValueType>
+size_t MappedMatrix<ValueType>::Columns() const {
+    return columns;
+}
+
+template<typename ValueType>
+size_t MappedMatrix<ValueType>::TileSize() const {
+    return tile;
+}
+
+template<typename ValueType>
+size_t MappedMatrix<ValueType>::TileRows() const {
+    return (rows + tile - 1) / tile;
+}
+
+template<typename ValueType>
+size_t MappedMatrix<ValueType>::TileColumns() const {
+    return (columns + tile - 1) / tile;
+}
+
+template<typename ValueType>
+bool MappedMatrix<ValueType>::Writable() const {
+    return writable;
+}
+
+template<typename ValueType>
+size_t MappedMatrix<ValueType>::TileElements() const {
+    return tile * tile;
+}
+
+template<typename ValueType>
+ValueType* MappedMatrix<ValueType>::Tile(size_t ti, size_t tj) {
+    if (!writable) {
+        THROW(logic_error, "Matrix is opened read-only")
+    }
+    return reinterpret_cast<ValueType*>(static_cast<char*>(mapping) + kMappedHeaderSize) +
+           (ti * TileColumns() + tj) * TileElements();
+}
+
+template<typename ValueType>
+const ValueType* MappedMatrix<ValueType>::Tile(size_t ti, size_t tj) const {
+    return reinterpret_cast<const ValueType*>(static_cast<const char*>(mapping) + kMappedHeaderSize) +
+           (ti * TileColumns() + tj) * TileElements();
+}
+
+template<typename ValueType>
+ValueType& MappedMatrix<ValueType>::At(size_t i, size_t j) {
+    return Tile(i / tile, j / tile)[i % tile * tile + j % tile];
+}
+
+template<typename ValueType>
+const ValueType& MappedMatrix<ValueType>::At(size_t i, size_t j) const {
+    return Tile(i / tile, j / tile)[i % tile * tile + j % tile];
+}
+
+template<typename ValueType>
+Matrix<ValueType> MappedMatrix<ValueType>::ToMatrix() const {
+    Matrix<ValueType> ans(rows, columns);
+    for (size_t i = 0; i != rows; ++i) {
+        for (size_t j = 0; j != columns; ++j) {
+            ans[i][j] = At(i, j);
+        }
+    }
+    return ans;
+}
+
+template<typename ValueType>
+std::pair<char*, size_t> MappedMatrix<ValueType>::TilePages(size_t ti, size_t tj) const {
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t first = reinterpret_cast<size_t>(Tile(ti, tj));
+    size_t last = first + TileElements() * sizeof(ValueType);
+    first = (first + page - 1) / page * page;
+    last = last / page * page;
+    return {reinterpret_cast<char*>(first), last > first ? last - first : 0};
+}
+
+template<typename ValueType>
+void MappedMatrix<ValueType>::Prefetch(size_t ti, size_t tj) const {
+    auto [start, length] = TilePages(ti, tj);
+    if (length != 0) {
+        ::madvise(start, length, MADV_WILLNEED);
+    }
+}
+
+template<typename ValueType>
+void MappedMatrix<ValueType>::Release(size_t ti, size_t tj) const {
+    auto [start, length] = TilePages(ti, tj);
+    if (length != 0) {
+        ::madvise(start, length, MADV_DONTNEED);
+    }
+}
+
+template<typename ValueType>
+void MappedMatrix<ValueType>::Flush(size_t ti, size_t tj) {
+    if (!writable) {
+        return;
+    }
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t first = reinterpret_cast<size_t>(Tile(ti, tj));
+    size_t last = first + TileElements() * sizeof(ValueType);
+    first = first / page * page;
+    if (::msync(reinterpret_cast<void*>(first), last - first, MS_SYNC) != 0) {
+        THROW(runtime_error, "Can't write the tile back")
+    }
+}
+
+template<typename ValueType>
+void MappedMatrix<ValueType>::Flush() {
+    if (writable && ::msync(mapping, bytes, MS_SYNC) != 0) {
+        THROW(runtime_error, "Can't write the matrix back")
+    }
+}
+
+struct StreamingOptions {
+    // Bytes of tile buffers the multiplication may hold at once, the page cache isn't counted
+    size_t memoryBudget = static_cast<size_t>(1) << 30;
+};
+
+struct StreamingStats {
+    size_t bytesRead = 0;
+    size_t bytesWritten = 0;
+    double readSeconds = 0;
+    double writeSeconds = 0;
+    double computeSeconds = 0;
+    double totalSeconds = 0;
+    double flops = 0;
+    // Tiles of C computed together, the square root of what fits in the budget
+    size_t blockTiles = 0;
+
+    [[nodiscard]] double ReadThroughput() const {
+        return readSeconds > 0 ? bytesRead / readSeconds : 0;
+    }
+
+    [[nodiscard]] double WriteThroughput() const {
+        return writeSeconds > 0 ? bytesWritten / writeSeconds : 0;
+    }
+
+    // Share of the wall time spent in Gemm, the rest is waiting for tiles
+    [[nodiscard]] double ComputeUtilisation() const {
+        return totalSeconds > 0 ? computeSeconds / totalSeconds : 0;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const StreamingStats& stats) {
+    return out << "read " << stats.bytesRead / 1e6 << " MB at " << stats.ReadThroughput() / 1e6 << " MB/s, "
+               << "written " << stats.bytesWritten / 1e6 << " MB at " << stats.WriteThroughput() / 1e6 << " MB/s, "
+               << "compute " << stats.flops / std::max(stats.computeSeconds, 1e-12) * 1e-9 << " GFLOP/s, "
+               << "utilisation " << stats.ComputeUtilisation() * 100 << "%, "
+               << stats.blockTiles << 'x' << stats.blockTiles << " tile blocks, " << stats.totalSeconds << " s";
+}
+
+// One background thread running jobs in submission order. Tile copies block on page faults, so
+// they don't go to the ThreadPool, whose workers are all busy in Gemm meanwhile; the thread
+// lives for the whole streaming multiply instead of being started for every step.
+class TileIoThread {
+ public:
+    TileIoThread() : worker([this] { Run(); }) {}
+
+    TileIoThread(const TileIoThread&) = delete;
+
+    TileIoThread& operator=(const TileIoThread&) = delete;
+
+    // Finishes the queued jobs first
+    ~TileIoThread() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_one();
+        worker.join();
+    }
+
+    std::future<size_t> Submit(std::function<size_t()> job) {
+        std::packaged_task<size_t()> task(std::move(job));
+        std::future<size_t> ans = task.get_future();
+        {
+            std::lock_guard lock(mutex);
+            jobs.push_back(std::move(task));
+        }
+        wakeUp.notify_one();
+        return ans;
+    }
+ private:
+    void Run() {
+        while (true) {
+            std::packaged_task<size_t()> task;
+            {
+                std::unique_lock lock(mutex);
+                wakeUp.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return;
+                }
+                task = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::deque<std::packaged_task<size_t()>> jobs;
+    bool stopping = false;
+    std::thread worker;
+};
+
+// c = a * b, all three on disk with the same tile size. C is produced in blocks of g x g tiles;
+// for every step along the inner dimension the g tiles of A and g tiles of B it needs are copied
+// into buffers on a TileIoThread while the previous step is multiplied, and a finished block
+// of C is copied into the mapping there while the next one is computed. Those pages are left to
+// the page cache and synced once at the end, a per-tile msync would hold up the loads queued
+// behind it. g is the largest value for which 4g read buffers and 2g^2 C buffers fit in
+// options.memoryBudget.
+template<typename ValueType>
+StreamingStats MappedMultiply(const MappedMatrix<ValueType>& a, const MappedMatrix<ValueType>& b,
+                              MappedMatrix<ValueType>& c, const StreamingOptions& options = {}) {
+    using Clock = std::chrono::steady_clock;
+    using Buffer = std::vector<ValueType, AlignedAllocator<ValueType>>;
+    if (a.Columns() != b.Rows() || c.Rows() != a.Rows() || c.Columns() != b.Columns()) {
+        THROW(out_of_range, "Can't multiply")
+    }
+    if (a.TileSize() != b.TileSize() || a.TileSize() != c.TileSize() || !c.Writable()) {
+        THROW(invalid_argument, "Operands need one tile size and a writable result")
+    }
+    size_t tile = a.TileSize(), elements = tile * tile, tileBytes = elements * sizeof(ValueType);
+    size_t budgetTiles = options.memoryBudget / tileBytes;
+    size_t g = 0;
+    while (4 * (g + 1) + 2 * (g + 1) * (g + 1) <= budgetTiles) {
+        ++g;
+    }
+    if (g == 0) {
+        THROW(invalid_argument, "Memory budget is below 6 tiles")
+    }
+    g = std::min(g, std::max(c.TileRows(), c.TileColumns()));
+
+    StreamingStats stats;
+    stats.blockTiles = g;
+    auto start = Clock::now();
+    auto seconds = [](Clock::time_point from) {
+        return std::chrono::duration<double>(Clock::now() - from).count();
+    };
+
+    // Steps of the whole computation: (C block, inner tile index)
+    struct Step {
+        size_t rowBlock;
+        size_t columnBlock;
+        size_t inner;
+    };
+    std::vector<Step> steps;
+    for (size_t rowBlock = 0; rowBlock < c.TileRows(); rowBlock += g) {
+        for (size_t columnBlock = 0; columnBlock < c.TileColumns(); columnBlock += g) {
+            for (size_t inner = 0; inner != a.TileColumns(); ++inner) {
+                steps.push_back({rowBlock, columnBlock, inner});
+            }
+        }
+    }
+
+    // Two sets of read buffers: A tiles, then B tiles
+    Buffer reads[2] = {Buffer(2 * g * elements), Buffer(2 * g * elements)};
+    Buffer blocks[2] = {Buffer(g * g * elements), Buffer(g * g * elements)};
+    double readSeconds = 0, writeSeconds = 0;
+    auto load = [&](const Step& step, ValueType* buffer) {
+        auto loadStart = Clock::now();
+        size_t loaded = 0;
+        for (size_t k = 0; k != g; ++k) {
+            if (step.rowBlock + k < a.TileRows()) {
+                std::copy(a.Tile(step.rowBlock + k, step.inner), a.Tile(step.rowBlock + k, step.inner) + elements,
+                          buffer + k * elements);
+                a.Release(step.rowBlock + k, step.inner);
+                ++loaded;
+            }
+            if (step.columnBlock + k < b.TileColumns()) {
+                std::copy(b.Tile(step.inner, step.columnBlock + k), b.Tile(step.inner, step.columnBlock + k) + elements,
+                          buffer + (g + k) * elements);
+                b.Release(step.inner, step.columnBlock + k);
+                ++loaded;
+            }
+        }
+        readSeconds += seconds(loadStart);
+        return loaded * tileBytes;
+    };
+    auto store = [&](size_t rowBlock, size_t columnBlock, const ValueType* block) {
+        auto storeStart = Clock::now();
+        size_t stored = 0;
+        for (size_t i = 0; i != g && rowBlock + i < c.TileRows(); ++i) {
+            for (size_t j = 0; j != g && columnBlock + j < c.TileColumns(); ++j) {
+                const ValueType* source = block + (i * g + j) * elements;
+                ValueType* target = c.Tile(rowBlock + i, columnBlock + j);
+                std::copy(source, source + elements, target);
+                c.Release(rowBlock + i, columnBlock + j);
+                ++stored;
+            }
+        }
+        writeSeconds += seconds(storeStart);
+        return stored * tileBytes;
+    };
+
+    // Declared after everything the jobs touch, so it is drained first when an exception leaves
+    TileIoThread io;
+    std::future<size_t> reading, writing;
+    if (!steps.empty()) {
+        stats.bytesRead += load(steps[0], reads[0].data());
+    }
+    size_t current = 0;
+    for (size_t s = 0; s != steps.size(); ++s) {
+        const Step& step = steps[s];
+        ValueType* block = blocks[current].data();
+        if (s + 1 != steps.size()) {
+            const Step& next = steps[s + 1];
+            for (size_t k = 0; k != g; ++k) {
+                if (next.rowBlock + k < a.TileRows()) {
+                    a.Prefetch(next.rowBlock + k, next.inner);
+                }
+                if (next.columnBlock + k < b.TileColumns()) {
+                    b.Prefetch(next.inner, next.columnBlock + k);
+                }
+            }
+            reading = io.Submit([&load, next, buffer = reads[(s + 1) % 2].data()] { return load(next, buffer); });
+        }
+        if (step.inner == 0) {
+            std::fill(block, block + g * g * elements, ValueType(0));
+        }
+
+        auto computeStart = Clock::now();
+        const ValueType* buffer = reads[s % 2].data();
+        for (size_t i = 0; i != g && step.rowBlock + i < c.TileRows(); ++i) {
+            for (size_t j = 0; j != g && step.columnBlock + j < c.TileColumns(); ++j) {
+                Gemm(tile, tile, tile, ValueType(1),
+                     buffer + i * elements, tile, static_cast<size_t>(1),
+                     buffer + (g + j) * elements, tile, static_cast<size_t>(1),
+                     block + (i * g + j) * elements, tile);
+                stats.flops += 2.0 * tile * tile * tile;
+            }
+        }
+        stats.computeSeconds += seconds(computeStart);
+
+        if (step.inner + 1 == a.TileColumns()) {
+            if (writing.valid()) {
+                stats.bytesWritten += writing.get();
+            }
+            writing = io.Submit([&store, rowBlock = step.rowBlock, columnBlock = step.columnBlock, block] {
+                return store(rowBlock, columnBlock, block);
+            });
+            current = 1 - current;
+        }
+        if (reading.valid()) {
+            stats.bytesRead += reading.get();
+        }
+    }
+    if (writing.valid()) {
+        stats.bytesWritten += writing.get();
+    }
+    auto flushStart = Clock::now();
+    c.Flush();
+    writeSeconds += seconds(flushStart);
+    stats.readSeconds = readSeconds;
+    stats.writeSeconds = writeSeconds;
+    stats.totalSeconds = seconds(start);
+    return stats;
+}
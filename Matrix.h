@@ -1,347 +1,668 @@
-#pragma once
-
-#include <algorithm>
-#include <forward_list>
-#include <future>
-#include <iostream>
-#include <stdexcept>
-#include <thread>
-#include <utility>
-#include <vector>
-
-#define BRUTE(name, a, b, cnt) for (int32_t name##cnt = a; name##cnt != b; ++name##cnt)
-#define BRUTE1(name, a, b) BRUTE(name,a,b,1)
-#define BRUTE2(name, a, b) BRUTE1(name,a,b) BRUTE(name,a,b,2)
-#define BRUTE3(name, a, b) BRUTE2(name,a,b) BRUTE(name,a,b,3)
-#define BRUTE4(name, a, b) BRUTE3(name,a,b) BRUTE(name,a,b,4)
-#define BRUTE5(name, a, b) BRUTE4(name,a,b) BRUTE(name,a,b,5)
-#define BRUTE6(name, a, b) BRUTE5(name,a,b) BRUTE(name,a,b,6)
-#define BRUTE7(name, a, b) BRUTE6(name,a,b) BRUTE(name,a,b,7)
-#define BRUTE8(name, a, b) BRUTE7(name,a,b) BRUTE(name,a,b,8)
-#define BRUTE9(name, a, b) BRUTE8(name,a,b) BRUTE(name,a,b,9)
-#define BRUTE10(name, a, b) BRUTE9(name,a,b) BRUTE(name,a,b,10)
-#define BRUTE11(name, a, b) BRUTE10(name,a,b) BRUTE(name,a,b,11)
-#define BRUTE12(name, a, b) BRUTE11(name,a,b) BRUTE(name,a,b,12)
-
-#define THROW(TYPE, TEXT) {                                 \
-    std::cerr << "Exception at line " << __LINE__ << '\n'   \
-              << TEXT << '\n';                              \
-    throw std::TYPE("");                                    \
-}
-
-#define MULTITHREAD_VOID(func) {                                                           \
-    size_t rowsForThread = std::max(contents.size() / std::thread::hardware_concurrency(), \
-                                static_cast<size_t>(1));                                   \
-    std::forward_list<std::future<void>> futures;                                          \
-    size_t from = 0;                                                                       \
-    while (from != contents.size()) {                                                      \
-        size_t to = from + rowsForThread;                                                  \
-        if (contents.size() - to < rowsForThread) {                                        \
-            to = contents.size();                                                          \
-        }                                                                                  \
-        futures.push_front(std::async([&, from, to] {                                      \
-            size_t i = from;                                                               \
-            while (i != to) {                                                              \
-                func                                                                       \
-                ++i;                                                                       \
-            }                                                                              \
-        }));                                                                               \
-                                                                                           \
-        from = to;                                                                         \
-    }                                                                                      \
-    for (auto &f : futures) {                                                              \
-        f.get();                                                                           \
-    }                                                                                      \
-}                                                                                          \
-
-template<typename ValueType = double>
-class Matrix {
- public:
-    using container_type = std::vector<std::vector<ValueType>>;
-    using value_type = ValueType;
-    using iterator = typename container_type::iterator;
-    using const_iterator = typename container_type::const_iterator;
-
-    Matrix(size_t rows, size_t columns, ValueType value = ValueType()) :
-        contents(container_type(rows, std::vector<ValueType>(columns, value))) {}
-
-    Matrix(std::vector<std::vector<ValueType>> contents) : contents(std::move(contents)) {}
-
-    static Matrix Unit(size_t size);
-
-    [[nodiscard]] bool empty() const;
-
-    [[nodiscard]] std::pair<size_t, size_t> size() const;
-
-    [[nodiscard]] size_t Rows() const;
-
-    [[nodiscard]] size_t Columns() const;
-
-    iterator begin();
-
-    const_iterator begin() const;
-
-    iterator end();
-
-    const_iterator end() const;
-
-    std::vector<ValueType>& operator[](size_t idx);
-
-    const std::vector<ValueType>& operator[](size_t idx) const;
-
-    bool operator==(const Matrix& other);
-
-    bool operator!=(const Matrix& other);
-
-    Matrix& operator-();
-
-    Matrix& operator+=(const Matrix& other);
-
-    Matrix& operator-=(const Matrix& other);
-
-    Matrix& operator*=(const Matrix& other);
-
-    Matrix& operator*=(ValueType other);
-
-    Matrix& operator/=(ValueType other);
-
-    Matrix operator+(const Matrix& other) const;
-
-    Matrix operator-(const Matrix& other) const;
-
-    Matrix operator*(const Matrix& other) const;
-
-    Matrix operator*(const ValueType other) const;
-
-    Matrix operator/(ValueType other) const;
-
-    ValueType Tr() const;
-
-    Matrix Transponed() const;
-
-    Matrix& Transpone();
-
-    Matrix& Pow(size_t pow) const;
- private:
-    container_type contents;
-};
-
-template<typename ValueType>
-Matrix<ValueType> Matrix<ValueType>::Unit(size_t size) {
-    Matrix<ValueType> ans(size, size);
-    for (size_t i = 0; i != size; ++i) {
-        ans[i][i] = 1;
-    }
-    return ans;
-}
-
-template<typename ValueType>
-bool Matrix<ValueType>::empty() const {
-    return contents.empty() || contents.front().empty();
-}
-
-template<typename ValueType>
-std::pair<size_t, size_t> Matrix<ValueType>::size() const {
-    return {Rows(), Columns()};
-}
-
-template<typename ValueType>
-size_t Matrix<ValueType>::Rows() const {
-    return contents.size();
-}
-
-template<typename ValueType>
-size_t Matrix<ValueType>::Columns() const {
-    return Rows() == 0 ? 0 : contents.front().size();
-}
-
-template<typename ValueType>
-std::vector<ValueType>& Matrix<ValueType>::operator[](size_t idx) {
-    return contents[idx];
-}
-
-template<typename ValueType>
-const std::vector<ValueType>& Matrix<ValueType>::operator[](size_t idx) const {
-    return contents[idx];
-}
-
-template<typename ValueType>
-bool Matrix<ValueType>::operator==(const Matrix& other) {
-    return contents == other.contents;
-}
-
-template<typename ValueType>
-bool Matrix<ValueType>::operator!=(const Matrix& other) {
-    return !(*this == other);
-}
-
-template<typename ValueType>
-Matrix<ValueType>& Matrix<ValueType>::operator-() {
-    for (auto& i : contents) {
-        for (auto& j : i) {
-            j = -j;
-        }
-    }
-    return *this;
-}
-template<typename ValueType>
-Matrix<ValueType>& Matrix<ValueType>::operator+=(const Matrix& other) {
-    if (empty() || size() != other.size()) {
-        THROW(out_of_range, "Matrices differ in size")
-    }
-    MULTITHREAD_VOID(
-        for (size_t j = 0; j != Columns(); ++j) {
-            contents[i][j] += other.contents[i][j];
-        }
-    )
-    return *this;
-}
-
-template<typename ValueType>
-Matrix<ValueType>& Matrix<ValueType>::operator-=(const Matrix& other) {
-    if (size() != other.size()) {
-        THROW(out_of_range, "Matrices differ in size")
-    }
-    MULTITHREAD_VOID(
-        for (size_t j = 0; j != Columns(); ++j) {
-            contents[i][j] -= other[i][j];
-        }
-    )
-    return *this;
-}
-
-template<typename ValueType>
-Matrix<ValueType>& Matrix<ValueType>::operator*=(const Matrix& other) {
-    *this = std::move(*this * other);
-    return *this;
-}
-
-template<typename ValueType>
-Matrix<ValueType>& Matrix<ValueType>::operator*=(const ValueType other) {
-    MULTITHREAD_VOID(
-        for (size_t j = 0; j != Columns(); ++j) {
-            contents[i][j] *= other;
-        }
-    )
-    return *this;
-}
-
-template<typename ValueType>
-Matrix<ValueType>& Matrix<ValueType>::operator/=(ValueType other) {
-    MULTITHREAD_VOID(
-        for (size_t j = 0; j != Columns(); ++j) {
-            contents[i][j] /= other;
-        }
-    )
-    return *this;
-}
-
-template<typename ValueType>
-Matrix<ValueType> Matrix<ValueType>::operator+(const Matrix& other) const {
-    return Matrix(*this) += other;
-}
-
-template<typename ValueType>
-Matrix<ValueType> Matrix<ValueType>::operator-(const Matrix& other) const {
-    return Matrix(*this) -= other;
-}
-
-template<typename ValueType>
-Matrix<ValueType> Matrix<ValueType>::operator*(const Matrix& other) const {
-    if (empty() || other.empty() || contents.front().size() != other.contents.size()) {
-        THROW(out_of_range, "Can't multiply")
-    }
-    Matrix<ValueType> ans(Rows(), other.Columns());
-    MULTITHREAD_VOID(
-        for (size_t j = 0; j != Columns(); ++j) {
-            for (size_t k = 0; k != other.Columns(); ++k) {
-                ans[i][k] += contents[i][j] * other[j][k];
-            }
-        }
-    )
-    return ans;
-}
-
-template<typename ValueType>
-Matrix<ValueType> Matrix<ValueType>::operator*(const ValueType other) const {
-    return Matrix(*this) *= other;
-}
-
-template<typename ValueType>
-Matrix<ValueType> Matrix<ValueType>::operator/(ValueType other) const {
-    return Matrix(*this) /= other;
-}
-
-template<typename ValueType>
-ValueType Matrix<ValueType>::Tr() const {
-    ValueType ans{};
-    for (size_t i = 0; i != std::min(Rows(), Columns()); ++i) {
-        ans += contents[i][i];
-    }
-    return ans;
-}
-
-template<typename ValueType>
-Matrix<ValueType> Matrix<ValueType>::Transponed() const {
-    Matrix<ValueType> ans(Columns(), Rows());
-    MULTITHREAD_VOID(
-        for (size_t j = 0; j != Columns(); ++j) {
-            ans[j][i] = contents[i][j];
-        }
-    )
-    return ans;
-}
-
-template<typename ValueType>
-Matrix<ValueType>& Matrix<ValueType>::Transpone() {
-    *this = Transponed();
-    return *this;
-}
-
-template<typename ValueType>
-typename Matrix<ValueType>::iterator Matrix<ValueType>::begin() {
-    return contents.begin();
-}
-
-template<typename ValueType>
-typename Matrix<ValueType>::const_iterator Matrix<ValueType>::begin() const {
-    return contents.cbegin();
-}
-
-template<typename ValueType>
-typename Matrix<ValueType>::iterator Matrix<ValueType>::end() {
-    return contents.end();
-}
-
-template<typename ValueType>
-typename Matrix<ValueType>::const_iterator Matrix<ValueType>::end() const {
-    return contents.cend();
-}
-template<typename ValueType>
-Matrix<ValueType>& Matrix<ValueType>::Pow(size_t pow) const {
-    Matrix<ValueType> ans = Unit(Columns()), mult(*this);
-    while (pow != 0LL) {
-        if (pow & 1ULL) {
-            ans *= mult;
-        }
-        mult *= mult;
-        pow >>= 1ULL;
-    }
-    return ans;
-}
-
-template<typename ValueType>
-std::ostream& operator<<(std::ostream& out, const Matrix<ValueType>& mrx) {
-    for (const auto& i : mrx) {
-        for (const ValueType& j : i) {
-            out << j << ' ';
-        }
-        out << '\n';
-    }
-    return out;
-}
-
-template<typename ValueType>
-Matrix<ValueType> operator *(ValueType first, const Matrix<ValueType> &second) {
-    return second * first;
-}
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Exceptions.h"
+#include "Gemm.h"
+#include "MatrixExpression.h"
+#include "MatrixProfiler.h"
+#include "MatrixSimd.h"
+#include "MatrixStorage.h"
+#include "Reduction.h"
+#include "Strassen.h"
+#include "ThreadPool.h"
+#include "Transpose.h"
+
+#define BRUTE(name, a, b, cnt) for (int32_t name##cnt = a; name##cnt != b; ++name##cnt)
+#define BRUTE1(name, a, b) BRUTE(name,a,b,1)
+#define BRUTE2(name, a, b) BRUTE1(name,a,b) BRUTE(name,a,b,2)
+#define BRUTE3(name, a, b) BRUTE2(name,a,b) BRUTE(name,a,b,3)
+#define BRUTE4(name, a, b) BRUTE3(name,a,b) BRUTE(name,a,b,4)
+#define BRUTE5(name, a, b) BRUTE4(name,a,b) BRUTE(name,a,b,5)
+#define BRUTE6(name, a, b) BRUTE5(name,a,b) BRUTE(name,a,b,6)
+#define BRUTE7(name, a, b) BRUTE6(name,a,b) BRUTE(name,a,b,7)
+#define BRUTE8(name, a, b) BRUTE7(name,a,b) BRUTE(name,a,b,8)
+#define BRUTE9(name, a, b) BRUTE8(name,a,b) BRUTE(name,a,b,9)
+#define BRUTE10(name, a, b) BRUTE9(name,a,b) BRUTE(name,a,b,10)
+#define BRUTE11(name, a, b) BRUTE10(name,a,b) BRUTE(name,a,b,11)
+#define BRUTE12(name, a, b) BRUTE11(name,a,b) BRUTE(name,a,b,12)
+
+// Allocator defaults to 64-byte aligned heap blocks, ArenaAllocator gives scratch matrices that
+// live in the thread's arena (see MatrixStorage.h)
+template<typename ValueType = double, typename Allocator = AlignedAllocator<ValueType>>
+class Matrix : public MatrixExpression<Matrix<ValueType, Allocator>> {
+ public:
+    // Row-major, one allocation per matrix, row i starts at Data() + i * Stride()
+    using container_type = std::vector<ValueType, Allocator>;
+    using value_type = ValueType;
+    using allocator_type = Allocator;
+    using iterator = MatrixRowIterator<ValueType>;
+    using const_iterator = MatrixRowIterator<const ValueType>;
+
+    Matrix(size_t rows, size_t columns, ValueType value = ValueType()) :
+        contents(rows * columns, value), rows(rows), columns(columns) {}
+
+    Matrix(const std::vector<std::vector<ValueType>>& contents);
+
+    Matrix(const Matrix& other) = default;
+
+    // A moved-from matrix is left 0 x 0
+    Matrix(Matrix&& other) noexcept;
+
+    Matrix& operator=(const Matrix& other) = default;
+
+    Matrix& operator=(Matrix&& other) noexcept;
+
+    // Copy with another allocator, e.g. to keep an arena scratch matrix
+    template<typename OtherAllocator>
+    explicit Matrix(const Matrix<ValueType, OtherAllocator>& other);
+
+    // Evaluates a lazy expression in one pass
+    template<typename Expression>
+    Matrix(const MatrixExpression<Expression>& expression);
+
+    template<typename Expression>
+    Matrix& operator=(const MatrixExpression<Expression>& expression);
+
+    static Matrix Unit(size_t size);
+
+    [[nodiscard]] bool empty() const;
+
+    [[nodiscard]] std::pair<size_t, size_t> size() const;
+
+    [[nodiscard]] size_t Rows() const;
+
+    [[nodiscard]] size_t Columns() const;
+
+    // Changes the shape, elements are unspecified afterwards. The allocation is kept when it is
+    // large enough, so a matrix can be reused as a buffer for results of different sizes.
+    void Resize(size_t newRows, size_t newColumns);
+
+    // Distance in elements between the starts of neighbouring rows
+    [[nodiscard]] size_t Stride() const;
+
+    ValueType* Data();
+
+    const ValueType* Data() const;
+
+    MatrixBlock<ValueType> Block(size_t row, size_t column, size_t blockRows, size_t blockColumns);
+
+    MatrixBlock<const ValueType> Block(size_t row, size_t column,
+                                       size_t blockRows, size_t blockColumns) const;
+
+    operator MatrixBlock<ValueType>();
+
+    operator MatrixBlock<const ValueType>() const;
+
+    iterator begin();
+
+    const_iterator begin() const;
+
+    iterator end();
+
+    const_iterator end() const;
+
+    MatrixRow<ValueType> operator[](size_t idx);
+
+    MatrixRow<const ValueType> operator[](size_t idx) const;
+
+    const ValueType& At(size_t i, size_t j) const;
+
+    bool References(const void* matrix) const;
+
+    bool Aliases(const void* matrix) const;
+
+    bool operator==(const Matrix& other);
+
+    bool operator!=(const Matrix& other);
+
+    Matrix& operator-();
+
+    Matrix& operator+=(const Matrix& other);
+
+    Matrix& operator-=(const Matrix& other);
+
+    template<typename Expression>
+    Matrix& operator+=(const MatrixExpression<Expression>& other);
+
+    template<typename Expression>
+    Matrix& operator-=(const MatrixExpression<Expression>& other);
+
+    Matrix& operator*=(const Matrix& other);
+
+    Matrix& operator*=(ValueType other);
+
+    Matrix& operator/=(ValueType other);
+
+    ValueType Tr() const;
+
+    MatrixTransposedExpression<Matrix> Transponed() const;
+
+    Matrix& Transpone();
+
+    // Square matrices only, the scratch matrices live in the thread's arena and are swapped
+    // instead of reallocated every step
+    Matrix Pow(size_t pow) const;
+
+    // out = this * other, out already has the right size and isn't one of the operands
+    template<typename OtherAllocator, typename OutAllocator>
+    void MultiplyInto(const Matrix<ValueType, OtherAllocator>& other, Matrix<ValueType, OutAllocator>& out) const;
+ private:
+    // Calls function(from, to) for row ranges on the shared pool, small matrices stay on this thread
+    template<typename Function>
+    void ForEachRowRange(Function&& function) const;
+
+    // this[i][j] = update(this[i][j], expression.At(i, j)), sizes already checked
+    template<typename Expression, typename Update>
+    void Evaluate(const Expression& expression, Update update);
+
+    container_type contents;
+    size_t rows = 0;
+    size_t columns = 0;
+};
+
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator>::Matrix(const std::vector<std::vector<ValueType>>& other) :
+    rows(other.size()), columns(other.empty() ? 0 : other.front().size()) {
+    contents.reserve(rows * columns);
+    for (const auto& row : other) {
+        if (row.size() != columns) {
+            THROW(invalid_argument, "Rows differ in size")
+        }
+        contents.insert(contents.end(), row.begin(), row.end());
+    }
+}
+
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator>::Matrix(Matrix&& other) noexcept :
+    contents(std::move(other.contents)), rows(std::exchange(other.rows, 0)),
+    columns(std::exchange(other.columns, 0)) {
+    other.contents.clear();
+}
+
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator>& Matrix<ValueType, Allocator>::operator=(Matrix&& other) noexcept {
+    if (this != &other) {
+        contents = std::move(other.contents);
+        other.contents.clear();
+        rows = std::exchange(other.rows, 0);
+        columns = std::exchange(other.columns, 0);
+    }
+    return *this;
+}
+
+template<typename ValueType, typename Allocator>
+template<typename OtherAllocator>
+Matrix<ValueType, Allocator>::Matrix(const Matrix<ValueType, OtherAllocator>& other) :
+    contents(other.Data(), other.Data() + other.Rows() * other.Stride()), rows(other.Rows()),
+    columns(other.Columns()) {}
+
+template<typename ValueType, typename Allocator>
+template<typename Function>
+void Matrix<ValueType, Allocator>::ForEachRowRange(Function&& function) const {
+    size_t grain = ThreadPool::Instance().MinTaskSize() / std::max(Columns(), static_cast<size_t>(1));
+    ThreadPool::Instance().ParallelFor(0, Rows(), grain, function);
+}
+
+template<typename ValueType, typename Allocator>
+template<typename Expression, typename Update>
+void Matrix<ValueType, Allocator>::Evaluate(const Expression& expression, Update update) {
+    MATRIX_PROFILE("evaluate", Rows() * Columns(), Rows() * Columns() * sizeof(ValueType))
+    ForEachRowRange([&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            ValueType* row = Data() + i * Stride();
+            for (size_t j = 0; j != Columns(); ++j) {
+                row[j] = update(row[j], expression.At(i, j));
+            }
+        }
+    });
+}
+
+template<typename ValueType, typename Allocator>
+template<typename Expression>
+Matrix<ValueType, Allocator>::Matrix(const MatrixExpression<Expression>& expression) :
+    Matrix(expression.Self().Rows(), expression.Self().Columns()) {
+    if constexpr (std::is_same_v<Expression, MatrixTransposedExpression<Matrix>>) {
+        const Matrix& source = expression.Self().Source();
+        MATRIX_PROFILE("transpose", 0, 2 * source.Rows() * source.Columns() * sizeof(ValueType))
+        Transpose(source.Rows(), source.Columns(), source.Data(), source.Stride(), Data(), Stride());
+    } else {
+        Evaluate(expression.Self(), [](const ValueType&, const ValueType& value) { return value; });
+    }
+}
+
+template<typename ValueType, typename Allocator>
+template<typename Expression>
+Matrix<ValueType, Allocator>& Matrix<ValueType, Allocator>::operator=(const MatrixExpression<Expression>& expression) {
+    const Expression& self = expression.Self();
+    if constexpr (std::is_same_v<Expression, MatrixTransposedExpression<Matrix>>) {
+        if (&self.Source() == this) {
+            return Transpone();
+        }
+    }
+    if (self.Aliases(this)) {
+        ArenaScope scope;
+        Matrix<ValueType, ArenaAllocator<ValueType>> scratch(expression);
+        contents.assign(scratch.Data(), scratch.Data() + scratch.Rows() * scratch.Stride());
+        rows = scratch.Rows();
+        columns = scratch.Columns();
+        return *this;
+    }
+    if (size() != std::make_pair(self.Rows(), self.Columns())) {
+        contents.assign(self.Rows() * self.Columns(), ValueType());
+        rows = self.Rows();
+        columns = self.Columns();
+    }
+    if constexpr (std::is_same_v<Expression, MatrixTransposedExpression<Matrix>>) {
+        const Matrix& source = self.Source();
+        MATRIX_PROFILE("transpose", 0, 2 * source.Rows() * source.Columns() * sizeof(ValueType))
+        Transpose(source.Rows(), source.Columns(), source.Data(), source.Stride(), Data(), Stride());
+    } else {
+        Evaluate(self, [](const ValueType&, const ValueType& value) { return value; });
+    }
+    return *this;
+}
+
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator> Matrix<ValueType, Allocator>::Unit(size_t size) {
+    Matrix<ValueType, Allocator> ans(size, size);
+    for (size_t i = 0; i != size; ++i) {
+        ans[i][i] = 1;
+    }
+    return ans;
+}
+
+template<typename ValueType, typename Allocator>
+bool Matrix<ValueType, Allocator>::empty() const {
+    return rows == 0 || columns == 0;
+}
+
+template<typename ValueType, typename Allocator>
+std::pair<size_t, size_t> Matrix<ValueType, Allocator>::size() const {
+    return {Rows(), Columns()};
+}
+
+template<typename ValueType, typename Allocator>
+size_t Matrix<ValueType, Allocator>::Rows() const {
+    return rows;
+}
+
+template<typename ValueType, typename Allocator>
+size_t Matrix<ValueType, Allocator>::Columns() const {
+    return columns;
+}
+
+template<typename ValueType, typename Allocator>
+void Matrix<ValueType, Allocator>::Resize(size_t newRows, size_t newColumns) {
+    contents.resize(newRows * newColumns);
+    rows = newRows;
+    columns = newColumns;
+}
+
+template<typename ValueType, typename Allocator>
+size_t Matrix<ValueType, Allocator>::Stride() const {
+    return columns;
+}
+
+template<typename ValueType, typename Allocator>
+ValueType* Matrix<ValueType, Allocator>::Data() {
+    return contents.data();
+}
+
+template<typename ValueType, typename Allocator>
+const ValueType* Matrix<ValueType, Allocator>::Data() const {
+    return contents.data();
+}
+
+template<typename ValueType, typename Allocator>
+MatrixBlock<ValueType> Matrix<ValueType, Allocator>::Block(size_t row, size_t column,
+                                                size_t blockRows, size_t blockColumns) {
+    if (row + blockRows > Rows() || column + blockColumns > Columns()) {
+        THROW(out_of_range, "Block is out of matrix")
+    }
+    return {Data() + row * Stride() + column, blockRows, blockColumns, Stride()};
+}
+
+template<typename ValueType, typename Allocator>
+MatrixBlock<const ValueType> Matrix<ValueType, Allocator>::Block(size_t row, size_t column,
+                                                      size_t blockRows, size_t blockColumns) const {
+    if (row + blockRows > Rows() || column + blockColumns > Columns()) {
+        THROW(out_of_range, "Block is out of matrix")
+    }
+    return {Data() + row * Stride() + column, blockRows, blockColumns, Stride()};
+}
+
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator>::operator MatrixBlock<ValueType>() {
+    return {Data(), Rows(), Columns(), Stride()};
+}
+
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator>::operator MatrixBlock<const ValueType>() const {
+    return {Data(), Rows(), Columns(), Stride()};
+}
+
+template<typename ValueType, typename Allocator>
+MatrixRow<ValueType> Matrix<ValueType, Allocator>::operator[](size_t idx) {
+    return {Data() + idx * Stride(), Columns()};
+}
+
+template<typename ValueType, typename Allocator>
+MatrixRow<const ValueType> Matrix<ValueType, Allocator>::operator[](size_t idx) const {
+    return {Data() + idx * Stride(), Columns()};
+}
+
+template<typename ValueType, typename Allocator>
+const ValueType& Matrix<ValueType, Allocator>::At(size_t i, size_t j) const {
+    return contents[i * Stride() + j];
+}
+
+template<typename ValueType, typename Allocator>
+bool Matrix<ValueType, Allocator>::References(const void* matrix) const {
+    return matrix == this;
+}
+
+template<typename ValueType, typename Allocator>
+bool Matrix<ValueType, Allocator>::Aliases(const void*) const {
+    return false;
+}
+
+template<typename ValueType, typename Allocator>
+bool Matrix<ValueType, Allocator>::operator==(const Matrix& other) {
+    MATRIX_PROFILE("compare", Rows() * Columns(), 2 * Rows() * Columns() * sizeof(ValueType))
+    return size() == other.size() && contents == other.contents;
+}
+
+template<typename ValueType, typename Allocator>
+bool Matrix<ValueType, Allocator>::operator!=(const Matrix& other) {
+    return !(*this == other);
+}
+
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator>& Matrix<ValueType, Allocator>::operator-() {
+    for (auto& i : contents) {
+        i = -i;
+    }
+    return *this;
+}
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator>& Matrix<ValueType, Allocator>::operator+=(const Matrix& other) {
+    if (empty() || size() != other.size()) {
+        THROW(out_of_range, "Matrices differ in size")
+    }
+    MATRIX_PROFILE("add", Rows() * Columns(), 3 * Rows() * Columns() * sizeof(ValueType))
+    ForEachRowRange([&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            VectorAdd(Data() + i * Stride(), other.Data() + i * other.Stride(), Columns());
+        }
+    });
+    return *this;
+}
+
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator>& Matrix<ValueType, Allocator>::operator-=(const Matrix& other) {
+    if (size() != other.size()) {
+        THROW(out_of_range, "Matrices differ in size")
+    }
+    MATRIX_PROFILE("subtract", Rows() * Columns(), 3 * Rows() * Columns() * sizeof(ValueType))
+    ForEachRowRange([&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            VectorSubtract(Data() + i * Stride(), other.Data() + i * other.Stride(), Columns());
+        }
+    });
+    return *this;
+}
+
+template<typename ValueType, typename Allocator>
+template<typename Expression>
+Matrix<ValueType, Allocator>& Matrix<ValueType, Allocator>::operator+=(const MatrixExpression<Expression>& other) {
+    const Expression& self = other.Self();
+    if (empty() || size() != std::make_pair(self.Rows(), self.Columns())) {
+        THROW(out_of_range, "Matrices differ in size")
+    }
+    if (self.Aliases(this)) {
+        return *this += Matrix(other);
+    }
+    Evaluate(self, [](const ValueType& value, const ValueType& add) { return value + add; });
+    return *this;
+}
+
+template<typename ValueType, typename Allocator>
+template<typename Expression>
+Matrix<ValueType, Allocator>& Matrix<ValueType, Allocator>::operator-=(const MatrixExpression<Expression>& other) {
+    const Expression& self = other.Self();
+    if (size() != std::make_pair(self.Rows(), self.Columns())) {
+        THROW(out_of_range, "Matrices differ in size")
+    }
+    if (self.Aliases(this)) {
+        return *this -= Matrix(other);
+    }
+    Evaluate(self, [](const ValueType& value, const ValueType& sub) { return value - sub; });
+    return *this;
+}
+
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator>& Matrix<ValueType, Allocator>::operator*=(const Matrix& other) {
+    *this = std::move(*this * other);
+    return *this;
+}
+
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator>& Matrix<ValueType, Allocator>::operator*=(const ValueType other) {
+    MATRIX_PROFILE("scale", Rows() * Columns(), 2 * Rows() * Columns() * sizeof(ValueType))
+    ForEachRowRange([&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            VectorMultiply(Data() + i * Stride(), other, Columns());
+        }
+    });
+    return *this;
+}
+
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator>& Matrix<ValueType, Allocator>::operator/=(ValueType other) {
+    MATRIX_PROFILE("divide", Rows() * Columns(), 2 * Rows() * Columns() * sizeof(ValueType))
+    ForEachRowRange([&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            VectorDivide(Data() + i * Stride(), other, Columns());
+        }
+    });
+    return *this;
+}
+
+template<typename ValueType, typename Allocator>
+template<typename OtherAllocator, typename OutAllocator>
+void Matrix<ValueType, Allocator>::MultiplyInto(const Matrix<ValueType, OtherAllocator>& other,
+                                                Matrix<ValueType, OutAllocator>& out) const {
+    MATRIX_PROFILE("multiply", 2 * Rows() * Columns() * other.Columns(),
+                   (Rows() * Columns() + other.Rows() * other.Columns() + out.Rows() * out.Columns()) *
+                   sizeof(ValueType))
+    if constexpr (UsesStrassen<ValueType>::value) {
+        size_t n = Rows();
+        if (n >= StrassenCutoff<ValueType>() && Columns() == n && other.Columns() == n) {
+            Strassen(n, Data(), Stride(), other.Data(), other.Stride(), out.Data(), out.Stride());
+            return;
+        }
+    }
+    std::fill(out.Data(), out.Data() + out.Rows() * out.Stride(), ValueType(0));
+    Gemm(Rows(), other.Columns(), Columns(), ValueType(1),
+         Data(), Stride(), static_cast<size_t>(1),
+         other.Data(), other.Stride(), static_cast<size_t>(1),
+         out.Data(), out.Stride());
+}
+
+template<typename ValueType, typename Allocator>
+ValueType Matrix<ValueType, Allocator>::Tr() const {
+    MATRIX_PROFILE("trace", std::min(Rows(), Columns()), std::min(Rows(), Columns()) * sizeof(ValueType))
+    return ReduceStridedSum(Data(), std::min(Rows(), Columns()), Stride() + 1);
+}
+
+template<typename ValueType, typename Allocator>
+MatrixTransposedExpression<Matrix<ValueType, Allocator>> Matrix<ValueType, Allocator>::Transponed() const {
+    return MatrixTransposedExpression<Matrix>(*this);
+}
+
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator>& Matrix<ValueType, Allocator>::Transpone() {
+    MATRIX_PROFILE("transpose_in_place", 0, 2 * Rows() * Columns() * sizeof(ValueType))
+    TransposeInPlace(Rows(), Columns(), Data());
+    std::swap(rows, columns);
+    return *this;
+}
+
+template<typename ValueType, typename Allocator>
+typename Matrix<ValueType, Allocator>::iterator Matrix<ValueType, Allocator>::begin() {
+    return {Data(), Columns(), Stride()};
+}
+
+template<typename ValueType, typename Allocator>
+typename Matrix<ValueType, Allocator>::const_iterator Matrix<ValueType, Allocator>::begin() const {
+    return {Data(), Columns(), Stride()};
+}
+
+template<typename ValueType, typename Allocator>
+typename Matrix<ValueType, Allocator>::iterator Matrix<ValueType, Allocator>::end() {
+    return {Data() + Rows() * Stride(), Columns(), Stride()};
+}
+
+template<typename ValueType, typename Allocator>
+typename Matrix<ValueType, Allocator>::const_iterator Matrix<ValueType, Allocator>::end() const {
+    return {Data() + Rows() * Stride(), Columns(), Stride()};
+}
+template<typename ValueType, typename Allocator>
+Matrix<ValueType, Allocator> Matrix<ValueType, Allocator>::Pow(size_t pow) const {
+    if (empty() || Rows() != Columns()) {
+        THROW(out_of_range, "Can't raise a non-square matrix to a power")
+    }
+    MATRIX_PROFILE("pow", 0, 0)
+    ArenaScope scope;
+    Matrix<ValueType, ArenaAllocator<ValueType>> ans(Rows(), Columns()), mult(*this), buffer(Rows(), Columns());
+    bool unit = true;
+    while (pow != 0) {
+        if (pow & 1ULL) {
+            if (unit) {
+                ans = mult;
+                unit = false;
+            } else {
+                ans.MultiplyInto(mult, buffer);
+                std::swap(ans, buffer);
+            }
+        }
+        pow >>= 1ULL;
+        if (pow != 0) {
+            mult.MultiplyInto(mult, buffer);
+            std::swap(mult, buffer);
+        }
+    }
+    return unit ? Unit(Columns()) : Matrix(ans);
+}
+
+template<typename ValueType, typename Allocator>
+std::ostream& operator<<(std::ostream& out, const Matrix<ValueType, Allocator>& mrx) {
+    for (const auto& i : mrx) {
+        for (const ValueType& j : i) {
+            out << j << ' ';
+        }
+        out << '\n';
+    }
+    return out;
+}
+
+template<typename Expression>
+std::ostream& operator<<(std::ostream& out, const MatrixExpression<Expression>& expression) {
+    using ValueType = typename Expression::value_type;
+    ArenaScope scope;
+    return out << Matrix<ValueType, ArenaAllocator<ValueType>>(expression);
+}
+
+template<typename Left, typename Right>
+MatrixBinaryExpression<Left, Right, std::plus<>> operator+(const MatrixExpression<Left>& first,
+                                                           const MatrixExpression<Right>& second) {
+    if (first.Self().Rows() != second.Self().Rows() || first.Self().Columns() != second.Self().Columns()) {
+        THROW(out_of_range, "Matrices differ in size")
+    }
+    return {first.Self(), second.Self()};
+}
+
+template<typename Left, typename Right>
+MatrixBinaryExpression<Left, Right, std::minus<>> operator-(const MatrixExpression<Left>& first,
+                                                            const MatrixExpression<Right>& second) {
+    if (first.Self().Rows() != second.Self().Rows() || first.Self().Columns() != second.Self().Columns()) {
+        THROW(out_of_range, "Matrices differ in size")
+    }
+    return {first.Self(), second.Self()};
+}
+
+template<typename Expression>
+MatrixScalarExpression<Expression, std::multiplies<>> operator*(const MatrixExpression<Expression>& first,
+                                                                typename Expression::value_type second) {
+    return {first.Self(), second};
+}
+
+template<typename Expression>
+MatrixScalarExpression<Expression, std::multiplies<>> operator*(typename Expression::value_type first,
+                                                                const MatrixExpression<Expression>& second) {
+    return {second.Self(), first};
+}
+
+template<typename Expression>
+MatrixScalarExpression<Expression, std::divides<>> operator/(const MatrixExpression<Expression>& first,
+                                                             typename Expression::value_type second) {
+    return {first.Self(), second};
+}
+
+template<typename Expression>
+struct IsMatrix : std::false_type {};
+
+template<typename ValueType, typename Allocator>
+struct IsMatrix<Matrix<ValueType, Allocator>> : std::true_type {};
+
+// The only matrix product overload, so Matrix * expression needs no conversion and isn't
+// ambiguous. Operands that are lazy expressions are materialized in the arena first, then
+// everything goes through the GEMM kernel; only the result is allocated on the heap. A product
+// of two matrices with the same allocator keeps that allocator.
+template<typename Left, typename Right>
+auto operator*(const MatrixExpression<Left>& first, const MatrixExpression<Right>& second) {
+    using ValueType = typename Left::value_type;
+    const Left& left = first.Self();
+    const Right& right = second.Self();
+    if (left.Rows() == 0 || left.Columns() == 0 || right.Columns() == 0 || left.Columns() != right.Rows()) {
+        THROW(out_of_range, "Can't multiply")
+    }
+    if constexpr (IsMatrix<Left>::value && std::is_same_v<Left, Right>) {
+        Left ans(left.Rows(), right.Columns());
+        left.MultiplyInto(right, ans);
+        return ans;
+    } else {
+        ArenaScope scope;
+        Matrix<ValueType> ans(left.Rows(), right.Columns());
+        if constexpr (IsMatrix<Left>::value && IsMatrix<Right>::value) {
+            left.MultiplyInto(right, ans);
+        } else if constexpr (IsMatrix<Left>::value) {
+            left.MultiplyInto(Matrix<ValueType, ArenaAllocator<ValueType>>(second), ans);
+        } else if constexpr (IsMatrix<Right>::value) {
+            Matrix<ValueType, ArenaAllocator<ValueType>>(first).MultiplyInto(right, ans);
+        } else {
+            Matrix<ValueType, ArenaAllocator<ValueType>> leftValue(first), rightValue(second);
+            leftValue.MultiplyInto(rightValue, ans);
+        }
+        return ans;
+    }
+}
+
+template<typename Left, typename Right>
+bool operator==(const MatrixExpression<Left>& first, const MatrixExpression<Right>& second) {
+    using ValueType = typename Left::value_type;
+    ArenaScope scope;
+    Matrix<ValueType, ArenaAllocator<ValueType>> left(first), right(second);
+    return left == right;
+}
+
+template<typename Left, typename Right>
+bool operator!=(const MatrixExpression<Left>& first, const MatrixExpression<Right>& second) {
+    return !(first == second);
+}
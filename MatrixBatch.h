@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "Matrix.h"
+#include "MatrixSimd.h"
+#include "MatrixStorage.h"
+#include "ThreadPool.h"
+
+// Many small matrices of one shape, interleaved so that a vector register holds the same element
+// of consecutive matrices. Matrices are grouped by BatchLanes<ValueType>() (one cache line), and
+// element (i, j) of matrix index lives at
+//     ((group * rows + i) * columns + j) * lanes + lane,   group = index / lanes, lane = index % lanes,
+// so a product runs the ordinary triple loop on whole groups and every step is one vertical
+// vector operation across the batch. Unused lanes of the last group stay zero.
+
+template<typename ValueType>
+constexpr size_t BatchLanes() {
+    return sizeof(ValueType) >= 64 ? 1 : 64 / sizeof(ValueType);
+}
+
+template<typename ValueType = double>
+class MatrixBatch {
+ public:
+    using container_type = std::vector<ValueType, AlignedAllocator<ValueType>>;
+    using value_type = ValueType;
+
+    static constexpr size_t kLanes = BatchLanes<ValueType>();
+
+    MatrixBatch(size_t count, size_t rows, size_t columns) :
+        contents((count + kLanes - 1) / kLanes * rows * columns * kLanes), count(count), rows(rows),
+        columns(columns) {}
+
+    [[nodiscard]] size_t Count() const {
+        return count;
+    }
+
+    [[nodiscard]] size_t Rows() const {
+        return rows;
+    }
+
+    [[nodiscard]] size_t Columns() const {
+        return columns;
+    }
+
+    [[nodiscard]] size_t Groups() const {
+        return (count + kLanes - 1) / kLanes;
+    }
+
+    ValueType* Data() {
+        return contents.data();
+    }
+
+    const ValueType* Data() const {
+        return contents.data();
+    }
+
+    ValueType& At(size_t index, size_t i, size_t j) {
+        return contents[Offset(index, i, j)];
+    }
+
+    const ValueType& At(size_t index, size_t i, size_t j) const {
+        return contents[Offset(index, i, j)];
+    }
+
+    void Set(size_t index, const Matrix<ValueType>& matrix) {
+        if (matrix.Rows() != rows || matrix.Columns() != columns) {
+            THROW(out_of_range, "Matrices differ in size")
+        }
+        for (size_t i = 0; i != rows; ++i) {
+            for (size_t j = 0; j != columns; ++j) {
+                At(index, i, j) = matrix[i][j];
+            }
+        }
+    }
+
+    Matrix<ValueType> Get(size_t index) const {
+        Matrix<ValueType> ans(rows, columns);
+        for (size_t i = 0; i != rows; ++i) {
+            for (size_t j = 0; j != columns; ++j) {
+                ans[i][j] = At(index, i, j);
+            }
+        }
+        return ans;
+    }
+
+ private:
+    [[nodiscard]] size_t Offset(size_t index, size_t i, size_t j) const {
+        return ((index / kLanes * rows + i) * columns + j) * kLanes + index % kLanes;
+    }
+
+    container_type contents;
+    size_t count;
+    size_t rows;
+    size_t columns;
+};
+
+// c = a * b for one group, a is m x k, b is k x n, all interleaved by Lanes. Four elements of
+// a row of c are accumulated at once in local arrays, which the compiler keeps in registers.
+template<typename ValueType, size_t Lanes>
+__attribute__((always_inline))
+inline void BatchGroupMultiply(size_t m, size_t n, size_t k, const ValueType* a, const ValueType* b, ValueType* c) {
+    constexpr size_t width = 4;
+    for (size_t i = 0; i != m; ++i) {
+        const ValueType* row = a + i * k * Lanes;
+        ValueType* out = c + i * n * Lanes;
+        size_t j = 0;
+        for (; j + width <= n; j += width) {
+            ValueType acc[width][Lanes]{};
+            for (size_t l = 0; l != k; ++l) {
+                const ValueType* x = row + l * Lanes;
+                const ValueType* y = b + (l * n + j) * Lanes;
+#pragma GCC unroll 4
+                for (size_t p = 0; p != width; ++p) {
+                    for (size_t lane = 0; lane != Lanes; ++lane) {
+                        acc[p][lane] += x[lane] * y[p * Lanes + lane];
+                    }
+                }
+            }
+            std::copy(&acc[0][0], &acc[0][0] + width * Lanes, out + j * Lanes);
+        }
+        for (; j != n; ++j) {
+            ValueType acc[Lanes]{};
+            for (size_t l = 0; l != k; ++l) {
+                const ValueType* x = row + l * Lanes;
+                const ValueType* y = b + (l * n + j) * Lanes;
+                for (size_t lane = 0; lane != Lanes; ++lane) {
+                    acc[lane] += x[lane] * y[lane];
+                }
+            }
+            std::copy(acc, acc + Lanes, out + j * Lanes);
+        }
+    }
+}
+
+template<typename ValueType>
+using BatchKernel = void (*)(size_t m, size_t n, size_t k, const ValueType* a, const ValueType* b, ValueType* c);
+
+template<typename ValueType>
+void BatchGroupMultiplyGeneric(size_t m, size_t n, size_t k, const ValueType* a, const ValueType* b, ValueType* c) {
+    BatchGroupMultiply<ValueType, BatchLanes<ValueType>()>(m, n, k, a, b, c);
+}
+
+#ifdef MATRIX_SIMD_X86
+// The same loop compiled for wider registers, picked at runtime like the kernels in MatrixSimd.h
+template<typename ValueType>
+__attribute__((target("avx2,fma")))
+void BatchGroupMultiplyAvx2(size_t m, size_t n, size_t k, const ValueType* a, const ValueType* b, ValueType* c) {
+    BatchGroupMultiply<ValueType, BatchLanes<ValueType>()>(m, n, k, a, b, c);
+}
+
+template<typename ValueType>
+__attribute__((target("avx512f")))
+void BatchGroupMultiplyAvx512(size_t m, size_t n, size_t k, const ValueType* a, const ValueType* b, ValueType* c) {
+    BatchGroupMultiply<ValueType, BatchLanes<ValueType>()>(m, n, k, a, b, c);
+}
+#endif
+
+template<typename ValueType>
+BatchKernel<ValueType> SelectBatchKernel() {
+#ifdef MATRIX_SIMD_X86
+    switch (CurrentSimdLevel()) {
+        case SimdLevel::Avx512:
+            return BatchGroupMultiplyAvx512<ValueType>;
+        case SimdLevel::Avx2:
+            return BatchGroupMultiplyAvx2<ValueType>;
+        default:
+            break;
+    }
+#endif
+    return BatchGroupMultiplyGeneric<ValueType>;
+}
+
+// c[i] = a[i] * b[i] for `count` interleaved m x k and k x n operands. Groups of the batch, not
+// rows of a product, are spread over the pool.
+template<typename ValueType>
+void BatchedMultiply(size_t count, size_t m, size_t n, size_t k, const ValueType* a, const ValueType* b,
+                     ValueType* c) {
+    constexpr size_t lanes = BatchLanes<ValueType>();
+    size_t groups = (count + lanes - 1) / lanes;
+    BatchKernel<ValueType> kernel = SelectBatchKernel<ValueType>();
+    size_t work = std::max(m * n * k * lanes, static_cast<size_t>(1));
+    ThreadPool::Instance().ParallelFor(0, groups, ThreadPool::Instance().MinTaskSize() / work,
+                                       [&](size_t from, size_t to) {
+        for (size_t group = from; group != to; ++group) {
+            kernel(m, n, k, a + group * m * k * lanes, b + group * k * n * lanes, c + group * m * n * lanes);
+        }
+    });
+}
+
+template<typename ValueType>
+void BatchedMultiply(const MatrixBatch<ValueType>& a, const MatrixBatch<ValueType>& b, MatrixBatch<ValueType>& c) {
+    if (a.Count() != b.Count() || a.Count() != c.Count() || a.Columns() != b.Rows() ||
+        c.Rows() != a.Rows() || c.Columns() != b.Columns()) {
+        THROW(out_of_range, "Can't multiply")
+    }
+    BatchedMultiply(a.Count(), a.Rows(), b.Columns(), a.Columns(), a.Data(), b.Data(), c.Data());
+}
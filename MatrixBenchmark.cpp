@@ -0,0 +1,109 @@
+#include <cmath>
+#include <cstdlib>
+#include <forward_list>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Matrix.h"
+
+// Usage: MatrixBenchmark [sizes...] [--mc=N] [--kc=N] [--nc=N] [--simd=scalar|avx2|avx512]
+//                        [--strassen=CUTOFF]
+// Prints GFLOP/s of Matrix<double>::operator* against the old row-split triple loop, and the
+// heap allocations and peak heap bytes of the blocked product. Built with -DMATRIX_PROFILING it
+// also writes the per-operation profile as JSON to stderr.
+
+using Rows = std::vector<std::vector<double>>;
+
+// The multiplication Matrix.h used before the blocked kernel: nested vectors, one task per row chunk
+Rows ReferenceMultiply(const Rows& a, const Rows& b) {
+    size_t n = a.size(), m = b.size(), k = b.front().size();
+    Rows ans(n, std::vector<double>(k));
+    size_t rowsForThread = std::max(n / std::thread::hardware_concurrency(), static_cast<size_t>(1));
+    std::forward_list<std::future<void>> futures;
+    for (size_t from = 0; from != n;) {
+        size_t to = n - from < 2 * rowsForThread ? n : from + rowsForThread;
+        futures.push_front(std::async([&, from, to] {
+            for (size_t i = from; i != to; ++i) {
+                for (size_t j = 0; j != m; ++j) {
+                    for (size_t l = 0; l != k; ++l) {
+                        ans[i][l] += a[i][j] * b[j][l];
+                    }
+                }
+            }
+        }));
+        from = to;
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+    return ans;
+}
+
+double GFlops(size_t n, double seconds) {
+    return 2.0 * n * n * n / seconds * 1e-9;
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--mc=", 0) == 0) {
+            GemmBlockSizes<double>().mc = std::stoul(arg.substr(5));
+        } else if (arg.rfind("--kc=", 0) == 0) {
+            GemmBlockSizes<double>().kc = std::stoul(arg.substr(5));
+        } else if (arg.rfind("--nc=", 0) == 0) {
+            GemmBlockSizes<double>().nc = std::stoul(arg.substr(5));
+        } else if (arg.rfind("--strassen=", 0) == 0) {
+            StrassenCutoff<double>() = std::stoul(arg.substr(11));
+        } else if (!ParseSimdFlag(arg)) {
+            sizes.push_back(std::stoul(arg));
+        }
+    }
+    if (sizes.empty()) {
+        sizes = {256, 512, 1024, 2048};
+    }
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    std::cout << std::setw(6) << "n" << std::setw(14) << "reference" << std::setw(14) << "blocked"
+              << std::setw(10) << "speedup" << "   (GFLOP/s)\n";
+    for (size_t n : sizes) {
+        Rows a(n, std::vector<double>(n)), b(n, std::vector<double>(n));
+        for (size_t i = 0; i != n; ++i) {
+            for (size_t j = 0; j != n; ++j) {
+                a[i][j] = dist(rng);
+                b[i][j] = dist(rng);
+            }
+        }
+        Matrix<double> ma(a), mb(b);
+
+        Rows reference;
+        double referenceTime = Seconds([&] { reference = ReferenceMultiply(a, b); });
+        Matrix<double> blocked(0, 0);
+        double blockedTime = 0;
+        AllocationStats allocations = MeasureAllocations([&] { blockedTime = Seconds([&] { blocked = ma * mb; }); });
+
+        double maxError = 0;
+        for (size_t i = 0; i != n; ++i) {
+            for (size_t j = 0; j != n; ++j) {
+                maxError = std::max(maxError, std::abs(reference[i][j] - blocked[i][j]));
+            }
+        }
+        std::cout << std::setw(6) << n << std::fixed << std::setprecision(2)
+                  << std::setw(14) << GFlops(n, referenceTime)
+                  << std::setw(14) << GFlops(n, blockedTime)
+                  << std::setw(9) << referenceTime / blockedTime << 'x'
+                  << "   max error " << std::scientific << maxError << std::defaultfloat
+                  << "   allocations " << allocations.allocations << " (+" << allocations.arenaAllocations
+                  << " arena), peak " << allocations.peakBytes / 1e6 << " MB\n";
+    }
+    if (MatrixProfiler::Enabled()) {
+        MatrixProfiler::Instance().WriteJson(std::cerr);
+    }
+}
@@ -0,0 +1,456 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "IntervalDP.h"
+#include "Matrix.h"
+
+// Optimal multiplication order of a matrix chain. Matrix i of the chain is
+// dimensions[i] x dimensions[i + 1]. MatrixChainOrder(dimensions) is the O(n log n) Hu-Shing
+// algorithm for the number of scalar multiplications, MatrixChainOrderDP the O(n^3) interval DP
+// kept as a reference, and MatrixChainOrder(dimensions, cost) runs the DP with another cost model
+// (Strassen, sparse operands, memory-bound) through IntervalDP.h. All of them return the cost of
+// an optimal order and its products; when several orders are optimal they may pick different
+// ones. Costs are exact as long as the optimum fits in uint64_t.
+
+constexpr size_t kChainLeaf = static_cast<size_t>(-1);
+
+// One product of an ordering: matrices first..last computed as (first..split) * (split + 1..last).
+// left and right index the nodes producing the two factors, kChainLeaf for a single matrix.
+// cost is that of this product alone under the model the order was built for.
+struct ChainNode {
+    size_t first;
+    size_t split;
+    size_t last;
+    size_t left;
+    size_t right;
+    uint64_t cost;
+};
+
+struct ChainOrder {
+    uint64_t cost = 0;
+    // Children before parents, the whole product last; empty for a single matrix
+    std::vector<ChainNode> nodes;
+};
+
+// Turns split(first, last) into the post-order node list of a chain of count matrices, nodes
+// priced by cost(first, split, last). Iterative since chains can be deep.
+template<typename Split, typename Cost>
+ChainOrder BuildChainOrder(size_t count, Split split, const Cost& cost) {
+    struct Frame {
+        size_t first;
+        size_t last;
+        size_t split;
+        bool expanded;
+    };
+    ChainOrder ans;
+    ans.nodes.reserve(count - 1);
+    std::vector<Frame> frames{{0, count - 1, 0, false}};
+    std::vector<size_t> results;
+    while (!frames.empty()) {
+        Frame frame = frames.back();
+        if (frame.first == frame.last) {
+            results.push_back(kChainLeaf);
+            frames.pop_back();
+            continue;
+        }
+        if (!frame.expanded) {
+            size_t middle = split(frame.first, frame.last);
+            frames.back().split = middle;
+            frames.back().expanded = true;
+            frames.push_back({middle + 1, frame.last, 0, false});
+            frames.push_back({frame.first, middle, 0, false});
+            continue;
+        }
+        size_t right = results.back();
+        results.pop_back();
+        size_t left = results.back();
+        results.pop_back();
+        uint64_t nodeCost = cost(frame.first, frame.split, frame.last);
+        ans.cost += nodeCost;
+        ans.nodes.push_back({frame.first, frame.split, frame.last, left, right, nodeCost});
+        results.push_back(ans.nodes.size() - 1);
+        frames.pop_back();
+    }
+    return ans;
+}
+
+inline void CheckChainDimensions(const std::vector<uint64_t>& dimensions) {
+    if (dimensions.size() < 2) {
+        THROW(invalid_argument, "A chain needs at least one matrix")
+    }
+}
+
+// Chain dimensions from (rows, columns) of every matrix
+inline std::vector<uint64_t> ChainDimensions(const std::vector<std::pair<uint64_t, uint64_t>>& shapes) {
+    if (shapes.empty()) {
+        THROW(invalid_argument, "A chain needs at least one matrix")
+    }
+    std::vector<uint64_t> ans{shapes[0].first};
+    for (size_t i = 0; i != shapes.size(); ++i) {
+        if (shapes[i].first != ans.back()) {
+            THROW(invalid_argument, "Matrix " << i + 1 << " has " << shapes[i].first << " rows, expected "
+                                              << ans.back())
+        }
+        ans.push_back(shapes[i].second);
+    }
+    return ans;
+}
+
+// Cost models: the price of (l..k) * (k + 1..r) for a chain. They keep a reference to the
+// dimensions, which must outlive them.
+
+// Scalar multiplications of the classical product
+class ChainProductCost {
+ public:
+    explicit ChainProductCost(const std::vector<uint64_t>& dimensions) : d(dimensions) {}
+
+    uint64_t operator()(size_t l, size_t k, size_t r) const {
+        return d[l] * d[k + 1] * d[r + 1];
+    }
+
+ private:
+    const std::vector<uint64_t>& d;
+};
+
+// Scalar multiplications when square products of at least cutoff go through Strassen like
+// Matrix::operator* does: 7^levels products of ceil(n / 2^levels) blocks
+class StrassenChainCost {
+ public:
+    StrassenChainCost(const std::vector<uint64_t>& dimensions, uint64_t cutoff) : d(dimensions), cutoff(cutoff) {}
+
+    uint64_t operator()(size_t l, size_t k, size_t r) const {
+        uint64_t n = d[l];
+        if (n < cutoff || d[k + 1] != n || d[r + 1] != n) {
+            return d[l] * d[k + 1] * d[r + 1];
+        }
+        uint64_t products = 1;
+        size_t levels = 0;
+        while ((n >> levels) > cutoff) {
+            ++levels;
+            products *= 7;
+        }
+        uint64_t block = ((n - 1) >> levels) + 1;
+        return products * block * block * block;
+    }
+
+ private:
+    const std::vector<uint64_t>& d;
+    uint64_t cutoff;
+};
+
+// Expected scalar multiplications when input matrix i has density[i] non-zeros; products are dense
+class SparseChainCost {
+ public:
+    SparseChainCost(const std::vector<uint64_t>& dimensions, const std::vector<double>& density) :
+        d(dimensions), density(density) {}
+
+    uint64_t operator()(size_t l, size_t k, size_t r) const {
+        double left = k == l ? density[l] : 1.0;
+        double right = k + 1 == r ? density[r] : 1.0;
+        return static_cast<uint64_t>(static_cast<double>(d[l] * d[k + 1] * d[r + 1]) * left * right + 0.5);
+    }
+
+ private:
+    const std::vector<uint64_t>& d;
+    const std::vector<double>& density;
+};
+
+// Nanoseconds of a product limited by arithmetic or by moving its three operands, whichever is
+// slower: small or thin products are bandwidth-bound
+class MemoryBoundChainCost {
+ public:
+    MemoryBoundChainCost(const std::vector<uint64_t>& dimensions, double flopsPerNanosecond,
+                         double bytesPerNanosecond, size_t elementSize = sizeof(double)) :
+        d(dimensions), flopsPerNanosecond(flopsPerNanosecond), bytesPerNanosecond(bytesPerNanosecond),
+        elementSize(elementSize) {}
+
+    uint64_t operator()(size_t l, size_t k, size_t r) const {
+        double m = static_cast<double>(d[l]);
+        double inner = static_cast<double>(d[k + 1]);
+        double n = static_cast<double>(d[r + 1]);
+        double compute = 2 * m * inner * n / flopsPerNanosecond;
+        double memory = (m * inner + inner * n + m * n) * static_cast<double>(elementSize) / bytesPerNanosecond;
+        return static_cast<uint64_t>(std::max(compute, memory) + 0.5);
+    }
+
+ private:
+    const std::vector<uint64_t>& d;
+    double flopsPerNanosecond;
+    double bytesPerNanosecond;
+    size_t elementSize;
+};
+
+// Optimal order under any cost model through the parallel interval DP, O(n^2) memory and
+// O(n^3) time (O(n^2) with options.knuthPruning where that is exact)
+template<typename Cost>
+ChainOrder MatrixChainOrder(const std::vector<uint64_t>& dimensions, const Cost& cost,
+                            const IntervalDPOptions& options = {}) {
+    CheckChainDimensions(dimensions);
+    size_t n = dimensions.size() - 1;
+    IntervalDP<uint64_t> table = IntervalDP<uint64_t>::Solve(n, cost, options);
+    return BuildChainOrder(n, [&](size_t first, size_t last) { return table.Split(first, last); }, cost);
+}
+
+// Reference for MatrixChainOrder(dimensions)
+inline ChainOrder MatrixChainOrderDP(const std::vector<uint64_t>& dimensions) {
+    return MatrixChainOrder(dimensions, ChainProductCost(dimensions));
+}
+
+// Leftist max-heap of supporting weights num / den over one node pool, merged in O(log n)
+class ChainSupportHeap {
+ public:
+    static constexpr size_t kEmpty = static_cast<size_t>(-1);
+
+    struct Entry {
+        __int128 num;
+        __int128 den;
+        size_t left;
+        size_t right;
+        size_t rank;
+    };
+
+    explicit ChainSupportHeap(size_t capacity) {
+        entries.reserve(capacity);
+    }
+
+    const Entry& operator[](size_t heap) const {
+        return entries[heap];
+    }
+
+    size_t Push(size_t heap, __int128 num, __int128 den) {
+        entries.push_back({num, den, kEmpty, kEmpty, 1});
+        return Merge(heap, entries.size() - 1);
+    }
+
+    size_t Pop(size_t heap) {
+        return Merge(entries[heap].left, entries[heap].right);
+    }
+
+    size_t Merge(size_t first, size_t second) {
+        if (first == kEmpty) {
+            return second;
+        }
+        if (second == kEmpty) {
+            return first;
+        }
+        if (entries[first].num * entries[second].den < entries[second].num * entries[first].den) {
+            std::swap(first, second);
+        }
+        size_t right = Merge(entries[first].right, second);
+        entries[first].right = right;
+        if (Rank(entries[first].left) < Rank(right)) {
+            std::swap(entries[first].left, entries[first].right);
+        }
+        entries[first].rank = Rank(entries[first].right) + 1;
+        return first;
+    }
+
+ private:
+    [[nodiscard]] size_t Rank(size_t heap) const {
+        return heap == kEmpty ? 0 : entries[heap].rank;
+    }
+
+    std::vector<Entry> entries;
+};
+
+// Hu-Shing: the chain is a convex polygon with vertex weights d[0..n], every triangulation an
+// order costing the sum of its triangles' weight products. Rotated so vertex 0 has the smallest
+// weight, the potential h-arcs (i, j), whose inner vertices all outweigh both ends, are nested
+// and found in one stack sweep. Some optimal triangulation keeps a subset S of them and fans every
+// region between an arc of S and the arcs of S below it from the lighter end of the arc (the
+// whole polygon from vertex 0). Bottom-up over the arc tree, the best cost above arc h fanned
+// from an outside vertex of weight t is a concave piecewise linear f_h(t): it equals the
+// contents fanned from t for t below h's supporting weight s_h and keeps h above it. The
+// breakpoints live in mergeable heaps and every arc enters and leaves one once: O(n log n).
+inline ChainOrder MatrixChainOrder(const std::vector<uint64_t>& dimensions) {
+    using Wide = __int128;
+    CheckChainDimensions(dimensions);
+    size_t vertices = dimensions.size();
+    if (vertices <= 3) {
+        return BuildChainOrder(vertices - 1, [](size_t first, size_t) { return first; },
+                               ChainProductCost(dimensions));
+    }
+    size_t shift = std::min_element(dimensions.begin(), dimensions.end()) - dimensions.begin();
+    std::vector<Wide> w(vertices + 1);
+    for (size_t v = 0; v != vertices; ++v) {
+        w[v] = dimensions[(v + shift) % vertices];
+    }
+    w[vertices] = w[0];
+    std::vector<Wide> prefix(vertices + 1, 0);
+    for (size_t v = 0; v != vertices; ++v) {
+        prefix[v + 1] = prefix[v] + w[v] * w[v + 1];
+    }
+    // Ties are broken by position, vertex 0 is the strict minimum
+    auto lighter = [&](size_t a, size_t b) {
+        return w[a] < w[b] || (w[a] == w[b] && a < b);
+    };
+
+    // Potential h-arcs, arcs touching vertex 0 are left out: fanning from 0 covers them
+    std::vector<std::pair<size_t, size_t>> arcs;
+    std::vector<size_t> stack;
+    for (size_t v = 0; v != vertices; ++v) {
+        while (stack.size() >= 2 && lighter(v, stack.back())) {
+            stack.pop_back();
+            if (stack.back() != 0) {
+                arcs.emplace_back(stack.back(), v);
+            }
+        }
+        stack.push_back(v);
+    }
+    std::sort(arcs.begin(), arcs.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first < b.first : a.second > b.second;
+    });
+
+    // Arc tree in pre-order, node 0 is the whole polygon
+    struct Node {
+        size_t first;
+        size_t last;
+        size_t low;
+        size_t parent;
+    };
+    std::vector<Node> nodes{{0, vertices, 0, kChainLeaf}};
+    nodes.reserve(arcs.size() + 1);
+    std::vector<size_t> open{0};
+    for (auto [first, last] : arcs) {
+        while (nodes[open.back()].last < last) {
+            open.pop_back();
+        }
+        nodes.push_back({first, last, lighter(first, last) ? first : last, open.back()});
+        open.push_back(nodes.size() - 1);
+    }
+
+    // f_h is alpha + beta * t minus the heap's breakpoints (s, delta) above t: delta * (s - t).
+    // Entries store num = delta * s and den = delta, so everything stays integral.
+    ChainSupportHeap heap(nodes.size());
+    std::vector<size_t> heaps(nodes.size(), ChainSupportHeap::kEmpty);
+    std::vector<Wide> alpha(nodes.size(), 0), beta(nodes.size(), 0);
+    std::vector<bool> supported(nodes.size(), false);
+    std::vector<Wide> supportNum(nodes.size(), 0), supportDen(nodes.size(), 0);
+    // What f_h charges at t = w[low] for the element touching low, which is no triangle when h's
+    // own region is fanned from there: the arc if h is kept, else the same for a child arc
+    // sharing low, else the boundary edge at low
+    std::vector<Wide> incident(nodes.size(), -1);
+    auto absorbTop = [&](size_t h) {
+        alpha[h] -= heap[heaps[h]].num;
+        beta[h] += heap[heaps[h]].den;
+        heaps[h] = heap.Pop(heaps[h]);
+    };
+    for (size_t h = nodes.size(); h-- != 0;) {
+        const Node& node = nodes[h];
+        Wide low = w[node.low];
+        beta[h] += prefix[node.last] - prefix[node.first];
+        // Breakpoints past the lighter end are never evaluated
+        while (heaps[h] != ChainSupportHeap::kEmpty && heap[heaps[h]].num >= low * heap[heaps[h]].den) {
+            absorbTop(h);
+        }
+        if (h != 0) {
+            // Keeping h: its region fanned from its lighter end plus t times the arc
+            if (incident[h] < 0) {
+                incident[h] = node.low == node.first ? w[node.first] * w[node.first + 1]
+                                                     : w[node.last - 1] * w[node.last];
+            }
+            Wide keep = alpha[h] + beta[h] * low - low * incident[h];
+            Wide arc = w[node.first] * w[node.last];
+            while (heaps[h] != ChainSupportHeap::kEmpty &&
+                   alpha[h] * heap[heaps[h]].den + (beta[h] - arc) * heap[heaps[h]].num > keep * heap[heaps[h]].den) {
+                absorbTop(h);
+            }
+            if (beta[h] > arc) {
+                supported[h] = true;
+                supportNum[h] = keep - alpha[h];
+                supportDen[h] = beta[h] - arc;
+                heaps[h] = heap.Push(heaps[h], supportNum[h], supportDen[h]);
+                alpha[h] = keep;
+                beta[h] = arc;
+                incident[h] = arc;
+            }
+            size_t parent = node.parent;
+            if (node.low == nodes[parent].low) {
+                incident[parent] = incident[h];
+            }
+            alpha[parent] += alpha[h];
+            beta[parent] += beta[h] - (prefix[node.last] - prefix[node.first]);
+            heaps[parent] = heap.Merge(heaps[parent], heaps[h]);
+        }
+    }
+
+    // Top-down: h is kept when the weight fanning its region reaches s_h. Every vertex is joined
+    // to the lighter end of the innermost kept arc around it, or to vertex 0.
+    std::vector<size_t> region(nodes.size(), 0);
+    std::vector<size_t> owner(vertices + 1, 0);
+    std::vector<std::pair<size_t, size_t>> diagonals;
+    diagonals.reserve(vertices - 3);
+    for (size_t h = 1; h != nodes.size(); ++h) {
+        Wide t = w[region[nodes[h].parent]];
+        bool kept = supported[h] && supportNum[h] <= t * supportDen[h];
+        size_t context = region[nodes[h].parent];
+        region[h] = kept ? nodes[h].low : context;
+        // An arc touching the vertex that fans around it is one of that fan's diagonals
+        if (kept && nodes[h].first != context && nodes[h].last != context) {
+            diagonals.emplace_back(nodes[h].first, nodes[h].last);
+        }
+    }
+    // A node paints the vertices strictly inside it and outside its children; children are
+    // listed in pre-order, i.e. left to right
+    std::vector<size_t> children(nodes.size() + 1, 0);
+    for (size_t h = 1; h != nodes.size(); ++h) {
+        ++children[nodes[h].parent + 1];
+    }
+    std::partial_sum(children.begin(), children.end(), children.begin());
+    std::vector<size_t> childList(nodes.size()), filled(children.begin(), children.end() - 1);
+    for (size_t h = 1; h != nodes.size(); ++h) {
+        childList[filled[nodes[h].parent]++] = h;
+    }
+    for (size_t h = 0; h != nodes.size(); ++h) {
+        size_t v = nodes[h].first + 1;
+        for (size_t c = children[h]; c != children[h + 1]; ++c) {
+            for (; v <= nodes[childList[c]].first; ++v) {
+                owner[v] = region[h];
+            }
+            v = std::max(v, nodes[childList[c]].last);
+        }
+        for (; v < nodes[h].last; ++v) {
+            owner[v] = region[h];
+        }
+    }
+    for (size_t v = 1; v != vertices; ++v) {
+        size_t low = owner[v];
+        bool adjacent = v + 1 == low || v == low + 1 || (low == 0 && v == vertices - 1);
+        if (!adjacent) {
+            diagonals.emplace_back(low, v);
+        }
+    }
+
+    // Back to the original numbering; the apex over side (a, b) is a's largest neighbour below b
+    std::vector<std::vector<size_t>> neighbours(vertices);
+    for (size_t v = 0; v + 1 != vertices; ++v) {
+        neighbours[v].push_back(v + 1);
+    }
+    for (auto [a, b] : diagonals) {
+        a = (a + shift) % vertices;
+        b = (b + shift) % vertices;
+        neighbours[std::min(a, b)].push_back(std::max(a, b));
+    }
+    for (auto& list : neighbours) {
+        std::sort(list.begin(), list.end());
+    }
+    return BuildChainOrder(vertices - 1, [&](size_t first, size_t last) {
+        const std::vector<size_t>& list = neighbours[first];
+        return *(std::lower_bound(list.begin(), list.end(), last + 1) - 1) - 1;
+    }, ChainProductCost(dimensions));
+}
+
+// Products in execution order, as [first:split] * [split+1:last] -> +cost with 1-based indices
+inline std::ostream& operator<<(std::ostream& out, const ChainOrder& order) {
+    for (const ChainNode& node : order.nodes) {
+        out << "[" << node.first + 1 << ":" << node.split + 1 << "] * [" << node.split + 2 << ":"
+            << node.last + 1 << "] -> +" << node.cost << '\n';
+    }
+    return out;
+}
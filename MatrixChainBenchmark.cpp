@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "MatrixChainMultiply.h"
+
+// Usage: MatrixChainBenchmark [sizes...] [--dp=LIMIT] [--max-dimension=D] [--multiply=N]
+// Times MatrixChainOrder (Hu-Shing) on chains of random dimensions in [1, D] and, up to LIMIT
+// matrices, the reference DP, checking that both find the same cost. With --multiply also
+// multiplies a chain of N random matrices with MultiplyChain and left to right.
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    size_t dpLimit = 1000;
+    uint64_t maxDimension = 1000;
+    size_t multiplyCount = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--dp=", 0) == 0) {
+            dpLimit = std::stoul(arg.substr(5));
+        } else if (arg.rfind("--max-dimension=", 0) == 0) {
+            maxDimension = std::stoull(arg.substr(16));
+        } else if (arg.rfind("--multiply=", 0) == 0) {
+            multiplyCount = std::stoul(arg.substr(11));
+        } else {
+            sizes.push_back(std::stoul(arg));
+        }
+    }
+    if (sizes.empty()) {
+        sizes = {100, 300, 1000, 10000, 100000, 1000000};
+    }
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<uint64_t> dist(1, maxDimension);
+    std::cout << std::setw(9) << "n" << std::setw(14) << "hu-shing s" << std::setw(14) << "dp s"
+              << std::setw(22) << "cost" << '\n';
+    for (size_t n : sizes) {
+        std::vector<uint64_t> dimensions(n + 1);
+        for (uint64_t& dimension : dimensions) {
+            dimension = dist(rng);
+        }
+        ChainOrder order;
+        double huShingTime = Seconds([&] { order = MatrixChainOrder(dimensions); });
+        std::cout << std::setw(9) << n << std::fixed << std::setprecision(4) << std::setw(14) << huShingTime;
+        if (n <= dpLimit) {
+            ChainOrder reference;
+            double dpTime = Seconds([&] { reference = MatrixChainOrderDP(dimensions); });
+            std::cout << std::setw(14) << dpTime << std::setw(22) << order.cost
+                      << (order.cost == reference.cost ? "" : "   MISMATCH, dp " + std::to_string(reference.cost));
+        } else {
+            std::cout << std::setw(14) << "-" << std::setw(22) << order.cost;
+        }
+        std::cout << '\n';
+    }
+
+    if (multiplyCount == 0) {
+        return 0;
+    }
+    std::uniform_real_distribution<double> values(-1, 1);
+    std::vector<uint64_t> dimensions(multiplyCount + 1);
+    for (uint64_t& dimension : dimensions) {
+        dimension = dist(rng);
+    }
+    std::vector<Matrix<double>> matrices;
+    for (size_t i = 0; i != multiplyCount; ++i) {
+        matrices.emplace_back(dimensions[i], dimensions[i + 1]);
+        std::generate(matrices.back().Data(), matrices.back().Data() + dimensions[i] * dimensions[i + 1],
+                      [&] { return values(rng); });
+    }
+    Matrix<double> leftToRight = matrices[0];
+    double leftToRightTime = Seconds([&] {
+        for (size_t i = 1; i != multiplyCount; ++i) {
+            leftToRight = leftToRight * matrices[i];
+        }
+    });
+    ChainProduct<double> chain = MultiplyChain(matrices);
+    std::cout << "\nchain of " << multiplyCount << ": left to right " << leftToRightTime << " s, MultiplyChain "
+              << chain.seconds << " s (order " << chain.orderSeconds << " s), " << chain.buffers
+              << " buffers allocated, " << chain.reused << " reused, peak " << chain.peakElements
+              << " elements\n";
+    std::vector<size_t> slowest(chain.order.nodes.size());
+    std::iota(slowest.begin(), slowest.end(), 0);
+    std::sort(slowest.begin(), slowest.end(), [&](size_t a, size_t b) {
+        return chain.nodeSeconds[a] > chain.nodeSeconds[b];
+    });
+    slowest.resize(std::min<size_t>(slowest.size(), 5));
+    for (size_t i : slowest) {
+        const ChainNode& node = chain.order.nodes[i];
+        std::cout << "  [" << node.first + 1 << ":" << node.split + 1 << "] * [" << node.split + 2 << ":"
+                  << node.last + 1 << "] " << chain.nodeSeconds[i] << " s\n";
+    }
+}
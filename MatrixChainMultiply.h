@@ -0,0 +1,173 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "MatrixChain.h"
+
+// Multiplies a whole chain in an optimal order. Products whose operands are ready don't depend
+// on each other, so nodes are run by height in the order tree: all nodes of one height at once
+// on the pool, each of them parallel inside as well. Intermediate results are dropped as soon
+// as their parent is computed and their matrices go back to a free list; a new result takes
+// the smallest free matrix large enough for it, so the memory held is bounded by the results
+// alive at one time rather than by the number of products.
+
+template<typename ValueType>
+struct ChainProduct {
+    Matrix<ValueType> product;
+    ChainOrder order;
+    // Wall time of every product, indexed like order.nodes; products of one height overlap
+    std::vector<double> nodeSeconds;
+    double orderSeconds = 0;
+    double seconds = 0;
+    // Matrices allocated for intermediate results and the result, and how often one was reused
+    size_t buffers = 0;
+    size_t reused = 0;
+    // Most elements held by intermediate results and the result at one time
+    size_t peakElements = 0;
+};
+
+// Free matrices by capacity in elements
+template<typename ValueType>
+class ChainBufferPool {
+ public:
+    // A rows x columns matrix, its capacity goes to capacity
+    Matrix<ValueType> Acquire(size_t rows, size_t columns, size_t& capacity) {
+        size_t size = rows * columns;
+        live += size;
+        peak = std::max(peak, live);
+        auto it = free.lower_bound(size);
+        if (it == free.end()) {
+            ++allocated;
+            capacity = size;
+            return Matrix<ValueType>(rows, columns);
+        }
+        ++reused;
+        capacity = it->first;
+        Matrix<ValueType> ans = std::move(it->second);
+        free.erase(it);
+        ans.Resize(rows, columns);
+        return ans;
+    }
+
+    void Release(Matrix<ValueType>&& matrix, size_t capacity) {
+        live -= matrix.Rows() * matrix.Columns();
+        free.emplace(capacity, std::move(matrix));
+    }
+
+    size_t allocated = 0;
+    size_t reused = 0;
+    size_t peak = 0;
+
+ private:
+    std::multimap<size_t, Matrix<ValueType>> free;
+    size_t live = 0;
+};
+
+// Product of matrices in the given order, built for this chain
+template<typename ValueType, typename Allocator>
+ChainProduct<ValueType> MultiplyChain(const std::vector<Matrix<ValueType, Allocator>>& matrices, ChainOrder order) {
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    if (matrices.empty()) {
+        THROW(invalid_argument, "A chain needs at least one matrix")
+    }
+    if (order.nodes.size() != matrices.size() - 1) {
+        THROW(invalid_argument, "Order of " << order.nodes.size() + 1 << " matrices for a chain of "
+                                            << matrices.size())
+    }
+    size_t count = order.nodes.size();
+    ChainProduct<ValueType> ans{Matrix<ValueType>(0, 0), std::move(order), std::vector<double>(count)};
+    const std::vector<ChainNode>& nodes = ans.order.nodes;
+    if (nodes.empty()) {
+        ans.product = Matrix<ValueType>(matrices[0]);
+        ans.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return ans;
+    }
+    for (size_t i = 0; i + 1 != matrices.size(); ++i) {
+        if (matrices[i].Columns() != matrices[i + 1].Rows()) {
+            THROW(invalid_argument, "Matrix " << i + 2 << " has " << matrices[i + 1].Rows() << " rows, expected "
+                                              << matrices[i].Columns())
+        }
+    }
+
+    // Nodes by height, a node only depends on lower ones
+    std::vector<size_t> height(nodes.size());
+    size_t maxHeight = 0;
+    for (size_t i = 0; i != nodes.size(); ++i) {
+        size_t left = nodes[i].left == kChainLeaf ? 0 : height[nodes[i].left];
+        size_t right = nodes[i].right == kChainLeaf ? 0 : height[nodes[i].right];
+        height[i] = std::max(left, right) + 1;
+        maxHeight = std::max(maxHeight, height[i]);
+    }
+    std::vector<size_t> levelStart(maxHeight + 2, 0);
+    for (size_t h : height) {
+        ++levelStart[h + 1];
+    }
+    std::partial_sum(levelStart.begin(), levelStart.end(), levelStart.begin());
+    std::vector<size_t> levels(nodes.size());
+    std::vector<size_t> position(levelStart.begin(), levelStart.end() - 1);
+    for (size_t i = 0; i != nodes.size(); ++i) {
+        levels[position[height[i]]++] = i;
+    }
+
+    ChainBufferPool<ValueType> pool;
+    std::vector<Matrix<ValueType>> results(nodes.size(), Matrix<ValueType>(0, 0));
+    std::vector<size_t> capacities(nodes.size(), 0);
+    for (size_t h = 1; h <= maxHeight; ++h) {
+        size_t first = levelStart[h], last = levelStart[h + 1];
+        for (size_t i = first; i != last; ++i) {
+            const ChainNode& node = nodes[levels[i]];
+            size_t rows = matrices[node.first].Rows(), columns = matrices[node.last].Columns();
+            results[levels[i]] = pool.Acquire(rows, columns, capacities[levels[i]]);
+        }
+        ThreadPool::Instance().ParallelFor(first, last, 1, [&](size_t from, size_t to) {
+            for (size_t i = from; i != to; ++i) {
+                const ChainNode& node = nodes[levels[i]];
+                auto nodeStart = Clock::now();
+                if (node.left == kChainLeaf && node.right == kChainLeaf) {
+                    matrices[node.first].MultiplyInto(matrices[node.last], results[levels[i]]);
+                } else if (node.left == kChainLeaf) {
+                    matrices[node.first].MultiplyInto(results[node.right], results[levels[i]]);
+                } else if (node.right == kChainLeaf) {
+                    results[node.left].MultiplyInto(matrices[node.last], results[levels[i]]);
+                } else {
+                    results[node.left].MultiplyInto(results[node.right], results[levels[i]]);
+                }
+                ans.nodeSeconds[levels[i]] = std::chrono::duration<double>(Clock::now() - nodeStart).count();
+            }
+        });
+        for (size_t i = first; i != last; ++i) {
+            for (size_t child : {nodes[levels[i]].left, nodes[levels[i]].right}) {
+                if (child != kChainLeaf) {
+                    pool.Release(std::move(results[child]), capacities[child]);
+                }
+            }
+        }
+    }
+    ans.product = std::move(results.back());
+    ans.buffers = pool.allocated;
+    ans.reused = pool.reused;
+    ans.peakElements = pool.peak;
+    ans.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return ans;
+}
+
+// Product of matrices in the Hu-Shing order
+template<typename ValueType, typename Allocator>
+ChainProduct<ValueType> MultiplyChain(const std::vector<Matrix<ValueType, Allocator>>& matrices) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::pair<uint64_t, uint64_t>> shapes;
+    shapes.reserve(matrices.size());
+    for (const auto& matrix : matrices) {
+        shapes.emplace_back(matrix.Rows(), matrix.Columns());
+    }
+    ChainOrder order = MatrixChainOrder(ChainDimensions(shapes));
+    double orderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ChainProduct<ValueType> ans = MultiplyChain(matrices, std::move(order));
+    ans.orderSeconds = orderSeconds;
+    ans.seconds += orderSeconds;
+    return ans;
+}
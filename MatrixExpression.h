@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Lazy element-wise arithmetic on matrices. Operators build a tree of small nodes,
+// nothing is computed until the tree is assigned to a Matrix, which then fills every
+// element in one parallel pass. Nodes keep references to the matrices they read, so
+// a tree has to be evaluated before those matrices die (don't keep it in an `auto`).
+//
+// Every node provides value_type, Rows(), Columns(), At(i, j) and
+//   References(p) - some leaf of the tree is the matrix at p,
+//   Aliases(p)    - element (i, j) may depend on other elements of the matrix at p,
+//                   so it can't be evaluated into that matrix in place.
+
+template<typename ValueType, typename Allocator>
+class Matrix;
+
+template<typename Operand>
+class MatrixTransposedExpression;
+
+template<typename Derived>
+class MatrixExpression {
+ public:
+    const Derived& Self() const {
+        return static_cast<const Derived&>(*this);
+    }
+
+    MatrixTransposedExpression<Derived> Transponed() const;
+};
+
+// Matrices are held by reference, nodes by value
+template<typename Expression>
+struct ExpressionOperand {
+    using type = const Expression;
+};
+
+template<typename ValueType, typename Allocator>
+struct ExpressionOperand<Matrix<ValueType, Allocator>> {
+    using type = const Matrix<ValueType, Allocator>&;
+};
+
+template<typename Left, typename Right, typename Operation>
+class MatrixBinaryExpression : public MatrixExpression<MatrixBinaryExpression<Left, Right, Operation>> {
+ public:
+    using value_type = typename Left::value_type;
+
+    MatrixBinaryExpression(const Left& left, const Right& right) : left(left), right(right) {}
+
+    [[nodiscard]] size_t Rows() const {
+        return left.Rows();
+    }
+
+    [[nodiscard]] size_t Columns() const {
+        return left.Columns();
+    }
+
+    value_type At(size_t i, size_t j) const {
+        return Operation()(left.At(i, j), right.At(i, j));
+    }
+
+    bool References(const void* matrix) const {
+        return left.References(matrix) || right.References(matrix);
+    }
+
+    bool Aliases(const void* matrix) const {
+        return left.Aliases(matrix) || right.Aliases(matrix);
+    }
+
+ private:
+    typename ExpressionOperand<Left>::type left;
+    typename ExpressionOperand<Right>::type right;
+};
+
+// Applies Operation(element, value) to every element, used for scalar * and /
+template<typename Operand, typename Operation>
+class MatrixScalarExpression : public MatrixExpression<MatrixScalarExpression<Operand, Operation>> {
+ public:
+    using value_type = typename Operand::value_type;
+
+    MatrixScalarExpression(const Operand& operand, value_type value) : operand(operand), value(value) {}
+
+    [[nodiscard]] size_t Rows() const {
+        return operand.Rows();
+    }
+
+    [[nodiscard]] size_t Columns() const {
+        return operand.Columns();
+    }
+
+    value_type At(size_t i, size_t j) const {
+        return Operation()(operand.At(i, j), value);
+    }
+
+    bool References(const void* matrix) const {
+        return operand.References(matrix);
+    }
+
+    bool Aliases(const void* matrix) const {
+        return operand.Aliases(matrix);
+    }
+
+ private:
+    typename ExpressionOperand<Operand>::type operand;
+    value_type value;
+};
+
+template<typename Operand>
+class MatrixTransposedExpression : public MatrixExpression<MatrixTransposedExpression<Operand>> {
+ public:
+    using value_type = typename Operand::value_type;
+
+    explicit MatrixTransposedExpression(const Operand& operand) : operand(operand) {}
+
+    [[nodiscard]] size_t Rows() const {
+        return operand.Columns();
+    }
+
+    [[nodiscard]] size_t Columns() const {
+        return operand.Rows();
+    }
+
+    value_type At(size_t i, size_t j) const {
+        return operand.At(j, i);
+    }
+
+    bool References(const void* matrix) const {
+        return operand.References(matrix);
+    }
+
+    bool Aliases(const void* matrix) const {
+        return operand.References(matrix);
+    }
+
+    const Operand& Source() const {
+        return operand;
+    }
+
+ private:
+    typename ExpressionOperand<Operand>::type operand;
+};
+
+template<typename Derived>
+MatrixTransposedExpression<Derived> MatrixExpression<Derived>::Transponed() const {
+    return MatrixTransposedExpression<Derived>(Self());
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "Matrix.h"
+#include "Reduction.h"
+#include "ThreadPool.h"
+#include "Vector.h"
+
+// Whole-matrix reductions for convergence checks on large matrices: parallel, vectorized and,
+// for floating point, compensated, with results independent of the thread count (Reduction.h).
+// Matrix storage is contiguous (Stride() == Columns()), so element-wise reductions treat it as
+// one array of Rows() * Columns() elements.
+
+template<typename ValueType, typename Allocator>
+ValueType Sum(const Matrix<ValueType, Allocator>& matrix) {
+    return ReduceSum(matrix.Data(), matrix.Rows() * matrix.Columns());
+}
+
+template<typename ValueType, typename Allocator>
+std::pair<ValueType, ValueType> MinMax(const Matrix<ValueType, Allocator>& matrix) {
+    if (matrix.empty()) {
+        THROW(out_of_range, "Matrix is empty")
+    }
+    return ReduceMinMax(matrix.Data(), matrix.Rows() * matrix.Columns());
+}
+
+template<typename ValueType, typename Allocator>
+ValueType Min(const Matrix<ValueType, Allocator>& matrix) {
+    return MinMax(matrix).first;
+}
+
+template<typename ValueType, typename Allocator>
+ValueType Max(const Matrix<ValueType, Allocator>& matrix) {
+    return MinMax(matrix).second;
+}
+
+// max |a_ij|
+template<typename ValueType, typename Allocator>
+ValueType MaxNorm(const Matrix<ValueType, Allocator>& matrix) {
+    auto [low, high] = MinMax(matrix);
+    return std::max(AbsoluteTransform()(low), AbsoluteTransform()(high));
+}
+
+// sqrt of the sum of squares, no rescaling, so squares beyond the range of ValueType overflow
+template<typename ValueType, typename Allocator>
+ValueType FrobeniusNorm(const Matrix<ValueType, Allocator>& matrix) {
+    using std::sqrt;
+    return sqrt(ReduceSum<ValueType, SquareTransform>(matrix.Data(), matrix.Rows() * matrix.Columns()));
+}
+
+// Sums of transform(a_ij) along every row, wide rows are reduced in parallel themselves
+template<typename Transform, typename ValueType, typename Allocator>
+Vector<ValueType> TransformedRowSums(const Matrix<ValueType, Allocator>& matrix) {
+    Vector<ValueType> ans(matrix.Rows());
+    size_t columns = matrix.Columns();
+    if (columns > kReductionBlock) {
+        for (size_t i = 0; i != matrix.Rows(); ++i) {
+            ans[i] = ReduceSum<ValueType, Transform>(matrix[i].data(), columns);
+        }
+        return ans;
+    }
+    size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / std::max(columns, static_cast<size_t>(1)),
+                            static_cast<size_t>(1));
+    ThreadPool::Instance().ParallelFor(0, matrix.Rows(), grain, [&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            ans[i] = RunReduction<KahanSumKernel<ValueType, Transform>>(matrix[i].data(), columns).Value();
+        }
+    });
+    return ans;
+}
+
+template<typename ValueType, typename Allocator>
+Vector<ValueType> RowSums(const Matrix<ValueType, Allocator>& matrix) {
+    return TransformedRowSums<IdentityTransform>(matrix);
+}
+
+// Rows are read front to back and added into per-block column accumulators, never down a column
+template<typename ValueType, typename Allocator>
+Vector<ValueType> ColumnSums(const Matrix<ValueType, Allocator>& matrix) {
+    return Vector<ValueType>(ReduceColumns(matrix.Data(), matrix.Rows(), matrix.Columns(), matrix.Stride()));
+}
+
+// Largest column sum of |a_ij|
+template<typename ValueType, typename Allocator>
+ValueType L1Norm(const Matrix<ValueType, Allocator>& matrix) {
+    std::vector<ValueType> sums = ReduceColumns<ValueType, AbsoluteTransform>(
+        matrix.Data(), matrix.Rows(), matrix.Columns(), matrix.Stride());
+    return sums.empty() ? ValueType() : *std::max_element(sums.begin(), sums.end());
+}
+
+// Largest row sum of |a_ij|
+template<typename ValueType, typename Allocator>
+ValueType InfNorm(const Matrix<ValueType, Allocator>& matrix) {
+    Vector<ValueType> sums = TransformedRowSums<AbsoluteTransform>(matrix);
+    return sums.empty() ? ValueType() : *std::max_element(sums.begin(), sums.end());
+}
+
+// Same size and |a_ij - b_ij| <= absolute + relative * |b_ij| everywhere. Stops at the first
+// block with a violation instead of reading both matrices to the end.
+template<typename ValueType, typename FirstAllocator, typename SecondAllocator>
+bool ApproxEqual(const Matrix<ValueType, FirstAllocator>& first, const Matrix<ValueType, SecondAllocator>& second,
+                 ValueType absolute, ValueType relative = ValueType()) {
+    if (first.size() != second.size()) {
+        return false;
+    }
+    return ReduceApproxEqual(first.Data(), second.Data(), first.Rows() * first.Columns(), absolute, relative);
+}
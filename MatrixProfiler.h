@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "MatrixStorage.h"
+
+// Opt-in per-operation counters for Matrix. Build with -DMATRIX_PROFILING to turn them on;
+// otherwise MATRIX_PROFILE expands to nothing and the pool hooks are compiled out, so the
+// default build pays nothing. Every instrumented operation records calls, wall time, FLOPs,
+// bytes touched, allocations, and the ParallelFor regions it ran: how many chunks they were
+// split into, how many threads took part and how long the chunks ran.
+//
+// Times and allocations are inclusive: Pow counts the multiplications it makes, and they are
+// also recorded as "multiply". Allocation counters are process-wide, so operations running
+// concurrently on other threads leak into each other's numbers. Pool regions go to the
+// innermost operation of the thread that called ParallelFor.
+
+// One operation summed over all its calls
+struct OperationProfile {
+    std::string name;
+    uint64_t calls = 0;
+    double seconds = 0;
+    uint64_t flops = 0;
+    uint64_t bytes = 0;
+    uint64_t allocations = 0;
+    uint64_t arenaAllocations = 0;
+    uint64_t parallelRegions = 0;
+    uint64_t chunks = 0;
+    // Most threads that ran chunks of a single region
+    uint64_t maxThreads = 0;
+    // Wall time inside ParallelFor and time summed over the chunks it ran; with maxThreads this
+    // shows how much of a region went to scheduling and waiting
+    double parallelSeconds = 0;
+    double chunkSeconds = 0;
+
+    [[nodiscard]] double GFlops() const {
+        return seconds > 0 ? flops / seconds * 1e-9 : 0;
+    }
+
+    [[nodiscard]] double Bandwidth() const {
+        return seconds > 0 ? bytes / seconds : 0;
+    }
+};
+
+// Shared by every call site recording under one name
+struct OperationCounters {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> nanoseconds{0};
+    std::atomic<uint64_t> flops{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> arenaAllocations{0};
+    std::atomic<uint64_t> parallelRegions{0};
+    std::atomic<uint64_t> chunks{0};
+    std::atomic<uint64_t> maxThreads{0};
+    std::atomic<uint64_t> parallelNanoseconds{0};
+    std::atomic<uint64_t> chunkNanoseconds{0};
+
+    void Reset() {
+        for (auto* counter : {&calls, &nanoseconds, &flops, &bytes, &allocations, &arenaAllocations,
+                              &parallelRegions, &chunks, &maxThreads, &parallelNanoseconds, &chunkNanoseconds}) {
+            counter->store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void AddRegion(uint64_t regionChunks, uint64_t threads, uint64_t wallNanoseconds, uint64_t busyNanoseconds) {
+        parallelRegions.fetch_add(1, std::memory_order_relaxed);
+        chunks.fetch_add(regionChunks, std::memory_order_relaxed);
+        parallelNanoseconds.fetch_add(wallNanoseconds, std::memory_order_relaxed);
+        chunkNanoseconds.fetch_add(busyNanoseconds, std::memory_order_relaxed);
+        uint64_t seen = maxThreads.load(std::memory_order_relaxed);
+        while (threads > seen && !maxThreads.compare_exchange_weak(seen, threads, std::memory_order_relaxed)) {}
+    }
+};
+
+class MatrixProfiler {
+ public:
+    static MatrixProfiler& Instance() {
+        static MatrixProfiler profiler;
+        return profiler;
+    }
+
+    static constexpr bool Enabled() {
+#ifdef MATRIX_PROFILING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    MatrixProfiler(const MatrixProfiler&) = delete;
+
+    MatrixProfiler& operator=(const MatrixProfiler&) = delete;
+
+    // Counters for name, created on first use. The reference stays valid for the whole run,
+    // call sites look it up once.
+    OperationCounters& Counters(const std::string& name) {
+        std::lock_guard lock(mutex);
+        return operations[name];
+    }
+
+    // Operations called at least once since the last Reset, by name
+    [[nodiscard]] std::vector<OperationProfile> Snapshot() const;
+
+    void Reset();
+
+    void WriteJson(std::ostream& out) const;
+
+ private:
+    MatrixProfiler() = default;
+
+    mutable std::mutex mutex;
+    std::map<std::string, OperationCounters> operations;
+};
+
+inline std::vector<OperationProfile> MatrixProfiler::Snapshot() const {
+    std::lock_guard lock(mutex);
+    std::vector<OperationProfile> ans;
+    for (const auto& [name, counters] : operations) {
+        OperationProfile profile;
+        profile.calls = counters.calls.load(std::memory_order_relaxed);
+        if (profile.calls == 0) {
+            continue;
+        }
+        profile.name = name;
+        profile.seconds = counters.nanoseconds.load(std::memory_order_relaxed) * 1e-9;
+        profile.flops = counters.flops.load(std::memory_order_relaxed);
+        profile.bytes = counters.bytes.load(std::memory_order_relaxed);
+        profile.allocations = counters.allocations.load(std::memory_order_relaxed);
+        profile.arenaAllocations = counters.arenaAllocations.load(std::memory_order_relaxed);
+        profile.parallelRegions = counters.parallelRegions.load(std::memory_order_relaxed);
+        profile.chunks = counters.chunks.load(std::memory_order_relaxed);
+        profile.maxThreads = counters.maxThreads.load(std::memory_order_relaxed);
+        profile.parallelSeconds = counters.parallelNanoseconds.load(std::memory_order_relaxed) * 1e-9;
+        profile.chunkSeconds = counters.chunkNanoseconds.load(std::memory_order_relaxed) * 1e-9;
+        ans.push_back(profile);
+    }
+    return ans;
+}
+
+inline void MatrixProfiler::Reset() {
+    std::lock_guard lock(mutex);
+    for (auto& [name, counters] : operations) {
+        counters.Reset();
+    }
+}
+
+// {"operations": [{"name": ..., "calls": ..., ...}, ...]}, names are identifiers, no escaping needed
+inline void MatrixProfiler::WriteJson(std::ostream& out) const {
+    std::vector<OperationProfile> profiles = Snapshot();
+    out << "{\"enabled\": " << (Enabled() ? "true" : "false") << ", \"operations\": [";
+    for (size_t i = 0; i != profiles.size(); ++i) {
+        const OperationProfile& profile = profiles[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "  {\"name\": \"" << profile.name << "\", \"calls\": " << profile.calls
+            << ", \"seconds\": " << profile.seconds << ", \"flops\": " << profile.flops
+            << ", \"bytes\": " << profile.bytes << ", \"gflops\": " << profile.GFlops()
+            << ", \"bandwidth\": " << profile.Bandwidth() << ", \"allocations\": " << profile.allocations
+            << ", \"arena_allocations\": " << profile.arenaAllocations
+            << ", \"parallel_regions\": " << profile.parallelRegions << ", \"chunks\": " << profile.chunks
+            << ", \"max_threads\": " << profile.maxThreads << ", \"parallel_seconds\": " << profile.parallelSeconds
+            << ", \"chunk_seconds\": " << profile.chunkSeconds << "}";
+    }
+    out << (profiles.empty() ? "]}\n" : "\n]}\n");
+}
+
+// Times one call of an operation and adds it to its counters when destroyed. The innermost
+// scope of each thread collects the pool regions started from that thread.
+class ProfileScope {
+ public:
+    using Clock = std::chrono::steady_clock;
+
+    ProfileScope(OperationCounters& counters, uint64_t flops, uint64_t bytes) :
+        counters(counters), parent(Current()), start(Clock::now()),
+        allocations(AllocationTracker::Instance().Allocations()),
+        arenaAllocations(AllocationTracker::Instance().ArenaAllocations()) {
+        counters.flops.fetch_add(flops, std::memory_order_relaxed);
+        counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        Current() = this;
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    ~ProfileScope() {
+        AllocationTracker& tracker = AllocationTracker::Instance();
+        counters.calls.fetch_add(1, std::memory_order_relaxed);
+        counters.nanoseconds.fetch_add(Nanoseconds(start), std::memory_order_relaxed);
+        counters.allocations.fetch_add(tracker.Allocations() - allocations, std::memory_order_relaxed);
+        counters.arenaAllocations.fetch_add(tracker.ArenaAllocations() - arenaAllocations,
+                                            std::memory_order_relaxed);
+        Current() = parent;
+    }
+
+    static ProfileScope*& Current() {
+        thread_local ProfileScope* current = nullptr;
+        return current;
+    }
+
+    static uint64_t Nanoseconds(Clock::time_point from) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - from).count();
+    }
+
+    OperationCounters& Counters() const {
+        return counters;
+    }
+
+ private:
+    OperationCounters& counters;
+    ProfileScope* parent;
+    Clock::time_point start;
+    size_t allocations;
+    size_t arenaAllocations;
+};
+
+// Records the rest of the enclosing block as one call of the operation `name`
+#ifdef MATRIX_PROFILING
+#define MATRIX_PROFILE(name, flops, bytes)                                                         \
+    static OperationCounters& matrixProfileCounters = MatrixProfiler::Instance().Counters(name); \
+    ProfileScope matrixProfileScope(matrixProfileCounters, (flops), (bytes));
+#else
+#define MATRIX_PROFILE(name, flops, bytes)
+#endif
@@ -0,0 +1,460 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Matrix.h"
+#include "MatrixStorage.h"
+
+// Binary matrix files: a 64-byte header followed by the rows * columns elements exactly as
+// Matrix stores them, so saving is one writev and loading can map the file and use the payload
+// in place. The payload starts at header.alignment, which keeps it as aligned as Matrix storage.
+// POSIX only.
+
+constexpr char kMatrixFileMagic[8] = {'M', 'T', 'X', 'B', 'I', 'N', '\0', '\0'};
+constexpr uint16_t kMatrixFileVersion = 1;
+constexpr uint32_t kMatrixFileAlignment = 64;
+
+enum class MatrixElementType : uint8_t { Other, Float, Double, Int32, Int64, UInt32, UInt64 };
+
+enum class MatrixEndianness : uint8_t { Little = 1, Big = 2 };
+
+struct MatrixFileHeader {
+    char magic[8];
+    uint16_t version;
+    MatrixElementType elementType;
+    uint8_t elementSize;
+    MatrixEndianness endianness;
+    uint8_t reserved[3];
+    uint32_t alignment;
+    uint64_t rows;
+    uint64_t columns;
+    uint64_t payloadOffset;
+    uint8_t padding[16];
+};
+
+static_assert(sizeof(MatrixFileHeader) == kMatrixFileAlignment);
+
+template<typename ValueType>
+constexpr MatrixElementType ElementTypeOf() {
+    if constexpr (std::is_same_v<ValueType, float>) {
+        return MatrixElementType::Float;
+    } else if constexpr (std::is_same_v<ValueType, double>) {
+        return MatrixElementType::Double;
+    } else if constexpr (std::is_same_v<ValueType, int32_t>) {
+        return MatrixElementType::Int32;
+    } else if constexpr (std::is_same_v<ValueType, int64_t>) {
+        return MatrixElementType::Int64;
+    } else if constexpr (std::is_same_v<ValueType, uint32_t>) {
+        return MatrixElementType::UInt32;
+    } else if constexpr (std::is_same_v<ValueType, uint64_t>) {
+        return MatrixElementType::UInt64;
+    } else {
+        return MatrixElementType::Other;
+    }
+}
+
+constexpr MatrixEndianness NativeEndianness() {
+    return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? MatrixEndianness::Little : MatrixEndianness::Big;
+}
+
+template<typename ValueType>
+MatrixFileHeader MakeMatrixFileHeader(size_t rows, size_t columns) {
+    static_assert(std::is_trivially_copyable_v<ValueType>, "Only trivially copyable elements can be saved");
+    MatrixFileHeader header{};
+    std::memcpy(header.magic, kMatrixFileMagic, sizeof(header.magic));
+    header.version = kMatrixFileVersion;
+    header.elementType = ElementTypeOf<ValueType>();
+    header.elementSize = sizeof(ValueType);
+    header.endianness = NativeEndianness();
+    header.alignment = kMatrixFileAlignment;
+    header.rows = rows;
+    header.columns = columns;
+    header.payloadOffset = sizeof(MatrixFileHeader);
+    return header;
+}
+
+// Throws unless the header describes a matrix of ValueType that fits into fileSize bytes
+template<typename ValueType>
+void CheckMatrixFileHeader(const MatrixFileHeader& header, size_t fileSize, const std::string& path) {
+    if (std::memcmp(header.magic, kMatrixFileMagic, sizeof(header.magic)) != 0) {
+        THROW(runtime_error, path << " isn't a matrix file")
+    }
+    if (header.version != kMatrixFileVersion) {
+        THROW(runtime_error, path << " has unsupported version " << header.version)
+    }
+    if (header.elementType != ElementTypeOf<ValueType>() || header.elementSize != sizeof(ValueType)) {
+        THROW(runtime_error, path << " holds another element type")
+    }
+    // The header is untrusted: no division by a zero alignment, no size product that wraps
+    if (header.alignment < kMatrixFileAlignment || (header.alignment & (header.alignment - 1)) != 0 ||
+        header.payloadOffset < sizeof(MatrixFileHeader) || header.payloadOffset % header.alignment != 0) {
+        THROW(runtime_error, path << " has a corrupt header")
+    }
+    if (header.payloadOffset > fileSize ||
+        (header.rows != 0 && header.columns > (fileSize - header.payloadOffset) / sizeof(ValueType) / header.rows)) {
+        THROW(runtime_error, path << " is truncated")
+    }
+}
+
+inline int CreateMatrixFile(const std::string& path) {
+    int descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0) {
+        THROW(runtime_error, "Can't create " << path)
+    }
+    return descriptor;
+}
+
+// writev until everything is written, the kernel may stop early on large payloads
+inline void WriteMatrixFile(int descriptor, iovec* parts, int count, const std::string& path) {
+    while (count != 0) {
+        ssize_t written = ::writev(descriptor, parts, count);
+        if (written < 0) {
+            ::close(descriptor);
+            THROW(runtime_error, "Can't write " << path)
+        }
+        auto left = static_cast<size_t>(written);
+        while (count != 0 && left >= parts->iov_len) {
+            left -= parts->iov_len;
+            ++parts;
+            --count;
+        }
+        if (count != 0) {
+            parts->iov_base = static_cast<char*>(parts->iov_base) + left;
+            parts->iov_len -= left;
+        }
+    }
+}
+
+template<typename ValueType>
+ValueType ByteSwapped(ValueType value) {
+    auto* bytes = reinterpret_cast<unsigned char*>(&value);
+    std::reverse(bytes, bytes + sizeof(ValueType));
+    return value;
+}
+
+template<typename ValueType>
+void SaveMatrix(const Matrix<ValueType>& matrix, const std::string& path) {
+    MatrixFileHeader header = MakeMatrixFileHeader<ValueType>(matrix.Rows(), matrix.Columns());
+    int descriptor = CreateMatrixFile(path);
+    iovec parts[2] = {
+        {&header, sizeof(header)},
+        {const_cast<ValueType*>(matrix.Data()), matrix.Rows() * matrix.Columns() * sizeof(ValueType)}
+    };
+    WriteMatrixFile(descriptor, parts, 2, path);
+    ::close(descriptor);
+}
+
+// Reads a copy; files written on a machine of the other byte order are converted
+template<typename ValueType>
+Matrix<ValueType> LoadMatrix(const std::string& path) {
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        THROW(runtime_error, "Can't open " << path)
+    }
+    struct stat status{};
+    MatrixFileHeader header{};
+    if (::fstat(descriptor, &status) != 0 ||
+        ::pread(descriptor, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+        ::close(descriptor);
+        THROW(runtime_error, "Can't read header of " << path)
+    }
+    if (header.endianness != NativeEndianness()) {
+        header.version = ByteSwapped(header.version);
+        header.alignment = ByteSwapped(header.alignment);
+        header.rows = ByteSwapped(header.rows);
+        header.columns = ByteSwapped(header.columns);
+        header.payloadOffset = ByteSwapped(header.payloadOffset);
+    }
+    try {
+        CheckMatrixFileHeader<ValueType>(header, static_cast<size_t>(status.st_size), path);
+    } catch (...) {
+        ::close(descriptor);
+        throw;
+    }
+    Matrix<ValueType> ans(header.rows, header.columns);
+    auto* target = reinterpret_cast<char*>(ans.Data());
+    size_t left = header.rows * header.columns * sizeof(ValueType), offset = header.payloadOffset;
+    while (left != 0) {
+        ssize_t read = ::pread(descriptor, target, left, static_cast<off_t>(offset));
+        if (read <= 0) {
+            ::close(descriptor);
+            THROW(runtime_error, "Can't read " << path)
+        }
+        target += read;
+        offset += static_cast<size_t>(read);
+        left -= static_cast<size_t>(read);
+    }
+    ::close(descriptor);
+    if (header.endianness != NativeEndianness()) {
+        std::transform(ans.Data(), ans.Data() + header.rows * header.columns, ans.Data(),
+                       ByteSwapped<ValueType>);
+    }
+    return ans;
+}
+
+// Read-only matrix over a mapped file, nothing is parsed or copied. Rows and blocks are the
+// same MatrixRow / MatrixBlock views a Matrix hands out, so Gemm and friends take it directly.
+template<typename ValueType = double>
+class MatrixFileView {
+ public:
+    using value_type = ValueType;
+    using const_iterator = MatrixRowIterator<const ValueType>;
+
+    explicit MatrixFileView(const std::string& path);
+
+    MatrixFileView(const MatrixFileView&) = delete;
+
+    MatrixFileView& operator=(const MatrixFileView&) = delete;
+
+    MatrixFileView(MatrixFileView&& other) noexcept;
+
+    MatrixFileView& operator=(MatrixFileView&& other) noexcept;
+
+    ~MatrixFileView();
+
+    [[nodiscard]] size_t Rows() const;
+
+    [[nodiscard]] size_t Columns() const;
+
+    [[nodiscard]] size_t Stride() const;
+
+    const ValueType* Data() const;
+
+    MatrixBlock<const ValueType> Block(size_t row, size_t column, size_t blockRows, size_t blockColumns) const;
+
+    operator MatrixBlock<const ValueType>() const;
+
+    const_iterator begin() const;
+
+    const_iterator end() const;
+
+    MatrixRow<const ValueType> operator[](size_t idx) const;
+
+    const ValueType& At(size_t i, size_t j) const;
+
+    Matrix<ValueType> ToMatrix() const;
+ private:
+    void* mapping = nullptr;
+    size_t bytes = 0;
+    const ValueType* first = nullptr;
+    size_t rows = 0;
+    size_t columns = 0;
+};
+
+template<typename ValueType>
+MatrixFileView<ValueType>::MatrixFileView(const std::string& path) {
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        THROW(runtime_error, "Can't open " << path)
+    }
+    struct stat status{};
+    if (::fstat(descriptor, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(MatrixFileHeader)) {
+        ::close(descriptor);
+        THROW(runtime_error, "Can't read header of " << path)
+    }
+    bytes = static_cast<size_t>(status.st_size);
+    mapping = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, descriptor, 0);
+    ::close(descriptor);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        THROW(runtime_error, "Can't map " << path)
+    }
+    const auto& header = *static_cast<const MatrixFileHeader*>(mapping);
+    try {
+        CheckMatrixFileHeader<ValueType>(header, bytes, path);
+        if (header.endianness != NativeEndianness()) {
+            THROW(runtime_error, path << " has foreign byte order, use LoadMatrix")
+        }
+    } catch (...) {
+        ::munmap(mapping, bytes);
+        throw;
+    }
+    first = reinterpret_cast<const ValueType*>(static_cast<const char*>(mapping) + header.payloadOffset);
+    rows = header.rows;
+    columns = header.columns;
+}
+
+template<typename ValueType>
+MatrixFileView<ValueType>::MatrixFileView(MatrixFileView&& other) noexcept :
+    mapping(std::exchange(other.mapping, nullptr)), bytes(other.bytes), first(other.first), rows(other.rows),
+    columns(other.columns) {}
+
+template<typename ValueType>
+MatrixFileView<ValueType>& MatrixFileView<ValueType>::operator=(MatrixFileView&& other) noexcept {
+    std::swap(mapping, other.mapping);
+    std::swap(bytes, other.bytes);
+    std::swap(first, other.first);
+    std::swap(rows, other.rows);
+    std::swap(columns, other.columns);
+    return *this;
+}
+
+template<typename ValueType>
+MatrixFileView<ValueType>::~MatrixFileView() {
+    if (mapping != nullptr) {
+        ::munmap(mapping, bytes);
+    }
+}
+
+template<typename ValueType>
+size_t MatrixFileView<ValueType>::Rows() const {
+    return rows;
+}
+
+template<typename ValueType>
+size_t MatrixFileView<ValueType>::Columns() const {
+    return columns;
+}
+
+template<typename ValueType>
+size_t MatrixFileView<ValueType>::Stride() const {
+    return columns;
+}
+
+template<typename ValueType>
+const ValueType* MatrixFileView<ValueType>::Data() const {
+    return first;
+}
+
+template<typename ValueType>
+MatrixBlock<const ValueType> MatrixFileView<ValueType>::Block(size_t row, size_t column,
+                                                              size_t blockRows, size_t blockColumns) const {
+    if (row + blockRows > Rows() || column + blockColumns > Columns()) {
+        THROW(out_of_range, "Block is out of matrix")
+    }
+    return {Data() + row * Stride() + column, blockRows, blockColumns, Stride()};
+}
+
+template<typename ValueType>
+MatrixFileView<ValueType>::operator MatrixBlock<const ValueType>() const {
+    return {Data(), Rows(), Columns(), Stride()};
+}
+
+template<typename ValueType>
+typename MatrixFileView<ValueType>::const_iterator MatrixFileView<ValueType>::begin() const {
+    return {Data(), Columns(), Stride()};
+}
+
+template<typename ValueType>
+typename MatrixFileView<ValueType>::const_iterator MatrixFileView<ValueType>::end() const {
+    return {Data() + Rows() * Stride(), Columns(), Stride()};
+}
+
+template<typename ValueType>
+MatrixRow<const ValueType> MatrixFileView<ValueType>::operator[](size_t idx) const {
+    return {Data() + idx * Stride(), Columns()};
+}
+
+template<typename ValueType>
+const ValueType& MatrixFileView<ValueType>::At(size_t i, size_t j) const {
+    return first[i * Stride() + j];
+}
+
+template<typename ValueType>
+Matrix<ValueType> MatrixFileView<ValueType>::ToMatrix() const {
+    Matrix<ValueType> ans(Rows(), Columns());
+    std::copy(Data(), Data() + Rows() * Columns(), ans.Data());
+    return ans;
+}
+
+template<typename ValueType>
+MatrixFileView<ValueType> MapMatrix(const std::string& path) {
+    return MatrixFileView<ValueType>(path);
+}
+
+template<typename ValueType>
+const char* ParseMatrixElement(const char* first, const char* last, ValueType& value) {
+    if constexpr (std::is_arithmetic_v<ValueType>) {
+        auto [end, error] = std::from_chars(first, last, value);
+        return error == std::errc() ? end : nullptr;
+    } else {
+        std::istringstream in(std::string(first, last));
+        if (!(in >> value)) {
+            return nullptr;
+        }
+        auto consumed = in.eof() ? static_cast<std::streamoff>(last - first) : static_cast<std::streamoff>(in.tellg());
+        return first + consumed;
+    }
+}
+
+// Converts a text dump in the operator<< layout (one row per line, elements separated by
+// whitespace, blank lines ignored) into a binary file without holding the matrix in memory:
+// elements are parsed line by line into a fixed buffer that is flushed whenever it fills up,
+// and the header is rewritten with the row count at the end. Returns {rows, columns}.
+template<typename ValueType>
+std::pair<size_t, size_t> ConvertTextMatrix(std::istream& in, const std::string& path) {
+    constexpr size_t kBufferElements = (static_cast<size_t>(1) << 20) / sizeof(ValueType);
+    int descriptor = CreateMatrixFile(path);
+    MatrixFileHeader header = MakeMatrixFileHeader<ValueType>(0, 0);
+    std::vector<ValueType, AlignedAllocator<ValueType>> buffer;
+    buffer.reserve(kBufferElements);
+    iovec parts[1] = {{&header, sizeof(header)}};
+    WriteMatrixFile(descriptor, parts, 1, path);
+
+    auto flush = [&] {
+        iovec payload[1] = {{buffer.data(), buffer.size() * sizeof(ValueType)}};
+        WriteMatrixFile(descriptor, payload, 1, path);
+        buffer.clear();
+    };
+    size_t rows = 0, columns = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        const char* first = line.data();
+        const char* last = first + line.size();
+        size_t count = 0;
+        while (true) {
+            while (first != last && std::isspace(static_cast<unsigned char>(*first))) {
+                ++first;
+            }
+            if (first == last) {
+                break;
+            }
+            ValueType value;
+            first = ParseMatrixElement(first, last, value);
+            if (first == nullptr) {
+                ::close(descriptor);
+                THROW(runtime_error, "Bad element in row " << rows + 1)
+            }
+            buffer.push_back(value);
+            ++count;
+            if (buffer.size() == kBufferElements) {
+                flush();
+            }
+        }
+        if (count == 0) {
+            continue;
+        }
+        if (rows == 0) {
+            columns = count;
+        } else if (count != columns) {
+            ::close(descriptor);
+            THROW(runtime_error, "Row " << rows + 1 << " has " << count << " elements instead of " << columns)
+        }
+        ++rows;
+    }
+    flush();
+    header.rows = rows;
+    header.columns = columns;
+    if (::pwrite(descriptor, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+        ::close(descriptor);
+        THROW(runtime_error, "Can't write " << path)
+    }
+    ::close(descriptor);
+    return {rows, columns};
+}
@@ -0,0 +1,552 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MATRIX_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// Hand-written float/double kernels, chosen at runtime from what the CPU reports,
+// so a binary built for plain x86-64 still uses AVX2/FMA or AVX-512 where available.
+
+// Rows of a matrix one dotRows kernel call handles, GEMV walks the matrix in such strips
+constexpr size_t kDotRows = 4;
+
+enum class SimdLevel {
+    Scalar = 0,
+    Avx2,
+    Avx512
+};
+
+inline SimdLevel DetectSimdLevel() {
+#ifdef MATRIX_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SimdLevel::Avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SimdLevel::Avx2;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+inline SimdLevel& SimdLevelSetting() {
+    static SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+inline SimdLevel CurrentSimdLevel() {
+    return SimdLevelSetting();
+}
+
+// Lowers the kernels used (benchmarks, tests). Levels above DetectSimdLevel() are clamped to it,
+// the level actually set is returned.
+inline SimdLevel SetSimdLevel(SimdLevel requested) {
+    SimdLevelSetting() = std::min(requested, DetectSimdLevel());
+    return SimdLevelSetting();
+}
+
+// Kernels available for ValueType at the current level, null entries mean "use the generic loop".
+// gemm computes mr x nr tile c += a * b over packed slivers, same contract as GemmKernel in Gemm.h,
+// transpose writes the transposed tile x tile block of src into dst, dotRows writes the dot
+// products of kDotRows rows of a (lda apart) with x into out, axpy computes y += alpha * x and
+// axpyRows adds kDotRows rows of a scaled by alpha[0..kDotRows) to y in one pass over y
+template<typename ValueType>
+struct SimdKernels {
+    using Binary = void (*)(ValueType* dst, const ValueType* src, size_t count);
+    using WithScalar = void (*)(ValueType* dst, ValueType value, size_t count);
+    using Gemm = void (*)(size_t kc, const ValueType* a, const ValueType* b, ValueType* c, size_t ldc);
+    using Transpose = void (*)(const ValueType* src, size_t lds, ValueType* dst, size_t ldd);
+    using Dot = ValueType (*)(const ValueType* x, const ValueType* y, size_t count);
+    using DotRows = void (*)(const ValueType* a, size_t lda, const ValueType* x, size_t count, ValueType* out);
+    using Axpy = void (*)(ValueType* y, ValueType alpha, const ValueType* x, size_t count);
+    using AxpyRows = void (*)(ValueType* y, const ValueType* alpha, const ValueType* a, size_t lda, size_t count);
+
+    Binary add = nullptr;
+    Binary subtract = nullptr;
+    WithScalar multiply = nullptr;
+    WithScalar divide = nullptr;
+    size_t mr = 0;
+    size_t nr = 0;
+    Gemm gemm = nullptr;
+    size_t tile = 0;
+    Transpose transpose = nullptr;
+    Dot dot = nullptr;
+    DotRows dotRows = nullptr;
+    Axpy axpy = nullptr;
+    AxpyRows axpyRows = nullptr;
+
+    static const SimdKernels& Get() {
+        static const SimdKernels none;
+        return none;
+    }
+};
+
+#ifdef MATRIX_SIMD_X86
+
+#define SIMD_BINARY_KERNEL(NAME, TARGET, TYPE, WIDTH, LOAD, STORE, OP, SCALAR_OP)   \
+__attribute__((target(TARGET)))                                                   \
+inline void NAME(TYPE* dst, const TYPE* src, size_t count) {                      \
+    size_t i = 0;                                                                 \
+    for (; i + WIDTH <= count; i += WIDTH) {                                      \
+        STORE(dst + i, OP(LOAD(dst + i), LOAD(src + i)));                         \
+    }                                                                             \
+    for (; i != count; ++i) {                                                     \
+        dst[i] SCALAR_OP src[i];                                                  \
+    }                                                                             \
+}
+
+#define SIMD_SCALAR_KERNEL(NAME, TARGET, TYPE, WIDTH, LOAD, STORE, SET1, OP, SCALAR_OP) \
+__attribute__((target(TARGET)))                                                       \
+inline void NAME(TYPE* dst, TYPE value, size_t count) {                               \
+    auto broadcast = SET1(value);                                                     \
+    size_t i = 0;                                                                     \
+    for (; i + WIDTH <= count; i += WIDTH) {                                          \
+        STORE(dst + i, OP(LOAD(dst + i), broadcast));                                 \
+    }                                                                                 \
+    for (; i != count; ++i) {                                                         \
+        dst[i] SCALAR_OP value;                                                       \
+    }                                                                                 \
+}
+
+SIMD_BINARY_KERNEL(SimdAddAvx2, "avx2", double, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, +=)
+SIMD_BINARY_KERNEL(SimdSubtractAvx2, "avx2", double, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sub_pd, -=)
+SIMD_SCALAR_KERNEL(SimdMultiplyAvx2, "avx2", double, 4, _mm256_loadu_pd, _mm256_storeu_pd,
+                   _mm256_set1_pd, _mm256_mul_pd, *=)
+SIMD_SCALAR_KERNEL(SimdDivideAvx2, "avx2", double, 4, _mm256_loadu_pd, _mm256_storeu_pd,
+                   _mm256_set1_pd, _mm256_div_pd, /=)
+SIMD_BINARY_KERNEL(SimdAddAvx2, "avx2", float, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps, +=)
+SIMD_BINARY_KERNEL(SimdSubtractAvx2, "avx2", float, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_sub_ps, -=)
+SIMD_SCALAR_KERNEL(SimdMultiplyAvx2, "avx2", float, 8, _mm256_loadu_ps, _mm256_storeu_ps,
+                   _mm256_set1_ps, _mm256_mul_ps, *=)
+SIMD_SCALAR_KERNEL(SimdDivideAvx2, "avx2", float, 8, _mm256_loadu_ps, _mm256_storeu_ps,
+                   _mm256_set1_ps, _mm256_div_ps, /=)
+
+SIMD_BINARY_KERNEL(SimdAddAvx512, "avx512f", double, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, +=)
+SIMD_BINARY_KERNEL(SimdSubtractAvx512, "avx512f", double, 8, _mm512_loadu_pd, _mm512_storeu_pd,
+                   _mm512_sub_pd, -=)
+SIMD_SCALAR_KERNEL(SimdMultiplyAvx512, "avx512f", double, 8, _mm512_loadu_pd, _mm512_storeu_pd,
+                   _mm512_set1_pd, _mm512_mul_pd, *=)
+SIMD_SCALAR_KERNEL(SimdDivideAvx512, "avx512f", double, 8, _mm512_loadu_pd, _mm512_storeu_pd,
+                   _mm512_set1_pd, _mm512_div_pd, /=)
+SIMD_BINARY_KERNEL(SimdAddAvx512, "avx512f", float, 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_add_ps, +=)
+SIMD_BINARY_KERNEL(SimdSubtractAvx512, "avx512f", float, 16, _mm512_loadu_ps, _mm512_storeu_ps,
+                   _mm512_sub_ps, -=)
+SIMD_SCALAR_KERNEL(SimdMultiplyAvx512, "avx512f", float, 16, _mm512_loadu_ps, _mm512_storeu_ps,
+                   _mm512_set1_ps, _mm512_mul_ps, *=)
+SIMD_SCALAR_KERNEL(SimdDivideAvx512, "avx512f", float, 16, _mm512_loadu_ps, _mm512_storeu_ps,
+                   _mm512_set1_ps, _mm512_div_ps, /=)
+
+#undef SIMD_BINARY_KERNEL
+#undef SIMD_SCALAR_KERNEL
+
+// Register-blocked FMA micro-kernels: MR rows of a are broadcast against two vectors of b,
+// 2 * MR accumulators stay in registers for the whole kc loop
+
+__attribute__((target("avx2,fma")))
+inline void SimdGemmAvx2(size_t kc, const double* a, const double* b, double* c, size_t ldc) {
+    constexpr size_t MR = 6;
+    __m256d acc[MR][2];
+#pragma GCC unroll 8
+    for (size_t i = 0; i != MR; ++i) {
+        acc[i][0] = _mm256_setzero_pd();
+        acc[i][1] = _mm256_setzero_pd();
+    }
+    for (size_t p = 0; p != kc; ++p) {
+        __m256d b0 = _mm256_loadu_pd(b);
+        __m256d b1 = _mm256_loadu_pd(b + 4);
+#pragma GCC unroll 8
+        for (size_t i = 0; i != MR; ++i) {
+            __m256d ai = _mm256_broadcast_sd(a + i);
+            acc[i][0] = _mm256_fmadd_pd(ai, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_pd(ai, b1, acc[i][1]);
+        }
+        a += MR;
+        b += 8;
+    }
+#pragma GCC unroll 8
+    for (size_t i = 0; i != MR; ++i) {
+        double* row = c + i * ldc;
+        _mm256_storeu_pd(row, _mm256_add_pd(_mm256_loadu_pd(row), acc[i][0]));
+        _mm256_storeu_pd(row + 4, _mm256_add_pd(_mm256_loadu_pd(row + 4), acc[i][1]));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+inline void SimdGemmAvx2(size_t kc, const float* a, const float* b, float* c, size_t ldc) {
+    constexpr size_t MR = 6;
+    __m256 acc[MR][2];
+#pragma GCC unroll 8
+    for (size_t i = 0; i != MR; ++i) {
+        acc[i][0] = _mm256_setzero_ps();
+        acc[i][1] = _mm256_setzero_ps();
+    }
+    for (size_t p = 0; p != kc; ++p) {
+        __m256 b0 = _mm256_loadu_ps(b);
+        __m256 b1 = _mm256_loadu_ps(b + 8);
+#pragma GCC unroll 8
+        for (size_t i = 0; i != MR; ++i) {
+            __m256 ai = _mm256_broadcast_ss(a + i);
+            acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+        }
+        a += MR;
+        b += 16;
+    }
+#pragma GCC unroll 8
+    for (size_t i = 0; i != MR; ++i) {
+        float* row = c + i * ldc;
+        _mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), acc[i][0]));
+        _mm256_storeu_ps(row + 8, _mm256_add_ps(_mm256_loadu_ps(row + 8), acc[i][1]));
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void SimdGemmAvx512(size_t kc, const double* a, const double* b, double* c, size_t ldc) {
+    constexpr size_t MR = 8;
+    __m512d acc[MR][2];
+#pragma GCC unroll 8
+    for (size_t i = 0; i != MR; ++i) {
+        acc[i][0] = _mm512_setzero_pd();
+        acc[i][1] = _mm512_setzero_pd();
+    }
+    for (size_t p = 0; p != kc; ++p) {
+        __m512d b0 = _mm512_loadu_pd(b);
+        __m512d b1 = _mm512_loadu_pd(b + 8);
+#pragma GCC unroll 8
+        for (size_t i = 0; i != MR; ++i) {
+            __m512d ai = _mm512_set1_pd(a[i]);
+            acc[i][0] = _mm512_fmadd_pd(ai, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_pd(ai, b1, acc[i][1]);
+        }
+        a += MR;
+        b += 16;
+    }
+#pragma GCC unroll 8
+    for (size_t i = 0; i != MR; ++i) {
+        double* row = c + i * ldc;
+        _mm512_storeu_pd(row, _mm512_add_pd(_mm512_loadu_pd(row), acc[i][0]));
+        _mm512_storeu_pd(row + 8, _mm512_add_pd(_mm512_loadu_pd(row + 8), acc[i][1]));
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void SimdGemmAvx512(size_t kc, const float* a, const float* b, float* c, size_t ldc) {
+    constexpr size_t MR = 8;
+    __m512 acc[MR][2];
+#pragma GCC unroll 8
+    for (size_t i = 0; i != MR; ++i) {
+        acc[i][0] = _mm512_setzero_ps();
+        acc[i][1] = _mm512_setzero_ps();
+    }
+    for (size_t p = 0; p != kc; ++p) {
+        __m512 b0 = _mm512_loadu_ps(b);
+        __m512 b1 = _mm512_loadu_ps(b + 16);
+#pragma GCC unroll 8
+        for (size_t i = 0; i != MR; ++i) {
+            __m512 ai = _mm512_set1_ps(a[i]);
+            acc[i][0] = _mm512_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_ps(ai, b1, acc[i][1]);
+        }
+        a += MR;
+        b += 32;
+    }
+#pragma GCC unroll 8
+    for (size_t i = 0; i != MR; ++i) {
+        float* row = c + i * ldc;
+        _mm512_storeu_ps(row, _mm512_add_ps(_mm512_loadu_ps(row), acc[i][0]));
+        _mm512_storeu_ps(row + 16, _mm512_add_ps(_mm512_loadu_ps(row + 16), acc[i][1]));
+    }
+}
+
+// In-register transposes, AVX is enough for them so both levels share the kernels
+
+__attribute__((target("avx2")))
+inline void SimdTransposeAvx2(const double* src, size_t lds, double* dst, size_t ldd) {
+    __m256d r0 = _mm256_loadu_pd(src);
+    __m256d r1 = _mm256_loadu_pd(src + lds);
+    __m256d r2 = _mm256_loadu_pd(src + 2 * lds);
+    __m256d r3 = _mm256_loadu_pd(src + 3 * lds);
+    __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+    __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+    __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+    __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+    _mm256_storeu_pd(dst, _mm256_permute2f128_pd(t0, t2, 0x20));
+    _mm256_storeu_pd(dst + ldd, _mm256_permute2f128_pd(t1, t3, 0x20));
+    _mm256_storeu_pd(dst + 2 * ldd, _mm256_permute2f128_pd(t0, t2, 0x31));
+    _mm256_storeu_pd(dst + 3 * ldd, _mm256_permute2f128_pd(t1, t3, 0x31));
+}
+
+__attribute__((target("avx2")))
+inline void SimdTransposeAvx2(const float* src, size_t lds, float* dst, size_t ldd) {
+    __m256 r[8], t[8], s[8];
+#pragma GCC unroll 8
+    for (size_t i = 0; i != 8; ++i) {
+        r[i] = _mm256_loadu_ps(src + i * lds);
+    }
+#pragma GCC unroll 8
+    for (size_t i = 0; i != 8; i += 2) {
+        t[i] = _mm256_unpacklo_ps(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+    }
+#pragma GCC unroll 8
+    for (size_t i = 0; i != 8; i += 4) {
+        s[i] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+        s[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+        s[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+        s[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+#pragma GCC unroll 8
+    for (size_t i = 0; i != 4; ++i) {
+        _mm256_storeu_ps(dst + i * ldd, _mm256_permute2f128_ps(s[i], s[i + 4], 0x20));
+        _mm256_storeu_ps(dst + (i + 4) * ldd, _mm256_permute2f128_ps(s[i], s[i + 4], 0x31));
+    }
+}
+
+// Level-1/2 kernels: four independent accumulators hide the FMA latency, dotRows loads every
+// element of x once for four rows of the matrix, axpyRows loads and stores y once for four rows
+
+__attribute__((target("avx2")))
+inline double SimdSumAvx2(__m256d value) {
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(value), _mm256_extractf128_pd(value, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+}
+
+__attribute__((target("avx2")))
+inline float SimdSumAvx2(__m256 value) {
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    return _mm_cvtss_f32(_mm_add_ss(half, _mm_movehdup_ps(half)));
+}
+
+// Spelled out because GCC 12's _mm512_reduce_add_* trip -Wuninitialized
+__attribute__((target("avx512f")))
+inline double SimdSumAvx512(__m512d value) {
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, value);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+__attribute__((target("avx512f")))
+inline float SimdSumAvx512(__m512 value) {
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, value);
+    float ans = 0;
+    for (float lane : lanes) {
+        ans += lane;
+    }
+    return ans;
+}
+
+#define SIMD_LEVEL1_KERNELS(SUFFIX, TARGET, TYPE, VEC, WIDTH, LOAD, STORE, SET1, SETZERO, FMADD, ADD, SUM)  \
+__attribute__((target(TARGET)))                                                                           \
+inline TYPE SimdDot##SUFFIX(const TYPE* x, const TYPE* y, size_t count) {                                 \
+    VEC acc[4] = {SETZERO(), SETZERO(), SETZERO(), SETZERO()};                                            \
+    size_t i = 0;                                                                                         \
+    for (; i + 4 * WIDTH <= count; i += 4 * WIDTH) {                                                      \
+        _Pragma("GCC unroll 4")                                                                           \
+        for (size_t p = 0; p != 4; ++p) {                                                                 \
+            acc[p] = FMADD(LOAD(x + i + p * WIDTH), LOAD(y + i + p * WIDTH), acc[p]);                     \
+        }                                                                                                 \
+    }                                                                                                     \
+    for (; i + WIDTH <= count; i += WIDTH) {                                                              \
+        acc[0] = FMADD(LOAD(x + i), LOAD(y + i), acc[0]);                                                 \
+    }                                                                                                     \
+    TYPE ans = SUM(ADD(ADD(acc[0], acc[1]), ADD(acc[2], acc[3])));                                        \
+    for (; i != count; ++i) {                                                                             \
+        ans += x[i] * y[i];                                                                               \
+    }                                                                                                     \
+    return ans;                                                                                           \
+}                                                                                                         \
+                                                                                                          \
+__attribute__((target(TARGET)))                                                                           \
+inline void SimdDotRows##SUFFIX(const TYPE* a, size_t lda, const TYPE* x, size_t count, TYPE* out) {      \
+    VEC acc[kDotRows];                                                                                    \
+    _Pragma("GCC unroll 4")                                                                               \
+    for (size_t p = 0; p != kDotRows; ++p) {                                                              \
+        acc[p] = SETZERO();                                                                               \
+    }                                                                                                     \
+    size_t i = 0;                                                                                         \
+    for (; i + WIDTH <= count; i += WIDTH) {                                                              \
+        VEC xi = LOAD(x + i);                                                                             \
+        _Pragma("GCC unroll 4")                                                                           \
+        for (size_t p = 0; p != kDotRows; ++p) {                                                          \
+            acc[p] = FMADD(LOAD(a + p * lda + i), xi, acc[p]);                                            \
+        }                                                                                                 \
+    }                                                                                                     \
+    for (size_t p = 0; p != kDotRows; ++p) {                                                              \
+        TYPE sum = SUM(acc[p]);                                                                           \
+        for (size_t j = i; j != count; ++j) {                                                             \
+            sum += a[p * lda + j] * x[j];                                                                 \
+        }                                                                                                 \
+        out[p] = sum;                                                                                     \
+    }                                                                                                     \
+}                                                                                                         \
+                                                                                                          \
+__attribute__((target(TARGET)))                                                                           \
+inline void SimdAxpy##SUFFIX(TYPE* y, TYPE alpha, const TYPE* x, size_t count) {                          \
+    VEC broadcast = SET1(alpha);                                                                          \
+    size_t i = 0;                                                                                         \
+    for (; i + WIDTH <= count; i += WIDTH) {                                                              \
+        STORE(y + i, FMADD(broadcast, LOAD(x + i), LOAD(y + i)));                                         \
+    }                                                                                                     \
+    for (; i != count; ++i) {                                                                             \
+        y[i] += alpha * x[i];                                                                             \
+    }                                                                                                     \
+}                                                                                                         \
+                                                                                                          \
+__attribute__((target(TARGET)))                                                                           \
+inline void SimdAxpyRows##SUFFIX(TYPE* y, const TYPE* alpha, const TYPE* a, size_t lda, size_t count) {   \
+    VEC broadcast[kDotRows];                                                                              \
+    _Pragma("GCC unroll 4")                                                                               \
+    for (size_t p = 0; p != kDotRows; ++p) {                                                              \
+        broadcast[p] = SET1(alpha[p]);                                                                    \
+    }                                                                                                     \
+    size_t i = 0;                                                                                         \
+    for (; i + WIDTH <= count; i += WIDTH) {                                                              \
+        VEC sum = LOAD(y + i);                                                                            \
+        _Pragma("GCC unroll 4")                                                                           \
+        for (size_t p = 0; p != kDotRows; ++p) {                                                          \
+            sum = FMADD(broadcast[p], LOAD(a + p * lda + i), sum);                                        \
+        }                                                                                                 \
+        STORE(y + i, sum);                                                                                \
+    }                                                                                                     \
+    for (; i != count; ++i) {                                                                             \
+        for (size_t p = 0; p != kDotRows; ++p) {                                                          \
+            y[i] += alpha[p] * a[p * lda + i];                                                            \
+        }                                                                                                 \
+    }                                                                                                     \
+}
+
+SIMD_LEVEL1_KERNELS(Avx2, "avx2,fma", double, __m256d, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd,
+                    _mm256_setzero_pd, _mm256_fmadd_pd, _mm256_add_pd, SimdSumAvx2)
+SIMD_LEVEL1_KERNELS(Avx2, "avx2,fma", float, __m256, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps,
+                    _mm256_setzero_ps, _mm256_fmadd_ps, _mm256_add_ps, SimdSumAvx2)
+SIMD_LEVEL1_KERNELS(Avx512, "avx512f", double, __m512d, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_set1_pd,
+                    _mm512_setzero_pd, _mm512_fmadd_pd, _mm512_add_pd, SimdSumAvx512)
+SIMD_LEVEL1_KERNELS(Avx512, "avx512f", float, __m512, 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_set1_ps,
+                    _mm512_setzero_ps, _mm512_fmadd_ps, _mm512_add_ps, SimdSumAvx512)
+
+#undef SIMD_LEVEL1_KERNELS
+
+template<>
+inline const SimdKernels<double>& SimdKernels<double>::Get() {
+    static const SimdKernels tables[] = {
+        {},
+        {SimdAddAvx2, SimdSubtractAvx2, SimdMultiplyAvx2, SimdDivideAvx2, 6, 8, SimdGemmAvx2,
+         4, SimdTransposeAvx2, SimdDotAvx2, SimdDotRowsAvx2, SimdAxpyAvx2,
+         SimdAxpyRowsAvx2},
+        {SimdAddAvx512, SimdSubtractAvx512, SimdMultiplyAvx512, SimdDivideAvx512, 8, 16, SimdGemmAvx512,
+         4, SimdTransposeAvx2, SimdDotAvx512, SimdDotRowsAvx512, SimdAxpyAvx512,
+         SimdAxpyRowsAvx512}
+    };
+    return tables[static_cast<size_t>(CurrentSimdLevel())];
+}
+
+template<>
+inline const SimdKernels<float>& SimdKernels<float>::Get() {
+    static const SimdKernels tables[] = {
+        {},
+        {SimdAddAvx2, SimdSubtractAvx2, SimdMultiplyAvx2, SimdDivideAvx2, 6, 16, SimdGemmAvx2,
+         8, SimdTransposeAvx2, SimdDotAvx2, SimdDotRowsAvx2, SimdAxpyAvx2,
+         SimdAxpyRowsAvx2},
+        {SimdAddAvx512, SimdSubtractAvx512, SimdMultiplyAvx512, SimdDivideAvx512, 8, 32, SimdGemmAvx512,
+         8, SimdTransposeAvx2, SimdDotAvx512, SimdDotRowsAvx512, SimdAxpyAvx512,
+         SimdAxpyRowsAvx512}
+    };
+    return tables[static_cast<size_t>(CurrentSimdLevel())];
+}
+
+#endif
+
+// Element-wise helpers used by Matrix, fall back to plain loops for every other ValueType
+
+template<typename ValueType>
+void VectorAdd(ValueType* dst, const ValueType* src, size_t count) {
+    if (auto kernel = SimdKernels<ValueType>::Get().add) {
+        return kernel(dst, src, count);
+    }
+    for (size_t i = 0; i != count; ++i) {
+        dst[i] += src[i];
+    }
+}
+
+template<typename ValueType>
+void VectorSubtract(ValueType* dst, const ValueType* src, size_t count) {
+    if (auto kernel = SimdKernels<ValueType>::Get().subtract) {
+        return kernel(dst, src, count);
+    }
+    for (size_t i = 0; i != count; ++i) {
+        dst[i] -= src[i];
+    }
+}
+
+template<typename ValueType>
+void VectorMultiply(ValueType* dst, ValueType value, size_t count) {
+    if (auto kernel = SimdKernels<ValueType>::Get().multiply) {
+        return kernel(dst, value, count);
+    }
+    for (size_t i = 0; i != count; ++i) {
+        dst[i] *= value;
+    }
+}
+
+template<typename ValueType>
+void VectorDivide(ValueType* dst, ValueType value, size_t count) {
+    if (auto kernel = SimdKernels<ValueType>::Get().divide) {
+        return kernel(dst, value, count);
+    }
+    for (size_t i = 0; i != count; ++i) {
+        dst[i] /= value;
+    }
+}
+
+template<typename ValueType>
+ValueType VectorDot(const ValueType* x, const ValueType* y, size_t count) {
+    if (auto kernel = SimdKernels<ValueType>::Get().dot) {
+        return kernel(x, y, count);
+    }
+    ValueType ans = ValueType();
+    for (size_t i = 0; i != count; ++i) {
+        ans += x[i] * y[i];
+    }
+    return ans;
+}
+
+// out[p] = dot(a + p * lda, x) for p < kDotRows
+template<typename ValueType>
+void VectorDotRows(const ValueType* a, size_t lda, const ValueType* x, size_t count, ValueType* out) {
+    if (auto kernel = SimdKernels<ValueType>::Get().dotRows) {
+        return kernel(a, lda, x, count, out);
+    }
+    for (size_t p = 0; p != kDotRows; ++p) {
+        out[p] = VectorDot(a + p * lda, x, count);
+    }
+}
+
+// y += alpha * x
+template<typename ValueType>
+void VectorAxpy(ValueType* y, ValueType alpha, const ValueType* x, size_t count) {
+    if (auto kernel = SimdKernels<ValueType>::Get().axpy) {
+        return kernel(y, alpha, x, count);
+    }
+    for (size_t i = 0; i != count; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+// y += sum of alpha[p] * (a + p * lda) for p < kDotRows
+template<typename ValueType>
+void VectorAxpyRows(ValueType* y, const ValueType* alpha, const ValueType* a, size_t lda, size_t count) {
+    if (auto kernel = SimdKernels<ValueType>::Get().axpyRows) {
+        return kernel(y, alpha, a, lda, count);
+    }
+    for (size_t i = 0; i != count; ++i) {
+        for (size_t p = 0; p != kDotRows; ++p) {
+            y[i] += alpha[p] * a[p * lda + i];
+        }
+    }
+}
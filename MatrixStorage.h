@@ -0,0 +1,369 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// What MeasureAllocations reports for one operation: heap blocks taken by aligned allocators
+// and arena chunks, allocations served from the per-thread arenas, and the highest number of
+// heap bytes alive at once above the level at the start
+struct AllocationStats {
+    size_t allocations = 0;
+    size_t arenaAllocations = 0;
+    size_t peakBytes = 0;
+};
+
+// Process-wide counters behind AllocationStats, updated with relaxed atomics
+class AllocationTracker {
+ public:
+    static AllocationTracker& Instance() {
+        static AllocationTracker tracker;
+        return tracker;
+    }
+
+    void Allocated(size_t bytes) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        size_t live = liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t peak = peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    }
+
+    void Freed(size_t bytes) {
+        liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    void ArenaAllocated() {
+        arenaAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] size_t Allocations() const {
+        return allocations.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] size_t ArenaAllocations() const {
+        return arenaAllocations.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] size_t LiveBytes() const {
+        return liveBytes.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] size_t PeakBytes() const {
+        return peakBytes.load(std::memory_order_relaxed);
+    }
+
+    // Starts a new peak from the current live bytes
+    void ResetPeak() {
+        peakBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+ private:
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> arenaAllocations{0};
+    std::atomic<size_t> liveBytes{0};
+    std::atomic<size_t> peakBytes{0};
+};
+
+// Counts what function() allocates. The counters are global, so work running concurrently on
+// other threads is included, and two measurements shouldn't overlap.
+template<typename Function>
+AllocationStats MeasureAllocations(Function&& function) {
+    AllocationTracker& tracker = AllocationTracker::Instance();
+    size_t allocations = tracker.Allocations(), arenaAllocations = tracker.ArenaAllocations();
+    size_t live = tracker.LiveBytes();
+    tracker.ResetPeak();
+    function();
+    return {tracker.Allocations() - allocations, tracker.ArenaAllocations() - arenaAllocations,
+            tracker.PeakBytes() - live};
+}
+
+// Cache line aligned storage, so rows of float/double matrices start on vector boundaries
+template<typename ValueType, size_t Alignment = 64>
+class AlignedAllocator {
+ public:
+    using value_type = ValueType;
+
+    template<typename OtherType>
+    struct rebind {
+        using other = AlignedAllocator<OtherType, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template<typename OtherType>
+    AlignedAllocator(const AlignedAllocator<OtherType, Alignment>&) {}
+
+    ValueType* allocate(size_t count) {
+        AllocationTracker::Instance().Allocated(count * sizeof(ValueType));
+        return static_cast<ValueType*>(
+            ::operator new(count * sizeof(ValueType), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(ValueType* ptr, size_t count) {
+        AllocationTracker::Instance().Freed(count * sizeof(ValueType));
+        ::operator delete(ptr, std::align_val_t(Alignment));
+    }
+
+    template<typename OtherType>
+    bool operator==(const AlignedAllocator<OtherType, Alignment>&) const {
+        return true;
+    }
+
+    template<typename OtherType>
+    bool operator!=(const AlignedAllocator<OtherType, Alignment>&) const {
+        return false;
+    }
+};
+
+// Monotonic scratch memory owned by one thread. Allocation bumps a pointer through a list of
+// chunks that are kept for reuse, nothing is freed individually; Rewind(mark) releases everything
+// allocated after Mark() at once. Use it through ArenaScope and ArenaAllocator.
+class MatrixArena {
+ public:
+    static constexpr size_t kMinChunk = static_cast<size_t>(1) << 20;
+    static constexpr size_t kAlignment = 64;
+
+    struct Position {
+        size_t chunk = 0;
+        size_t offset = 0;
+    };
+
+    MatrixArena() = default;
+
+    MatrixArena(const MatrixArena&) = delete;
+
+    MatrixArena& operator=(const MatrixArena&) = delete;
+
+    ~MatrixArena() {
+        for (const Chunk& chunk : chunks) {
+            AllocationTracker::Instance().Freed(chunk.size);
+            ::operator delete(chunk.data, std::align_val_t(kAlignment));
+        }
+    }
+
+    static MatrixArena& ThreadLocal() {
+        thread_local MatrixArena arena;
+        return arena;
+    }
+
+    void* Allocate(size_t bytes) {
+        AllocationTracker::Instance().ArenaAllocated();
+        bytes = (std::max(bytes, static_cast<size_t>(1)) + kAlignment - 1) / kAlignment * kAlignment;
+        while (current != chunks.size() && offset + bytes > chunks[current].size) {
+            ++current;
+            offset = 0;
+        }
+        if (current == chunks.size()) {
+            size_t size = std::max({kMinChunk, bytes, chunks.empty() ? 0 : 2 * chunks.back().size});
+            AllocationTracker::Instance().Allocated(size);
+            chunks.push_back({static_cast<char*>(::operator new(size, std::align_val_t(kAlignment))), size});
+        }
+        void* ans = chunks[current].data + offset;
+        offset += bytes;
+        return ans;
+    }
+
+    [[nodiscard]] Position Mark() const {
+        return {current, offset};
+    }
+
+    void Rewind(Position position) {
+        current = position.chunk;
+        offset = position.offset;
+    }
+
+    // Bytes held in chunks, used or not
+    [[nodiscard]] size_t Capacity() const {
+        size_t ans = 0;
+        for (const Chunk& chunk : chunks) {
+            ans += chunk.size;
+        }
+        return ans;
+    }
+
+ private:
+    struct Chunk {
+        char* data;
+        size_t size;
+    };
+
+    std::vector<Chunk> chunks;
+    size_t current = 0;
+    size_t offset = 0;
+};
+
+// Everything this thread takes from its arena while the scope is alive is released when it ends.
+// Scopes nest like the stack, which also holds for pool tasks run while a thread waits.
+class ArenaScope {
+ public:
+    ArenaScope() : arena(MatrixArena::ThreadLocal()), mark(arena.Mark()) {}
+
+    ArenaScope(const ArenaScope&) = delete;
+
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    ~ArenaScope() {
+        arena.Rewind(mark);
+    }
+
+ private:
+    MatrixArena& arena;
+    MatrixArena::Position mark;
+};
+
+// Allocates from the calling thread's arena, deallocation is a no-op. Only for scratch containers
+// that die inside the ArenaScope of the thread that created them.
+template<typename ValueType>
+class ArenaAllocator {
+ public:
+    using value_type = ValueType;
+
+    template<typename OtherType>
+    struct rebind {
+        using other = ArenaAllocator<OtherType>;
+    };
+
+    ArenaAllocator() = default;
+
+    template<typename OtherType>
+    ArenaAllocator(const ArenaAllocator<OtherType>&) {}
+
+    ValueType* allocate(size_t count) {
+        return static_cast<ValueType*>(MatrixArena::ThreadLocal().Allocate(count * sizeof(ValueType)));
+    }
+
+    void deallocate(ValueType*, size_t) {}
+
+    template<typename OtherType>
+    bool operator==(const ArenaAllocator<OtherType>&) const {
+        return true;
+    }
+
+    template<typename OtherType>
+    bool operator!=(const ArenaAllocator<OtherType>&) const {
+        return false;
+    }
+};
+
+// Non-owning view of one row, behaves like a fixed-size std::vector for indexing and iteration
+template<typename ValueType>
+class MatrixRow {
+ public:
+    using value_type = std::remove_const_t<ValueType>;
+    using iterator = ValueType*;
+
+    MatrixRow(ValueType* data, size_t size) : first(data), length(size) {}
+
+    operator MatrixRow<const ValueType>() const {
+        return {first, length};
+    }
+
+    ValueType& operator[](size_t idx) const {
+        return first[idx];
+    }
+
+    [[nodiscard]] size_t size() const {
+        return length;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return length == 0;
+    }
+
+    ValueType* data() const {
+        return first;
+    }
+
+    ValueType* begin() const {
+        return first;
+    }
+
+    ValueType* end() const {
+        return first + length;
+    }
+
+ private:
+    ValueType* first;
+    size_t length;
+};
+
+// Non-owning view of a rectangular sub-block, rows are `stride` elements apart
+template<typename ValueType>
+class MatrixBlock {
+ public:
+    MatrixBlock(ValueType* data, size_t rows, size_t columns, size_t stride) :
+        first(data), rows(rows), columns(columns), stride(stride) {}
+
+    operator MatrixBlock<const ValueType>() const {
+        return {first, rows, columns, stride};
+    }
+
+    MatrixRow<ValueType> operator[](size_t idx) const {
+        return {first + idx * stride, columns};
+    }
+
+    [[nodiscard]] size_t Rows() const {
+        return rows;
+    }
+
+    [[nodiscard]] size_t Columns() const {
+        return columns;
+    }
+
+    [[nodiscard]] size_t Stride() const {
+        return stride;
+    }
+
+    ValueType* Data() const {
+        return first;
+    }
+
+    MatrixBlock Block(size_t row, size_t column, size_t blockRows, size_t blockColumns) const {
+        return {first + row * stride + column, blockRows, blockColumns, stride};
+    }
+
+ private:
+    ValueType* first;
+    size_t rows;
+    size_t columns;
+    size_t stride;
+};
+
+// Walks matrix rows, dereferences into MatrixRow proxies
+template<typename ValueType>
+class MatrixRowIterator {
+ public:
+    MatrixRowIterator(ValueType* data, size_t columns, size_t stride) :
+        current(data), columns(columns), stride(stride) {}
+
+    MatrixRow<ValueType> operator*() const {
+        return {current, columns};
+    }
+
+    MatrixRowIterator& operator++() {
+        current += stride;
+        return *this;
+    }
+
+    MatrixRowIterator operator++(int) {
+        MatrixRowIterator old(*this);
+        current += stride;
+        return old;
+    }
+
+    bool operator==(const MatrixRowIterator& other) const {
+        return current == other.current;
+    }
+
+    bool operator!=(const MatrixRowIterator& other) const {
+        return current != other.current;
+    }
+
+ private:
+    ValueType* current;
+    size_t columns;
+    size_t stride;
+};
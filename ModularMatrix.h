@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+// Matrix products and powers over residues modulo m < 2^62, elements stored as uint64_t.
+// Inner products are summed without reduction for as long as the accumulator can't overflow:
+// in 64-bit lanes when m <= 2^32 (every product fits 64 bits and the loop vectorizes), in 128-bit
+// ones otherwise. Accumulators are brought back below m with Barrett reduction.
+
+using uint128_t = unsigned __int128;
+
+class ModularReducer {
+ public:
+    static constexpr uint64_t kMaxModulus = 1ULL << 62;
+
+    explicit ModularReducer(uint64_t modulus) : modulus(modulus) {
+        if (modulus < 2 || modulus >= kMaxModulus) {
+            THROW(invalid_argument, "Modulus has to be in [2, 2^62)")
+        }
+        factor64 = ~0ULL / modulus;
+        factor128 = ~static_cast<uint128_t>(0) / modulus;
+        uint128_t largest = static_cast<uint128_t>(modulus - 1) * (modulus - 1);
+        if (Narrow()) {
+            delayedTerms = largest == 0 ? ~0ULL : (~0ULL - (modulus - 1)) / static_cast<uint64_t>(largest);
+        } else {
+            uint128_t terms = (~static_cast<uint128_t>(0) - (modulus - 1)) / largest;
+            delayedTerms = terms > ~0ULL ? ~0ULL : static_cast<uint64_t>(terms);
+        }
+    }
+
+    [[nodiscard]] uint64_t Modulus() const {
+        return modulus;
+    }
+
+    // Residues are below 2^32, so products fit 64 bits
+    [[nodiscard]] bool Narrow() const {
+        return modulus <= (1ULL << 32);
+    }
+
+    // Products that can be added to a reduced accumulator before it has to be reduced again,
+    // 64-bit accumulator when Narrow(), 128-bit otherwise
+    [[nodiscard]] uint64_t DelayedTerms() const {
+        return delayedTerms;
+    }
+
+    [[nodiscard]] uint64_t Reduce(uint64_t value) const {
+        uint64_t quotient = static_cast<uint64_t>((static_cast<uint128_t>(value) * factor64) >> 64);
+        uint64_t ans = value - quotient * modulus;
+        while (ans >= modulus) {
+            ans -= modulus;
+        }
+        return ans;
+    }
+
+    [[nodiscard]] uint64_t Reduce(uint128_t value) const {
+        uint128_t ans = value - MultiplyHigh(value, factor128) * modulus;
+        while (ans >= modulus) {
+            ans -= modulus;
+        }
+        return static_cast<uint64_t>(ans);
+    }
+
+    [[nodiscard]] uint64_t Multiply(uint64_t first, uint64_t second) const {
+        return Reduce(static_cast<uint128_t>(first) * second);
+    }
+
+ private:
+    // Upper half of the 256-bit product
+    static uint128_t MultiplyHigh(uint128_t first, uint128_t second) {
+        uint64_t x0 = static_cast<uint64_t>(first), x1 = static_cast<uint64_t>(first >> 64);
+        uint64_t y0 = static_cast<uint64_t>(second), y1 = static_cast<uint64_t>(second >> 64);
+        uint128_t low = static_cast<uint128_t>(x0) * y0;
+        uint128_t crossFirst = static_cast<uint128_t>(x1) * y0;
+        uint128_t crossSecond = static_cast<uint128_t>(x0) * y1;
+        uint128_t middle = (low >> 64) + static_cast<uint64_t>(crossFirst) + static_cast<uint64_t>(crossSecond);
+        return static_cast<uint128_t>(x1) * y1 + (crossFirst >> 64) + (crossSecond >> 64) + (middle >> 64);
+    }
+
+    uint64_t modulus;
+    uint64_t factor64;
+    uint128_t factor128;
+    uint64_t delayedTerms;
+};
+
+inline void ModularReduce(Matrix<uint64_t>& a, const ModularReducer& reducer) {
+    for (auto row : a) {
+        for (auto& element : row) {
+            element = reducer.Reduce(element);
+        }
+    }
+}
+
+// Columns of the result handled together, the accumulators of one row stay in L1
+constexpr size_t kModularColumnBlock = 512;
+
+// out[from..to) rows = a * b, Accumulator is uint64_t for narrow moduli and uint128_t otherwise
+template<typename Accumulator>
+void ModularMultiplyRows(const Matrix<uint64_t>& a, const Matrix<uint64_t>& b, const ModularReducer& reducer,
+                         Matrix<uint64_t>& out, size_t from, size_t to) {
+    size_t inner = a.Columns();
+    size_t width = b.Columns();
+    size_t block = std::min(kModularColumnBlock, width);
+    size_t delay = static_cast<size_t>(std::min<uint64_t>(reducer.DelayedTerms(), inner));
+    std::vector<Accumulator> accumulator(block);
+    for (size_t column = 0; column < width; column += block) {
+        size_t columns = std::min(block, width - column);
+        for (size_t i = from; i != to; ++i) {
+            const uint64_t* row = a.Data() + i * a.Stride();
+            std::fill(accumulator.begin(), accumulator.end(), Accumulator(0));
+            for (size_t chunk = 0; chunk < inner; chunk += delay) {
+                size_t last = std::min(inner, chunk + delay);
+                for (size_t k = chunk; k != last; ++k) {
+                    const uint64_t value = row[k];
+                    const uint64_t* other = b.Data() + k * b.Stride() + column;
+                    if constexpr (std::is_same_v<Accumulator, uint64_t>) {
+                        // Both factors are below 2^32, which lets the compiler use 32x32->64 vector multiplies
+                        const uint32_t narrow = static_cast<uint32_t>(value);
+                        for (size_t j = 0; j != columns; ++j) {
+                            accumulator[j] += static_cast<uint64_t>(narrow) * static_cast<uint32_t>(other[j]);
+                        }
+                    } else {
+                        for (size_t j = 0; j != columns; ++j) {
+                            accumulator[j] += static_cast<uint128_t>(value) * other[j];
+                        }
+                    }
+                }
+                if (last != inner) {
+                    for (size_t j = 0; j != columns; ++j) {
+                        accumulator[j] = reducer.Reduce(accumulator[j]);
+                    }
+                }
+            }
+            uint64_t* result = out.Data() + i * out.Stride() + column;
+            for (size_t j = 0; j != columns; ++j) {
+                result[j] = reducer.Reduce(accumulator[j]);
+            }
+        }
+    }
+}
+
+// out = a * b mod reducer.Modulus(), elements of a and b have to be reduced already.
+// out must have the right size and differ from a and b.
+inline void ModularMultiply(const Matrix<uint64_t>& a, const Matrix<uint64_t>& b, const ModularReducer& reducer,
+                            Matrix<uint64_t>& out) {
+    if (a.Columns() != b.Rows() || out.Rows() != a.Rows() || out.Columns() != b.Columns()) {
+        THROW(out_of_range, "Can't multiply")
+    }
+    size_t work = std::max(a.Columns() * b.Columns(), static_cast<size_t>(1));
+    ThreadPool::Instance().ParallelFor(0, a.Rows(), ThreadPool::Instance().MinTaskSize() / work,
+                                       [&](size_t from, size_t to) {
+        if (reducer.Narrow()) {
+            ModularMultiplyRows<uint64_t>(a, b, reducer, out, from, to);
+        } else {
+            ModularMultiplyRows<uint128_t>(a, b, reducer, out, from, to);
+        }
+    });
+}
+
+inline Matrix<uint64_t> ModularMultiply(const Matrix<uint64_t>& a, const Matrix<uint64_t>& b, uint64_t modulus) {
+    ModularReducer reducer(modulus);
+    Matrix<uint64_t> first(a), second(b), ans(a.Rows(), b.Columns());
+    ModularReduce(first, reducer);
+    ModularReduce(second, reducer);
+    ModularMultiply(first, second, reducer, ans);
+    return ans;
+}
+
+// a^pow mod modulus for a square a, pow up to 2^64 - 1. Squarings and products alternate between
+// three matrices allocated once.
+inline Matrix<uint64_t> ModularPow(const Matrix<uint64_t>& a, uint64_t pow, uint64_t modulus) {
+    if (a.empty() || a.Rows() != a.Columns()) {
+        THROW(out_of_range, "Can't raise a non-square matrix to a power")
+    }
+    ModularReducer reducer(modulus);
+    size_t n = a.Rows();
+    Matrix<uint64_t> ans = Matrix<uint64_t>::Unit(n), mult(a), buffer(n, n);
+    ModularReduce(mult, reducer);
+    bool unit = true;
+    while (pow != 0) {
+        if (pow & 1ULL) {
+            if (unit) {
+                ans = mult;
+                unit = false;
+            } else {
+                ModularMultiply(ans, mult, reducer, buffer);
+                std::swap(ans, buffer);
+            }
+        }
+        pow >>= 1ULL;
+        if (pow != 0) {
+            ModularMultiply(mult, mult, reducer, buffer);
+            std::swap(mult, buffer);
+        }
+    }
+    return ans;
+}
@@ -0,0 +1,99 @@
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Matrix.h"
+#include "ModularMatrix.h"
+
+// Usage: ModularPowBenchmark [sizes...] [--pow=N] [--mod=M]
+// Times a^pow mod M with ModularPow against Matrix::Pow over an element type that reduces
+// after every operation, the way modular powers were computed before.
+
+uint64_t modulus = 1000000007;
+
+// Residue reduced with % after every multiplication and addition
+struct Residue {
+    uint64_t value = 0;
+
+    Residue() = default;
+
+    Residue(uint64_t value) : value(value % modulus) {}
+
+    Residue operator*(const Residue& other) const {
+        return Residue(static_cast<uint64_t>(static_cast<unsigned __int128>(value) * other.value % modulus));
+    }
+
+    Residue& operator+=(const Residue& other) {
+        value += other.value;
+        if (value >= modulus) {
+            value -= modulus;
+        }
+        return *this;
+    }
+
+    Residue operator+(const Residue& other) const {
+        Residue ans(*this);
+        return ans += other;
+    }
+
+    bool operator==(const Residue& other) const {
+        return value == other.value;
+    }
+
+    bool operator!=(const Residue& other) const {
+        return value != other.value;
+    }
+};
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    uint64_t pow = 1000000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--pow=", 0) == 0) {
+            pow = std::stoull(arg.substr(6));
+        } else if (arg.rfind("--mod=", 0) == 0) {
+            modulus = std::stoull(arg.substr(6));
+        } else {
+            sizes.push_back(std::stoul(arg));
+        }
+    }
+    if (sizes.empty()) {
+        sizes = {2, 4, 8, 16, 32, 64, 128, 256, 512};
+    }
+
+    std::mt19937_64 rng(42);
+    std::cout << "a^" << pow << " mod " << modulus << '\n'
+              << std::setw(6) << "n" << std::setw(14) << "reference" << std::setw(14) << "modular"
+              << std::setw(10) << "speedup" << "   (seconds)\n";
+    for (size_t n : sizes) {
+        Matrix<uint64_t> a(n, n);
+        Matrix<Residue> reference(n, n);
+        for (size_t i = 0; i != n; ++i) {
+            for (size_t j = 0; j != n; ++j) {
+                a[i][j] = rng() % modulus;
+                reference[i][j] = a[i][j];
+            }
+        }
+
+        Matrix<Residue> expected(0, 0);
+        double referenceTime = Seconds([&] { expected = reference.Pow(pow); });
+        Matrix<uint64_t> ans(0, 0);
+        double modularTime = Seconds([&] { ans = ModularPow(a, pow, modulus); });
+
+        bool same = true;
+        for (size_t i = 0; i != n; ++i) {
+            for (size_t j = 0; j != n; ++j) {
+                same = same && expected[i][j].value == ans[i][j];
+            }
+        }
+        std::cout << std::setw(6) << n << std::scientific << std::setprecision(3)
+                  << std::setw(14) << referenceTime << std::setw(14) << modularTime
+                  << std::fixed << std::setprecision(2) << std::setw(9) << referenceTime / modularTime << 'x'
+                  << (same ? "" : "   MISMATCH") << '\n';
+    }
+}
@@ -1,375 +1,823 @@
-#pragma once
-
-#include <forward_list>
-#include <iostream>
-#include <map>
-#include <vector>
-
-template<typename ValueType>
-class Polynomial {
- public:
-    using const_iterator = typename std::map<size_t, ValueType>::const_iterator;
-
-    // We should be able to create double polynomial from vector<int>
-    template<typename OtherValueType>
-    explicit Polynomial(const std::vector<OtherValueType>& other) :
-        Polynomial(other.begin(), other.end()) {}
-
-    // Haven't made it explicit for automatic conversions in operations
-    // Added enable_if for normal work of vector constructor and copy/move constructors
-    Polynomial(ValueType other = ValueType(0));
-
-    // Have't reserved memory because OtherIter can be not RandomAccess
-    template<typename OtherIter>
-    Polynomial(OtherIter first, OtherIter last);
-
-    const std::map<size_t, ValueType>& GetSequence() const;
-
-    bool operator==(const Polynomial& other) const;
-
-    bool operator!=(const Polynomial& other) const;
-
-    ValueType operator[](size_t i) const;
-
-    int64_t Degree() const;
-
-    const_iterator begin() const;
-
-    const_iterator end() const;
-
-    Polynomial& operator+=(const Polynomial& other);
-
-    Polynomial& operator-=(const Polynomial& other);
-
-    Polynomial& operator*=(const Polynomial& other);
-
-    Polynomial operator+(const Polynomial& other) const;
-
-    Polynomial operator-(const Polynomial& other) const;
-
-    Polynomial operator*(const Polynomial& other) const;
-
-    ValueType operator()(ValueType other) const;
-
-    Polynomial operator&(const Polynomial& other) const;
-
-    Polynomial operator/(const Polynomial& other) const;
-
-    Polynomial operator%(const Polynomial& other) const;
-
-    Polynomial operator,(const Polynomial& other) const;
-
-    Polynomial Pow(const size_t power) const;
-
-    Polynomial& RemoveZeros() {
-        for (auto it = sequence.begin(); it != sequence.end();) {
-            if (it->second == 0) {
-                it = sequence.erase(it);
-            } else {
-                ++it;
-            }
-        }
-        return *this;
-    }
-
- private:
-    std::map<size_t, ValueType> sequence;
-};
-
-template<typename ValueType>
-template<typename OtherIter>
-Polynomial<ValueType>::Polynomial(OtherIter first, OtherIter last) {
-    size_t idx = 0;
-    while (first != last) {
-        if (*first != ValueType(0)) {
-            sequence[idx] = *first;
-        }
-        ++first;
-        ++idx;
-    }
-}
-
-template<typename ValueType>
-const std::map<size_t, ValueType>& Polynomial<ValueType>::GetSequence() const {
-    return sequence;
-}
-
-template<typename ValueType>
-bool Polynomial<ValueType>::operator==(const Polynomial<ValueType>& other) const {
-    int64_t degree = Degree(), otherDegree = other.Degree();
-    if (degree != otherDegree) {
-        return false;
-    }
-    auto itOther = other.sequence.begin();
-    for (auto it = sequence.begin(); it != sequence.end(); ++it) {
-        while (itOther != other.sequence.end() && itOther->second == 0) {
-            ++itOther;
-        }
-        if (it->second == 0) {
-            continue;
-        }
-        if (itOther == other.sequence.end() || it->second != itOther->second) {
-            return false;
-        }
-        ++itOther;
-    }
-    while (itOther != other.sequence.end() && itOther->second == 0) {
-        ++itOther;
-    }
-    return itOther == other.sequence.end();
-}
-
-template<typename ValueType>
-bool Polynomial<ValueType>::operator!=(const Polynomial<ValueType>& other) const {
-    return !(*this == other);
-}
-
-template<typename ValueType>
-ValueType Polynomial<ValueType>::operator[](size_t i) const {
-    auto it = sequence.find(i);
-    return it == sequence.end() ? 0 : it->second;
-}
-
-template<typename ValueType>
-int64_t Polynomial<ValueType>::Degree() const {
-    for (auto it = sequence.rbegin(); it != sequence.rend(); ++it) {
-        if (it->second != 0) {
-            return it->first;
-        }
-    }
-    return -1;
-}
-
-template<typename ValueType>
-typename Polynomial<ValueType>::const_iterator Polynomial<ValueType>::begin() const {
-    return sequence.cbegin();
-}
-
-template<typename ValueType>
-typename Polynomial<ValueType>::const_iterator Polynomial<ValueType>::end() const {
-    int64_t degree = Degree();
-    if (degree == -1) {
-        return begin();
-    }
-    for (auto it = sequence.begin(); it != sequence.end(); ++it) {
-        if (it->first == static_cast<size_t>(degree)) {
-            return ++it;
-        }
-    }
-    return sequence.end();
-}
-
-template<typename ValueType>
-Polynomial<ValueType>& Polynomial<ValueType>::operator+=(const Polynomial<ValueType>& other) {
-    for (const auto& i : other.sequence) {
-        sequence[i.first] += i.second;
-    }
-    return RemoveZeros();
-}
-
-template<typename ValueType>
-Polynomial<ValueType>& Polynomial<ValueType>::operator-=(const Polynomial<ValueType>& other) {
-    for (const auto& i : other.sequence) {
-        sequence[i.first] -= i.second;
-    }
-    return RemoveZeros();
-}
-
-template<typename ValueType>
-Polynomial<ValueType>& Polynomial<ValueType>::operator*=(const Polynomial<ValueType>& other) {
-    *this = *this * other;
-    return RemoveZeros();
-}
-
-template<typename ValueType>
-Polynomial<ValueType> Polynomial<ValueType>::operator+(const Polynomial<ValueType>& other) const {
-    return Polynomial(*this) += other;
-}
-
-template<typename ValueType>
-Polynomial<ValueType> Polynomial<ValueType>::operator-(const Polynomial<ValueType>& other) const {
-    return Polynomial(*this) -= other;
-}
-
-template<typename ValueType>
-Polynomial<ValueType> Polynomial<ValueType>::operator*(const Polynomial<ValueType>& other) const {
-    std::map<size_t, ValueType> newPoly;
-    for (const auto& i : sequence) {
-        for (const auto& j : other.sequence) {
-            newPoly[i.first + j.first] += i.second * j.second;
-        }
-    }
-    Polynomial<ValueType> ans(0);
-    ans.sequence = std::move(newPoly);
-
-    return ans.RemoveZeros();
-}
-
-template<typename ValueType>
-Polynomial<ValueType> Polynomial<ValueType>::operator&(const Polynomial& other) const {
-    Polynomial<ValueType> ans = ValueType(0);
-    for (const auto& i : sequence) {
-        ans += other.Pow(i.first) * i.second;
-    }
-    return ans;
-}
-
-template<typename ValueType>
-ValueType Polynomial<ValueType>::operator()(const ValueType other) const {
-    return (*this & other)[0];
-}
-
-template<typename ValueType>
-Polynomial<ValueType> Polynomial<ValueType>::operator/(const Polynomial& other) const {
-    int64_t degree = Degree(), otherDegree = other.Degree();
-    if (degree == -1 || otherDegree == -1) {
-        return ValueType(0);
-    }
-
-    std::forward_list<std::pair<size_t, ValueType>> ans;
-    Polynomial<ValueType> remainder(*this);
-    remainder.RemoveZeros();
-    // Cause otherDegree can't be -1, we don't need to compare with 0
-    // i >= otherDegree -> i >= 0
-    int64_t i = degree;
-    while (i >= otherDegree) {
-        auto iter = remainder.sequence.lower_bound(i);
-        if (iter != remainder.sequence.end() && static_cast<int64_t>(iter->first) == i) {
-            if (iter->second != 0) {
-                ans.emplace_front(i - otherDegree, iter->second / other[otherDegree]);
-                for (const auto& j : other.sequence) {
-                    remainder.sequence[i + j.first - otherDegree] -=
-                        j.second * ans.front().second;
-                }
-            }
-            --i;
-        } else {
-            if (iter == remainder.GetSequence().begin()) {
-                break;
-            }
-            i = prev(iter)->first;
-        }
-        remainder.RemoveZeros();
-    }
-    Polynomial<ValueType> ansPoly(0);
-    for (const std::pair<size_t, ValueType>& j : ans) {
-        ansPoly.sequence[j.first] = j.second;
-    }
-    return ansPoly;
-}
-
-template<typename ValueType>
-Polynomial<ValueType> Polynomial<ValueType>::operator%(const Polynomial& other) const {
-    return *this - *this / other * other;
-}
-
-template<typename ValueType>
-Polynomial<ValueType> Polynomial<ValueType>::operator,(const Polynomial& other) const {
-    if (other.Degree() < 0) {
-        return *this / sequence.rbegin()->second;
-    }
-    return (other, *this % other);
-}
-
-template<typename ValueType>
-Polynomial<ValueType>::Polynomial(ValueType other) {
-    if (other != ValueType(0)) {
-        sequence[0] = other;
-    }
-}
-
-template<typename ValueType>
-Polynomial<ValueType> Polynomial<ValueType>::Pow(size_t power) const {
-    Polynomial<ValueType> ans(1), multiplier(*this);
-    while (power != 0) {
-        if (power & 1ULL) {
-            ans *= multiplier;
-        }
-        multiplier *= multiplier;
-        power >>= 1ULL;
-    }
-    return ans;
-}
-
-template<typename ValueType>
-Polynomial<ValueType> operator==(ValueType first, const Polynomial<ValueType>& second) {
-    return second == first;
-}
-
-template<typename ValueType>
-Polynomial<ValueType> operator!=(ValueType first, const Polynomial<ValueType>& second) {
-    return second != first;
-}
-
-template<typename ValueType>
-Polynomial<ValueType> operator+(ValueType first, const Polynomial<ValueType>& second) {
-    return second + first;
-}
-
-template<typename ValueType>
-Polynomial<ValueType> operator-(ValueType first, const Polynomial<ValueType>& second) {
-    return Polynomial<ValueType>(first) -= second;
-}
-
-template<typename ValueType>
-Polynomial<ValueType> operator*(ValueType first, const Polynomial<ValueType>& second) {
-    return second * first;
-}
-
-template<typename ValueType>
-Polynomial<ValueType> operator&(ValueType first, const Polynomial<ValueType>& second) {
-    return Polynomial<ValueType>(first) & second;
-}
-
-template<typename ValueType>
-Polynomial<ValueType> operator/(ValueType first, const Polynomial<ValueType>& second) {
-    return Polynomial<ValueType>(first) / second;
-}
-
-template<typename ValueType>
-Polynomial<ValueType> operator%(ValueType first, const Polynomial<ValueType>& second) {
-    return Polynomial<ValueType>(first) % second;
-}
-
-template<typename ValueType>
-ValueType abs(ValueType number) {
-    return (number < ValueType(0) ? ValueType(0) - number : number);
-}
-
-template<typename ValueType>
-Polynomial<ValueType> operator,(ValueType first, const Polynomial<ValueType>& other) {
-    return (Polynomial<ValueType>(first), other);
-}
-
-template<typename ValueType>
-std::ostream& operator<<(std::ostream& out, const Polynomial<ValueType>& poly) {
-    int64_t degree = poly.Degree();
-    if (degree == -1) {
-        out << '0';
-    } else {
-        auto it = poly.GetSequence().rbegin();
-        while (it != poly.GetSequence().rend()) {
-            if (it->second != ValueType(0)) {
-                if (it->second < ValueType(0)) {
-                    out << '-';
-                } else if (static_cast<int64_t>(it->first) != degree) {
-                    out << '+';
-                }
-                if (abs(it->second) != ValueType(1) || it->first == 0) {
-                    out << abs(it->second);
-                    if (it->first != 0) {
-                        out << '*';
-                    }
-                }
-                if (it->first != 0) {
-                    out << 'x';
-                }
-                if (it->first > 1) {
-                    out << "^" << it->first;
-                }
-            }
-            ++it;
-        }
-    }
-    return out;
-}
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "PolynomialMultiply.h"
+
+// Coefficients are kept in one of two forms, picked by density after every operation:
+// dense, a vector of all coefficients up to the degree, or sparse, the nonzero terms as
+// (power, coefficient) pairs sorted by power. A polynomial becomes dense once at least
+// 1 / kDenseFraction of its coefficients are nonzero and sparse again below 1 / kSparseFraction,
+// the gap keeps it from flipping back and forth. Either way there are no trailing zeros in the
+// dense form and no zero terms in the sparse one.
+
+// Walks the nonzero terms as (power, coefficient), in either direction. The term is kept in the
+// iterator, so references to it die with the iterator.
+template<typename ValueType>
+class PolynomialTermIterator {
+ public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<size_t, ValueType>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    // position is an index into dense or sparse, size for the end and kBeforeFirst before
+    // the first term
+    PolynomialTermIterator(const ValueType* dense, const value_type* sparse, size_t size, size_t position,
+                           bool reversed) :
+        dense(dense), sparse(sparse), size(size), position(position), reversed(reversed) {
+        SkipZeros(!reversed);
+    }
+
+    static constexpr size_t kBeforeFirst = static_cast<size_t>(-1);
+
+    reference operator*() const {
+        return term;
+    }
+
+    pointer operator->() const {
+        return &term;
+    }
+
+    PolynomialTermIterator& operator++() {
+        Step(!reversed);
+        return *this;
+    }
+
+    PolynomialTermIterator operator++(int) {
+        PolynomialTermIterator ans(*this);
+        ++*this;
+        return ans;
+    }
+
+    PolynomialTermIterator& operator--() {
+        Step(reversed);
+        return *this;
+    }
+
+    PolynomialTermIterator operator--(int) {
+        PolynomialTermIterator ans(*this);
+        --*this;
+        return ans;
+    }
+
+    bool operator==(const PolynomialTermIterator& other) const {
+        return position == other.position;
+    }
+
+    bool operator!=(const PolynomialTermIterator& other) const {
+        return position != other.position;
+    }
+
+ private:
+    void Step(bool up) {
+        position += up ? 1 : -1;
+        SkipZeros(up);
+    }
+
+    // Moves position to the closest term in the direction, then loads it
+    void SkipZeros(bool up) {
+        if (dense) {
+            while (position < size && dense[position] == ValueType(0)) {
+                position += up ? 1 : -1;
+            }
+        }
+        if (position < size) {
+            term = dense ? value_type(position, dense[position]) : sparse[position];
+        }
+    }
+
+    const ValueType* dense;
+    const value_type* sparse;
+    size_t size;
+    size_t position;
+    bool reversed;
+    value_type term;
+};
+
+template<typename ValueType>
+class Polynomial;
+
+template<typename ValueType>
+class PolynomialDivisor;
+
+// The nonzero terms of a polynomial by increasing power, rbegin/rend for decreasing
+template<typename ValueType>
+class PolynomialTerms {
+ public:
+    using const_iterator = PolynomialTermIterator<ValueType>;
+
+    explicit PolynomialTerms(const Polynomial<ValueType>& polynomial) : polynomial(polynomial) {}
+
+    const_iterator begin() const {
+        return polynomial.begin();
+    }
+
+    const_iterator end() const {
+        return polynomial.end();
+    }
+
+    const_iterator rbegin() const {
+        return polynomial.rbegin();
+    }
+
+    const_iterator rend() const {
+        return polynomial.rend();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return polynomial.Degree() == -1;
+    }
+
+ private:
+    const Polynomial<ValueType>& polynomial;
+};
+
+template<typename ValueType>
+class Polynomial {
+ public:
+    using const_iterator = PolynomialTermIterator<ValueType>;
+    using Term = std::pair<size_t, ValueType>;
+
+    static constexpr size_t kDenseFraction = 8;
+    static constexpr size_t kSparseFraction = 16;
+
+    // We should be able to create double polynomial from vector<int>
+    template<typename OtherValueType>
+    explicit Polynomial(const std::vector<OtherValueType>& other) :
+        Polynomial(other.begin(), other.end()) {}
+
+    // Haven't made it explicit for automatic conversions in operations
+    // Added enable_if for normal work of vector constructor and copy/move constructors
+    Polynomial(ValueType other = ValueType(0));
+
+    // Coefficients from the constant one up
+    template<typename OtherIter>
+    Polynomial(OtherIter first, OtherIter last);
+
+    // From (power, coefficient) pairs in any order, coefficients of equal powers are summed
+    static Polynomial FromTerms(std::vector<Term> terms);
+
+    PolynomialTerms<ValueType> GetSequence() const;
+
+    [[nodiscard]] bool IsDense() const {
+        return isDense;
+    }
+
+    bool operator==(const Polynomial& other) const;
+
+    bool operator!=(const Polynomial& other) const;
+
+    ValueType operator[](size_t i) const;
+
+    int64_t Degree() const;
+
+    const_iterator begin() const;
+
+    const_iterator end() const;
+
+    // Terms by decreasing power
+    const_iterator rbegin() const;
+
+    const_iterator rend() const;
+
+    Polynomial& operator+=(const Polynomial& other);
+
+    Polynomial& operator-=(const Polynomial& other);
+
+    Polynomial& operator*=(const Polynomial& other);
+
+    Polynomial operator+(const Polynomial& other) const;
+
+    Polynomial operator-(const Polynomial& other) const;
+
+    Polynomial operator*(const Polynomial& other) const;
+
+    ValueType operator()(ValueType other) const;
+
+    Polynomial operator&(const Polynomial& other) const;
+
+    Polynomial operator/(const Polynomial& other) const;
+
+    Polynomial operator%(const Polynomial& other) const;
+
+    // Quotient and remainder together; for many divisions by one polynomial keep a
+    // PolynomialDivisor instead
+    std::pair<Polynomial, Polynomial> DivMod(const Polynomial& other) const;
+
+    Polynomial operator,(const Polynomial& other) const;
+
+    Polynomial Pow(const size_t power) const;
+
+    // Drops zero coefficients and picks the form for the density
+    Polynomial& RemoveZeros();
+
+ private:
+    friend class PolynomialDivisor<ValueType>;
+
+    // Nonzero terms, at most; exact for the sparse form
+    [[nodiscard]] size_t TermCount() const {
+        return isDense ? dense.size() : sparse.size();
+    }
+
+    // Dense form with room for powers below size
+    void MakeDense(size_t size);
+
+    template<typename Operation>
+    Polynomial& Combine(const Polynomial& other, Operation operation);
+
+    std::vector<ValueType> dense;
+    std::vector<Term> sparse;
+    bool isDense = false;
+};
+
+template<typename ValueType>
+Polynomial<ValueType>::Polynomial(ValueType other) {
+    if (other != ValueType(0)) {
+        dense.push_back(other);
+        isDense = true;
+    }
+}
+
+template<typename ValueType>
+template<typename OtherIter>
+Polynomial<ValueType>::Polynomial(OtherIter first, OtherIter last) : isDense(true) {
+    for (; first != last; ++first) {
+        dense.push_back(static_cast<ValueType>(*first));
+    }
+    RemoveZeros();
+}
+
+template<typename ValueType>
+Polynomial<ValueType> Polynomial<ValueType>::FromTerms(std::vector<Term> terms) {
+    std::sort(terms.begin(), terms.end(), [](const Term& a, const Term& b) {
+        return a.first < b.first;
+    });
+    Polynomial ans;
+    for (const Term& term : terms) {
+        if (!ans.sparse.empty() && ans.sparse.back().first == term.first) {
+            ans.sparse.back().second += term.second;
+        } else {
+            ans.sparse.push_back(term);
+        }
+    }
+    return ans.RemoveZeros();
+}
+
+template<typename ValueType>
+Polynomial<ValueType>& Polynomial<ValueType>::RemoveZeros() {
+    if (isDense) {
+        while (!dense.empty() && dense.back() == ValueType(0)) {
+            dense.pop_back();
+        }
+        size_t count = dense.size() - std::count(dense.begin(), dense.end(), ValueType(0));
+        if (count * kSparseFraction < dense.size()) {
+            sparse.clear();
+            for (size_t i = 0; i != dense.size(); ++i) {
+                if (dense[i] != ValueType(0)) {
+                    sparse.emplace_back(i, dense[i]);
+                }
+            }
+            dense = std::vector<ValueType>();
+            isDense = false;
+        }
+        return *this;
+    }
+    sparse.erase(std::remove_if(sparse.begin(), sparse.end(), [](const Term& term) {
+        return term.second == ValueType(0);
+    }), sparse.end());
+    if (!sparse.empty() && sparse.size() * kDenseFraction >= sparse.back().first + 1) {
+        MakeDense(sparse.back().first + 1);
+    }
+    return *this;
+}
+
+template<typename ValueType>
+void Polynomial<ValueType>::MakeDense(size_t size) {
+    if (!isDense) {
+        dense.assign(std::max(size, sparse.empty() ? 0 : sparse.back().first + 1), ValueType(0));
+        for (const Term& term : sparse) {
+            dense[term.first] = term.second;
+        }
+        sparse = std::vector<Term>();
+        isDense = true;
+    } else if (dense.size() < size) {
+        dense.resize(size, ValueType(0));
+    }
+}
+
+template<typename ValueType>
+PolynomialTerms<ValueType> Polynomial<ValueType>::GetSequence() const {
+    return PolynomialTerms<ValueType>(*this);
+}
+
+template<typename ValueType>
+bool Polynomial<ValueType>::operator==(const Polynomial<ValueType>& other) const {
+    if (Degree() != other.Degree()) {
+        return false;
+    }
+    if (isDense && other.isDense) {
+        return dense == other.dense;
+    }
+    auto itOther = other.begin();
+    for (auto it = begin(); it != end(); ++it, ++itOther) {
+        if (itOther == other.end() || *it != *itOther) {
+            return false;
+        }
+    }
+    return itOther == other.end();
+}
+
+template<typename ValueType>
+bool Polynomial<ValueType>::operator!=(const Polynomial<ValueType>& other) const {
+    return !(*this == other);
+}
+
+template<typename ValueType>
+ValueType Polynomial<ValueType>::operator[](size_t i) const {
+    if (isDense) {
+        return i < dense.size() ? dense[i] : ValueType(0);
+    }
+    auto it = std::lower_bound(sparse.begin(), sparse.end(), i, [](const Term& term, size_t power) {
+        return term.first < power;
+    });
+    return it == sparse.end() || it->first != i ? ValueType(0) : it->second;
+}
+
+template<typename ValueType>
+int64_t Polynomial<ValueType>::Degree() const {
+    if (isDense) {
+        return static_cast<int64_t>(dense.size()) - 1;
+    }
+    return sparse.empty() ? -1 : static_cast<int64_t>(sparse.back().first);
+}
+
+template<typename ValueType>
+typename Polynomial<ValueType>::const_iterator Polynomial<ValueType>::begin() const {
+    return const_iterator(isDense ? dense.data() : nullptr, sparse.data(), TermCount(), 0, false);
+}
+
+template<typename ValueType>
+typename Polynomial<ValueType>::const_iterator Polynomial<ValueType>::end() const {
+    return const_iterator(isDense ? dense.data() : nullptr, sparse.data(), TermCount(), TermCount(), false);
+}
+
+template<typename ValueType>
+typename Polynomial<ValueType>::const_iterator Polynomial<ValueType>::rbegin() const {
+    return const_iterator(isDense ? dense.data() : nullptr, sparse.data(), TermCount(), TermCount() - 1, true);
+}
+
+template<typename ValueType>
+typename Polynomial<ValueType>::const_iterator Polynomial<ValueType>::rend() const {
+    return const_iterator(isDense ? dense.data() : nullptr, sparse.data(), TermCount(),
+                          const_iterator::kBeforeFirst, true);
+}
+
+// Applies this[p] = operation(this[p], other[p]) for every power other has. Goes dense when the
+// result would be, otherwise merges the two term lists.
+template<typename ValueType>
+template<typename Operation>
+Polynomial<ValueType>& Polynomial<ValueType>::Combine(const Polynomial& other, Operation operation) {
+    if (other.Degree() == -1) {
+        return *this;
+    }
+    size_t size = static_cast<size_t>(std::max(Degree(), other.Degree())) + 1;
+    if ((isDense || other.isDense) && (TermCount() + other.TermCount()) * kDenseFraction >= size) {
+        MakeDense(size);
+        if (other.isDense) {
+            for (size_t i = 0; i != other.dense.size(); ++i) {
+                dense[i] = operation(dense[i], other.dense[i]);
+            }
+        } else {
+            for (const Term& term : other.sparse) {
+                dense[term.first] = operation(dense[term.first], term.second);
+            }
+        }
+        return RemoveZeros();
+    }
+    std::vector<Term> merged;
+    merged.reserve(TermCount() + other.TermCount());
+    auto it = begin(), itOther = other.begin();
+    while (it != end() || itOther != other.end()) {
+        if (itOther == other.end() || (it != end() && it->first < itOther->first)) {
+            merged.push_back(*it++);
+        } else if (it == end() || itOther->first < it->first) {
+            merged.emplace_back(itOther->first, operation(ValueType(0), itOther->second));
+            ++itOther;
+        } else {
+            merged.emplace_back(it->first, operation(it->second, itOther->second));
+            ++it;
+            ++itOther;
+        }
+    }
+    sparse = std::move(merged);
+    dense = std::vector<ValueType>();
+    isDense = false;
+    return RemoveZeros();
+}
+
+template<typename ValueType>
+Polynomial<ValueType>& Polynomial<ValueType>::operator+=(const Polynomial<ValueType>& other) {
+    return Combine(other, [](const ValueType& a, const ValueType& b) { return a + b; });
+}
+
+template<typename ValueType>
+Polynomial<ValueType>& Polynomial<ValueType>::operator-=(const Polynomial<ValueType>& other) {
+    return Combine(other, [](const ValueType& a, const ValueType& b) { return a - b; });
+}
+
+template<typename ValueType>
+Polynomial<ValueType>& Polynomial<ValueType>::operator*=(const Polynomial<ValueType>& other) {
+    *this = *this * other;
+    return *this;
+}
+
+template<typename ValueType>
+Polynomial<ValueType> Polynomial<ValueType>::operator+(const Polynomial<ValueType>& other) const {
+    return Polynomial(*this) += other;
+}
+
+template<typename ValueType>
+Polynomial<ValueType> Polynomial<ValueType>::operator-(const Polynomial<ValueType>& other) const {
+    return Polynomial(*this) -= other;
+}
+
+// Dense operands go to MultiplyCoefficients (NTT, FFT or Karatsuba by type). Otherwise the
+// products of all term pairs are summed into an array when they would fill the result densely
+// enough, or sorted and merged.
+template<typename ValueType>
+Polynomial<ValueType> Polynomial<ValueType>::operator*(const Polynomial<ValueType>& other) const {
+    if (Degree() == -1 || other.Degree() == -1) {
+        return Polynomial();
+    }
+    size_t size = static_cast<size_t>(Degree() + other.Degree()) + 1;
+    Polynomial<ValueType> ans;
+    if (isDense && other.isDense) {
+        ans.dense = MultiplyCoefficients(dense, this == &other ? dense : other.dense);
+        ans.isDense = true;
+        return ans.RemoveZeros();
+    }
+    if (TermCount() * other.TermCount() >= size / kDenseFraction) {
+        ans.dense.assign(size, ValueType(0));
+        for (const Term& i : *this) {
+            for (const Term& j : other) {
+                ans.dense[i.first + j.first] += i.second * j.second;
+            }
+        }
+        ans.isDense = true;
+        return ans.RemoveZeros();
+    }
+    std::vector<Term> terms;
+    terms.reserve(TermCount() * other.TermCount());
+    for (const Term& i : *this) {
+        for (const Term& j : other) {
+            terms.emplace_back(i.first + j.first, i.second * j.second);
+        }
+    }
+    return FromTerms(std::move(terms));
+}
+
+template<typename ValueType>
+Polynomial<ValueType> Polynomial<ValueType>::operator&(const Polynomial& other) const {
+    Polynomial<ValueType> ans = ValueType(0);
+    for (const auto& i : *this) {
+        ans += other.Pow(i.first) * i.second;
+    }
+    return ans;
+}
+
+template<typename ValueType>
+ValueType Polynomial<ValueType>::operator()(const ValueType other) const {
+    return (*this & other)[0];
+}
+
+template<typename ValueType>
+Polynomial<ValueType> Polynomial<ValueType>::operator/(const Polynomial& other) const {
+    return DivMod(other).first;
+}
+
+template<typename ValueType>
+Polynomial<ValueType> Polynomial<ValueType>::operator%(const Polynomial& other) const {
+    return DivMod(other).second;
+}
+
+template<typename ValueType>
+std::pair<Polynomial<ValueType>, Polynomial<ValueType>> Polynomial<ValueType>::DivMod(const Polynomial& other) const {
+    return PolynomialDivisor<ValueType>(other).DivMod(*this);
+}
+
+template<typename ValueType>
+Polynomial<ValueType> Polynomial<ValueType>::operator,(const Polynomial& other) const {
+    if (other.Degree() < 0) {
+        return *this / rbegin()->second;
+    }
+    return (other, *this % other);
+}
+
+template<typename ValueType>
+Polynomial<ValueType> Polynomial<ValueType>::Pow(size_t power) const {
+    Polynomial<ValueType> ans(1), multiplier(*this);
+    while (power != 0) {
+        if (power & 1ULL) {
+            ans *= multiplier;
+        }
+        multiplier *= multiplier;
+        power >>= 1ULL;
+    }
+    return ans;
+}
+
+// Division by a fixed polynomial b of degree m. For exact coefficients (integers and
+// ModularInteger) a dense dividend a of degree n, with quotient and divisor both at least
+// kNewtonDivisionLimit long, is divided through power series: with
+// rev(p) the coefficients of p reversed,
+//     rev(q) = rev(a) / rev(b) mod x^(n - m + 1),    r = (a - b * q) mod x^m,
+// where 1 / rev(b) comes from Newton's iteration g <- g * (2 - rev(b) * g), doubling the number
+// of correct terms each step. That is a few products through MultiplyCoefficients, O(M(n)).
+// The inverse is kept between calls and only extended when a longer quotient needs more terms,
+// so reducing many polynomials modulo b pays for it once. Other cases use long division; for
+// floating point the series inverse grows without bound and the quotient is lost to rounding.
+//
+// Series inversion needs the leading coefficient of b to be invertible: nonzero modulo a prime,
+// 1 or -1 for integer types. Integer division by other leading coefficients
+// truncates every quotient coefficient, as the long division always did; then
+// a = b * q + r still holds, but r may keep terms of degree m and above.
+template<typename ValueType>
+class PolynomialDivisor {
+ public:
+    static constexpr size_t kNewtonDivisionLimit = 128;
+    static constexpr bool kExactCoefficients = std::is_integral_v<ValueType> || IsModularInteger<ValueType>::value;
+
+    explicit PolynomialDivisor(Polynomial<ValueType> divisor);
+
+    const Polynomial<ValueType>& Divisor() const {
+        return divisor;
+    }
+
+    // (quotient, remainder); division by zero gives (0, dividend)
+    std::pair<Polynomial<ValueType>, Polynomial<ValueType>> DivMod(const Polynomial<ValueType>& dividend);
+
+    Polynomial<ValueType> Quotient(const Polynomial<ValueType>& dividend) {
+        return DivMod(dividend).first;
+    }
+
+    Polynomial<ValueType> Remainder(const Polynomial<ValueType>& dividend) {
+        return DivMod(dividend).second;
+    }
+
+ private:
+    using Term = typename Polynomial<ValueType>::Term;
+
+    static bool Invertible(ValueType value);
+
+    // inverse has at least size terms of 1 / rev(b)
+    void ExtendInverse(size_t size);
+
+    std::pair<Polynomial<ValueType>, Polynomial<ValueType>> NewtonDivide(const Polynomial<ValueType>& dividend);
+
+    std::pair<Polynomial<ValueType>, Polynomial<ValueType>> LongDivide(const Polynomial<ValueType>& dividend) const;
+
+    Polynomial<ValueType> divisor;
+    // Coefficients of b and of rev(b), empty for b = 0
+    std::vector<ValueType> coefficients;
+    std::vector<ValueType> reversed;
+    std::vector<ValueType> inverse;
+};
+
+template<typename ValueType>
+PolynomialDivisor<ValueType>::PolynomialDivisor(Polynomial<ValueType> divisor) : divisor(std::move(divisor)) {
+    if (this->divisor.Degree() != -1) {
+        coefficients.assign(static_cast<size_t>(this->divisor.Degree()) + 1, ValueType(0));
+        for (const Term& term : this->divisor) {
+            coefficients[term.first] = term.second;
+        }
+        reversed.assign(coefficients.rbegin(), coefficients.rend());
+    }
+}
+
+template<typename ValueType>
+bool PolynomialDivisor<ValueType>::Invertible(ValueType value) {
+    if constexpr (std::is_integral_v<ValueType>) {
+        if constexpr (std::is_signed_v<ValueType>) {
+            return value == ValueType(1) || value == ValueType(-1);
+        } else {
+            return value == ValueType(1);
+        }
+    } else {
+        return kExactCoefficients && value != ValueType(0);
+    }
+}
+
+template<typename ValueType>
+std::pair<Polynomial<ValueType>, Polynomial<ValueType>> PolynomialDivisor<ValueType>::DivMod(
+        const Polynomial<ValueType>& dividend) {
+    int64_t degree = dividend.Degree(), divisorDegree = divisor.Degree();
+    if (degree == -1 || divisorDegree == -1 || degree < divisorDegree) {
+        return {Polynomial<ValueType>(), dividend};
+    }
+    if constexpr (kExactCoefficients) {
+        size_t quotientSize = static_cast<size_t>(degree - divisorDegree) + 1;
+        if (dividend.isDense && Invertible(reversed[0]) &&
+            std::min(quotientSize, static_cast<size_t>(divisorDegree)) >= kNewtonDivisionLimit) {
+            return NewtonDivide(dividend);
+        }
+    }
+    return LongDivide(dividend);
+}
+
+template<typename ValueType>
+void PolynomialDivisor<ValueType>::ExtendInverse(size_t size) {
+    if (inverse.empty()) {
+        // A unit integer is its own inverse
+        if constexpr (std::is_integral_v<ValueType>) {
+            inverse.push_back(reversed[0]);
+        } else {
+            inverse.push_back(ValueType(1) / reversed[0]);
+        }
+    }
+    while (inverse.size() < size) {
+        size_t length = std::min(2 * inverse.size(), size);
+        std::vector<ValueType> head(reversed.begin(), reversed.begin() + std::min(length, reversed.size()));
+        // error = 2 - rev(b) * g, then g * error, both mod x^length
+        std::vector<ValueType> error = MultiplyCoefficients(head, inverse);
+        error.resize(length, ValueType(0));
+        for (ValueType& value : error) {
+            value = ValueType(0) - value;
+        }
+        error[0] += ValueType(2);
+        inverse = MultiplyCoefficients(inverse, error);
+        inverse.resize(length);
+    }
+}
+
+template<typename ValueType>
+std::pair<Polynomial<ValueType>, Polynomial<ValueType>> PolynomialDivisor<ValueType>::NewtonDivide(
+        const Polynomial<ValueType>& dividend) {
+    const std::vector<ValueType>& a = dividend.dense;
+    size_t shift = coefficients.size() - 1;
+    size_t quotientSize = a.size() - shift;
+    ExtendInverse(quotientSize);
+
+    std::vector<ValueType> reversedDividend(a.rbegin(), a.rbegin() + quotientSize);
+    std::vector<ValueType> quotient = inverse.size() == quotientSize ?
+        MultiplyCoefficients(reversedDividend, inverse) :
+        MultiplyCoefficients(reversedDividend, std::vector<ValueType>(inverse.begin(), inverse.begin() + quotientSize));
+    quotient.resize(quotientSize);
+    std::reverse(quotient.begin(), quotient.end());
+
+    // Only the terms below x^shift of b * q are needed
+    std::vector<ValueType> low(coefficients.begin(), coefficients.begin() + shift);
+    std::vector<ValueType> product = quotient.size() > shift ?
+        MultiplyCoefficients(low, std::vector<ValueType>(quotient.begin(), quotient.begin() + shift)) :
+        MultiplyCoefficients(low, quotient);
+    product.resize(shift, ValueType(0));
+    for (size_t i = 0; i != shift; ++i) {
+        product[i] = a[i] - product[i];
+    }
+    return {Polynomial<ValueType>(quotient.begin(), quotient.end()),
+            Polynomial<ValueType>(product.begin(), product.end())};
+}
+
+// A dense dividend is reduced in a coefficient array, a sparse one in a map holding only the
+// nonzero terms of the remainder
+template<typename ValueType>
+std::pair<Polynomial<ValueType>, Polynomial<ValueType>> PolynomialDivisor<ValueType>::LongDivide(
+        const Polynomial<ValueType>& dividend) const {
+    std::vector<Term> terms(divisor.begin(), divisor.end());
+    ValueType lead = terms.back().second;
+    terms.pop_back();
+    size_t shift = coefficients.size() - 1;
+    // What division leaves of a leading coefficient, only integer truncation leaves anything
+    auto leftover = [lead](ValueType value, ValueType quotient) {
+        return std::is_integral_v<ValueType> ? value - quotient * lead : ValueType(0);
+    };
+
+    if (dividend.isDense) {
+        std::vector<ValueType> remainder(dividend.dense);
+        std::vector<ValueType> quotient(remainder.size() - shift);
+        for (size_t i = quotient.size(); i-- != 0;) {
+            ValueType& top = remainder[i + shift];
+            if (top == ValueType(0)) {
+                continue;
+            }
+            quotient[i] = top / lead;
+            for (const Term& term : terms) {
+                remainder[i + term.first] -= term.second * quotient[i];
+            }
+            top = leftover(top, quotient[i]);
+        }
+        return {Polynomial<ValueType>(quotient.begin(), quotient.end()),
+                Polynomial<ValueType>(remainder.begin(), remainder.end())};
+    }
+
+    std::vector<Term> quotient, leftovers;
+    std::map<size_t, ValueType> remainder(dividend.sparse.begin(), dividend.sparse.end());
+    while (!remainder.empty() && std::prev(remainder.end())->first >= shift) {
+        auto top = std::prev(remainder.end());
+        size_t power = top->first - shift;
+        ValueType coefficient = top->second / lead;
+        leftovers.emplace_back(top->first, leftover(top->second, coefficient));
+        remainder.erase(top);
+        quotient.emplace_back(power, coefficient);
+        for (const Term& term : terms) {
+            auto it = remainder.emplace(power + term.first, ValueType(0)).first;
+            it->second -= term.second * coefficient;
+            if (it->second == ValueType(0)) {
+                remainder.erase(it);
+            }
+        }
+    }
+    leftovers.insert(leftovers.end(), remainder.begin(), remainder.end());
+    return {Polynomial<ValueType>::FromTerms(std::move(quotient)),
+            Polynomial<ValueType>::FromTerms(std::move(leftovers))};
+}
+
+template<typename ValueType>
+Polynomial<ValueType> operator==(ValueType first, const Polynomial<ValueType>& second) {
+    return second == first;
+}
+
+template<typename ValueType>
+Polynomial<ValueType> operator!=(ValueType first, const Polynomial<ValueType>& second) {
+    return second != first;
+}
+
+template<typename ValueType>
+Polynomial<ValueType> operator+(ValueType first, const Polynomial<ValueType>& second) {
+    return second + first;
+}
+
+template<typename ValueType>
+Polynomial<ValueType> operator-(ValueType first, const Polynomial<ValueType>& second) {
+    return Polynomial<ValueType>(first) -= second;
+}
+
+template<typename ValueType>
+Polynomial<ValueType> operator*(ValueType first, const Polynomial<ValueType>& second) {
+    return second * first;
+}
+
+template<typename ValueType>
+Polynomial<ValueType> operator&(ValueType first, const Polynomial<ValueType>& second) {
+    return Polynomial<ValueType>(first) & second;
+}
+
+template<typename ValueType>
+Polynomial<ValueType> operator/(ValueType first, const Polynomial<ValueType>& second) {
+    return Polynomial<ValueType>(first) / second;
+}
+
+template<typename ValueType>
+Polynomial<ValueType> operator%(ValueType first, const Polynomial<ValueType>& second) {
+    return Polynomial<ValueType>(first) % second;
+}
+
+template<typename ValueType>
+ValueType abs(ValueType number) {
+    return (number < ValueType(0) ? ValueType(0) - number : number);
+}
+
+template<typename ValueType>
+Polynomial<ValueType> operator,(ValueType first, const Polynomial<ValueType>& other) {
+    return (Polynomial<ValueType>(first), other);
+}
+
+template<typename ValueType>
+std::ostream& operator<<(std::ostream& out, const Polynomial<ValueType>& poly) {
+    int64_t degree = poly.Degree();
+    if (degree == -1) {
+        out << '0';
+    } else {
+        auto it = poly.GetSequence().rbegin();
+        while (it != poly.GetSequence().rend()) {
+            if (it->second != ValueType(0)) {
+                if (it->second < ValueType(0)) {
+                    out << '-';
+                } else if (static_cast<int64_t>(it->first) != degree) {
+                    out << '+';
+                }
+                if (abs(it->second) != ValueType(1) || it->first == 0) {
+                    out << abs(it->second);
+                    if (it->first != 0) {
+                        out << '*';
+                    }
+                }
+                if (it->first != 0) {
+                    out << 'x';
+                }
+                if (it->first > 1) {
+                    out << "^" << it->first;
+                }
+            }
+            ++it;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Polynomial.h"
+
+// Usage: PolynomialBenchmark [degrees...] [--threads=N]
+// Times the product of two dense polynomials of each degree with coefficients modulo 998244353
+// (one NTT), small and full-width int64_t (three-prime NTT), double (FFT) and long double
+// (Karatsuba, skipped above degree 1e5), then DivMod of a degree 2n polynomial by a monic degree n
+// one modulo 998244353 (Newton iteration) and in double (long division, skipped above degree 1e4,
+// with the residual b * q + r - a checked).
+
+template<typename ValueType, typename Generator>
+double TimeProduct(size_t degree, Generator generate) {
+    std::vector<ValueType> first(degree + 1), second(degree + 1);
+    for (size_t i = 0; i <= degree; ++i) {
+        first[i] = generate();
+        second[i] = generate();
+    }
+    Polynomial<ValueType> a(first), b(second);
+    Polynomial<ValueType> product;
+    double ans = Seconds([&] { product = a * b; });
+    if (product.Degree() != static_cast<int64_t>(2 * degree)) {
+        std::cerr << "Unexpected degree " << product.Degree() << '\n';
+    }
+    return ans;
+}
+
+template<typename ValueType, typename Generator>
+double TimeDivision(size_t degree, Generator generate) {
+    std::vector<ValueType> dividend(2 * degree + 1), divisor(degree + 1);
+    for (ValueType& value : dividend) {
+        value = generate();
+    }
+    for (ValueType& value : divisor) {
+        value = generate();
+        if constexpr (std::is_floating_point_v<ValueType>) {
+            // Lower terms summing below 1/2 keep 1 / rev(b) decaying, so the quotient stays in range
+            value /= static_cast<ValueType>(2 * (degree + 1));
+        }
+    }
+    divisor.back() = ValueType(1);
+    Polynomial<ValueType> a(dividend), b(divisor);
+    std::pair<Polynomial<ValueType>, Polynomial<ValueType>> ans;
+    double seconds = Seconds([&] { ans = a.DivMod(b); });
+    if (ans.first.Degree() != static_cast<int64_t>(degree) || ans.second.Degree() >= b.Degree()) {
+        std::cerr << "Unexpected degrees " << ans.first.Degree() << ' ' << ans.second.Degree() << '\n';
+    }
+    if constexpr (std::is_floating_point_v<ValueType>) {
+        // Coefficients of a are at most 1 in magnitude; NaN fails the comparison as well
+        ValueType error = 0;
+        for (const auto& term : ans.first * b + ans.second - a) {
+            error = std::max(error, std::abs(term.second));
+        }
+        if (!(error <= 1e-9)) {
+            std::cerr << "DivMod residual " << error << '\n';
+        }
+    }
+    return seconds;
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> degrees;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--threads=", 0) == 0) {
+            ThreadPool::Instance().SetThreadCount(std::stoul(arg.substr(10)));
+        } else {
+            degrees.push_back(std::stoul(arg));
+        }
+    }
+    if (degrees.empty()) {
+        degrees = {100, 1000, 10000, 100000, 1000000};
+    }
+
+    std::mt19937_64 rng(42);
+    using Residue = ModularInteger<998244353>;
+    std::cout << std::setw(9) << "degree" << std::setw(12) << "mod p s" << std::setw(12) << "int64 s"
+              << std::setw(12) << "wide s" << std::setw(12) << "double s" << std::setw(12) << "long dbl s"
+              << std::setw(12) << "divmod s"
+              << std::setw(12) << "div dbl s" << '\n';
+    // Nonzero in [-1, 1]
+    auto signedUnit = [&] { return (rng() % 1000 + 1) / (rng() % 2 ? 1000.0 : -1000.0); };
+    for (size_t degree : degrees) {
+        // Nonzero leading coefficients keep the degree, and with it the dense form
+        double modular = TimeProduct<Residue>(degree, [&] { return Residue(rng() % 998244352 + 1); });
+        double small = TimeProduct<int64_t>(degree, [&] { return static_cast<int64_t>(rng() % 2000000) + 1; });
+        double wide = TimeProduct<int64_t>(degree, [&] { return static_cast<int64_t>(rng() | 1); });
+        double floating = TimeProduct<double>(degree, [&] { return (rng() % 1000 + 1) / 1000.0; });
+        std::cout << std::setw(9) << degree << std::fixed << std::setprecision(4) << std::setw(12) << modular
+                  << std::setw(12) << small << std::setw(12) << wide << std::setw(12) << floating;
+        if (degree <= 100000) {
+            std::cout << std::setw(12)
+                      << TimeProduct<long double>(degree, [&] { return (rng() % 1000 + 1) / 1000.0L; });
+        } else {
+            std::cout << std::setw(12) << "-";
+        }
+        std::cout << std::setw(12) << TimeDivision<Residue>(degree, [&] { return Residue(rng() % 998244352 + 1); });
+        if (degree <= 10000) {
+            std::cout << std::setw(12) << TimeDivision<double>(degree, signedUnit);
+        } else {
+            std::cout << std::setw(12) << "-";
+        }
+        std::cout << '\n';
+    }
+}
@@ -0,0 +1,661 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+#include "ComplexNumbers.h"
+#include "Exceptions.h"
+#include "ThreadPool.h"
+
+// Products of coefficient arrays, the dense case of Polynomial::operator*.
+// MultiplyCoefficients picks by coefficient type:
+//     ModularInteger<P>  NTT modulo P when P - 1 has a large enough power of two, three-prime NTT otherwise
+//     integers           NTT modulo three primes near 2^30, put together with CRT; exact modulo 2^64,
+//                        coefficients are split into pieces when the result could exceed the primes
+//     float, double      complex FFT in double, both operands packed into one transform
+//     anything else      Karatsuba
+// by the length of the shorter operand: schoolbook below kSchoolbookLimit, Karatsuba up to the
+// transform's limit. Limits are where the transform overtook Karatsuba on one core.
+
+constexpr size_t kSchoolbookLimit = 64;
+// Karatsuba halves stop here
+constexpr size_t kKaratsubaLimit = 32;
+constexpr size_t kNttLimit = 64;
+constexpr size_t kModularCrtLimit = 256;
+constexpr size_t kIntegerCrtLimit = 2048;
+constexpr size_t kFourierLimit = 128;
+
+constexpr uint64_t PowerMod(uint64_t base, uint64_t power, uint64_t modulus) {
+    uint64_t ans = 1 % modulus;
+    base %= modulus;
+    while (power != 0) {
+        if (power & 1) {
+            ans = ans * base % modulus;
+        }
+        base = base * base % modulus;
+        power >>= 1;
+    }
+    return ans;
+}
+
+// Smallest generator of the multiplicative group of a prime
+constexpr uint32_t PrimitiveRoot(uint32_t prime) {
+    uint32_t factors[32] = {};
+    size_t count = 0;
+    uint32_t rest = prime - 1;
+    for (uint32_t divisor = 2; divisor * divisor <= rest; ++divisor) {
+        if (rest % divisor == 0) {
+            factors[count++] = divisor;
+            while (rest % divisor == 0) {
+                rest /= divisor;
+            }
+        }
+    }
+    if (rest > 1) {
+        factors[count++] = rest;
+    }
+    for (uint32_t root = 2;; ++root) {
+        bool generator = true;
+        for (size_t i = 0; i != count && generator; ++i) {
+            generator = PowerMod(root, (prime - 1) / factors[i], prime) != 1;
+        }
+        if (generator) {
+            return root;
+        }
+    }
+}
+
+inline size_t TransformSize(size_t resultSize) {
+    size_t ans = 1;
+    while (ans < resultSize) {
+        ans <<= 1;
+    }
+    return ans;
+}
+
+// Residue modulo a prime below 2^30, kept reduced
+template<uint32_t Modulus>
+class ModularInteger {
+ public:
+    static_assert(Modulus >= 2 && Modulus < (1u << 30), "Modulus has to be a prime below 2^30");
+
+    static constexpr uint32_t kModulus = Modulus;
+
+    ModularInteger(int64_t value = 0) :
+        value(static_cast<uint32_t>(value >= 0 ? value % Modulus : Modulus - (-(value + 1) % Modulus) - 1)) {}
+
+    static ModularInteger FromResidue(uint32_t residue) {
+        ModularInteger ans;
+        ans.value = residue;
+        return ans;
+    }
+
+    [[nodiscard]] uint32_t Value() const {
+        return value;
+    }
+
+    ModularInteger& operator+=(ModularInteger other) {
+        value += other.value;
+        value -= value >= Modulus ? Modulus : 0;
+        return *this;
+    }
+
+    ModularInteger& operator-=(ModularInteger other) {
+        value += value < other.value ? Modulus - other.value : -other.value;
+        return *this;
+    }
+
+    ModularInteger& operator*=(ModularInteger other) {
+        value = static_cast<uint32_t>(static_cast<uint64_t>(value) * other.value % Modulus);
+        return *this;
+    }
+
+    // Through Fermat's little theorem, so only for prime moduli
+    ModularInteger& operator/=(ModularInteger other) {
+        return *this *= FromResidue(static_cast<uint32_t>(PowerMod(other.value, Modulus - 2,
+                                                                                      Modulus)));
+    }
+
+    ModularInteger operator-() const {
+        return FromResidue(value == 0 ? 0 : Modulus - value);
+    }
+
+    friend ModularInteger operator+(ModularInteger first, ModularInteger second) {
+        return first += second;
+    }
+
+    friend ModularInteger operator-(ModularInteger first, ModularInteger second) {
+        return first -= second;
+    }
+
+    friend ModularInteger operator*(ModularInteger first, ModularInteger second) {
+        return first *= second;
+    }
+
+    friend ModularInteger operator/(ModularInteger first, ModularInteger second) {
+        return first /= second;
+    }
+
+    friend bool operator==(ModularInteger first, ModularInteger second) {
+        return first.value == second.value;
+    }
+
+    friend bool operator!=(ModularInteger first, ModularInteger second) {
+        return first.value != second.value;
+    }
+
+    // By residue, only so that residues can be printed and sorted
+    friend bool operator<(ModularInteger first, ModularInteger second) {
+        return first.value < second.value;
+    }
+
+    friend std::ostream& operator<<(std::ostream& out, ModularInteger number) {
+        return out << number.value;
+    }
+
+ private:
+    uint32_t value = 0;
+};
+
+template<typename ValueType>
+struct IsModularInteger : std::false_type {};
+
+template<uint32_t Modulus>
+struct IsModularInteger<ModularInteger<Modulus>> : std::true_type {};
+
+// Cyclic convolutions modulo an odd prime below 2^30, in Montgomery form (R = 2^32).
+// Forward is decimation in frequency and leaves the spectrum in bit-reversed order, Inverse
+// is decimation in time and takes it back from there, so neither needs a permutation.
+// Butterflies reduce lazily: Forward keeps values below 2p, Inverse takes them below 2p and
+// returns them below 4p, which still fits 32 bits as p < 2^30.
+template<uint32_t Modulus>
+class NumberTheoreticTransform {
+ public:
+    static_assert(Modulus % 2 == 1 && Modulus < (1u << 30), "Modulus has to be an odd prime below 2^30");
+
+    // Largest power of two dividing Modulus - 1, the longest transform there is
+    static constexpr size_t kMaxSize = static_cast<size_t>(Modulus - 1) & -static_cast<size_t>(Modulus - 1);
+
+    static uint32_t ToMontgomery(uint32_t residue) {
+        return Multiply(residue, kR2);
+    }
+
+    static uint32_t Reduce(uint64_t value) {
+        uint32_t factor = static_cast<uint32_t>(value) * kNegatedInverse;
+        uint32_t ans = static_cast<uint32_t>((value + static_cast<uint64_t>(factor) * Modulus) >> 32);
+        return ans >= Modulus ? ans - Modulus : ans;
+    }
+
+    static uint32_t Multiply(uint32_t first, uint32_t second) {
+        return Reduce(static_cast<uint64_t>(first) * second);
+    }
+
+    // Below 2p, for value < p * 2^32
+    static uint32_t ReduceLazy(uint64_t value) {
+        uint32_t factor = static_cast<uint32_t>(value) * kNegatedInverse;
+        return static_cast<uint32_t>((value + static_cast<uint64_t>(factor) * Modulus) >> 32);
+    }
+
+    // roots[half + j] = w^j for the 2 * half-th root of unity w (or its inverse), half = 1, 2, 4, .., size / 2
+    static std::vector<uint32_t> Roots(size_t size, bool inverse);
+
+    static void Forward(uint32_t* data, size_t size, const uint32_t* roots);
+
+    // Without the division by size
+    static void Inverse(uint32_t* data, size_t size, const uint32_t* roots);
+
+    // Residue of an integer, negative ones included
+    template<typename Value>
+    static uint32_t Residue(Value value) {
+        if constexpr (std::is_signed_v<Value>) {
+            int64_t residue = static_cast<int64_t>(value) % static_cast<int64_t>(Modulus);
+            return static_cast<uint32_t>(residue < 0 ? residue + Modulus : residue);
+        } else {
+            return static_cast<uint32_t>(static_cast<uint64_t>(value) % Modulus);
+        }
+    }
+
+    // Residues of ans[k] = sum over i + j = k of first[i] * second[j] for k < count, the first
+    // resultSize coefficients of each. first and second are lists of coefficient arrays (pieces
+    // of the operands), second == nullptr squares first.
+    template<typename Value>
+    static std::vector<std::vector<uint32_t>> Convolve(const std::vector<std::vector<Value>>& first,
+                                                       const std::vector<std::vector<Value>>* second,
+                                                       size_t resultSize, size_t count);
+
+ private:
+    static constexpr uint32_t NegatedInverse() {
+        uint32_t inverse = Modulus;
+        for (int i = 0; i != 4; ++i) {
+            inverse *= 2 - Modulus * inverse;
+        }
+        return -inverse;
+    }
+
+    static constexpr uint32_t kNegatedInverse = NegatedInverse();
+    static constexpr uint32_t kR2 = static_cast<uint32_t>((static_cast<unsigned __int128>(1) << 64) % Modulus);
+    static constexpr uint32_t kRoot = PrimitiveRoot(Modulus);
+};
+
+template<uint32_t Modulus>
+std::vector<uint32_t> NumberTheoreticTransform<Modulus>::Roots(size_t size, bool inverse) {
+    std::vector<uint32_t> roots(std::max<size_t>(size, 2));
+    size_t half = size / 2;
+    if (half != 0) {
+        uint64_t power = (Modulus - 1) / size;
+        uint32_t root = static_cast<uint32_t>(PowerMod(kRoot, inverse ? Modulus - 1 - power : power,
+                                                                          Modulus));
+        root = ToMontgomery(root);
+        roots[half] = ToMontgomery(1);
+        for (size_t j = 1; j != half; ++j) {
+            roots[half + j] = Multiply(roots[half + j - 1], root);
+        }
+        for (size_t level = half / 2; level != 0; level /= 2) {
+            for (size_t j = 0; j != level; ++j) {
+                roots[level + j] = roots[2 * (level + j)];
+            }
+        }
+    }
+    return roots;
+}
+
+template<uint32_t Modulus>
+void NumberTheoreticTransform<Modulus>::Forward(uint32_t* data, size_t size, const uint32_t* roots) {
+    for (size_t half = size / 2; half != 0; half /= 2) {
+        for (size_t block = 0; block != size; block += 2 * half) {
+            uint32_t* low = data + block;
+            uint32_t* high = low + half;
+            for (size_t j = 0; j != half; ++j) {
+                uint32_t u = low[j], v = high[j];
+                uint32_t sum = u + v;
+                low[j] = sum >= 2 * Modulus ? sum - 2 * Modulus : sum;
+                high[j] = ReduceLazy(static_cast<uint64_t>(u + 2 * Modulus - v) * roots[half + j]);
+            }
+        }
+    }
+}
+
+template<uint32_t Modulus>
+void NumberTheoreticTransform<Modulus>::Inverse(uint32_t* data, size_t size, const uint32_t* roots) {
+    for (size_t half = 1; half != size; half *= 2) {
+        for (size_t block = 0; block != size; block += 2 * half) {
+            uint32_t* low = data + block;
+            uint32_t* high = low + half;
+            for (size_t j = 0; j != half; ++j) {
+                uint32_t u = low[j] >= 2 * Modulus ? low[j] - 2 * Modulus : low[j];
+                uint32_t v = ReduceLazy(static_cast<uint64_t>(high[j]) * roots[half + j]);
+                low[j] = u + v;
+                high[j] = u + 2 * Modulus - v;
+            }
+        }
+    }
+}
+
+template<uint32_t Modulus>
+template<typename Value>
+std::vector<std::vector<uint32_t>> NumberTheoreticTransform<Modulus>::Convolve(
+        const std::vector<std::vector<Value>>& first, const std::vector<std::vector<Value>>* second,
+        size_t resultSize, size_t count) {
+    size_t size = TransformSize(resultSize);
+    if (size > kMaxSize) {
+        THROW(length_error, "Product of length " << resultSize << " is too long for the NTT modulo " << Modulus)
+    }
+    std::vector<uint32_t> roots = Roots(size, false);
+    auto transform = [&](const std::vector<std::vector<Value>>& pieces) {
+        std::vector<std::vector<uint32_t>> ans;
+        for (const std::vector<Value>& piece : pieces) {
+            ans.emplace_back(size, 0);
+            for (size_t i = 0; i != piece.size(); ++i) {
+                ans.back()[i] = ToMontgomery(Residue(piece[i]));
+            }
+            Forward(ans.back().data(), size, roots.data());
+        }
+        return ans;
+    };
+    std::vector<std::vector<uint32_t>> firstSpectrum = transform(first);
+    std::vector<std::vector<uint32_t>> secondSpectrum;
+    if (second) {
+        secondSpectrum = transform(*second);
+    }
+    const std::vector<std::vector<uint32_t>>& other = second ? secondSpectrum : firstSpectrum;
+
+    roots = Roots(size, true);
+    // 1 / size, brought out of Montgomery form together with the result
+    uint32_t scale = static_cast<uint32_t>(PowerMod(size, Modulus - 2, Modulus));
+    std::vector<std::vector<uint32_t>> ans(count);
+    for (size_t k = 0; k != count; ++k) {
+        std::vector<uint32_t>& piece = ans[k];
+        piece.assign(size, 0);
+        for (size_t i = 0; i <= k && i < first.size(); ++i) {
+            if (k - i >= other.size()) {
+                continue;
+            }
+            const uint32_t* a = firstSpectrum[i].data();
+            const uint32_t* b = other[k - i].data();
+            for (size_t j = 0; j != size; ++j) {
+                uint32_t sum = piece[j] + Multiply(a[j], b[j]);
+                piece[j] = sum >= Modulus ? sum - Modulus : sum;
+            }
+        }
+        Inverse(piece.data(), size, roots.data());
+        piece.resize(resultSize);
+        for (uint32_t& value : piece) {
+            value = Multiply(value, scale);
+        }
+    }
+    return ans;
+}
+
+constexpr uint32_t kNttPrimes[3] = {998244353, 167772161, 469762049};
+
+
+constexpr unsigned __int128 kNttPrimesProduct =
+    static_cast<unsigned __int128>(kNttPrimes[0]) * kNttPrimes[1] * kNttPrimes[2];
+
+// The convolutions of NumberTheoreticTransform::Convolve modulo the three primes, one per task;
+// ans[prime][k] is piece k modulo kNttPrimes[prime]
+template<typename Value>
+std::vector<std::vector<std::vector<uint32_t>>> ThreePrimeConvolve(const std::vector<std::vector<Value>>& first,
+                                                                   const std::vector<std::vector<Value>>* second,
+                                                                   size_t resultSize, size_t count) {
+    std::vector<std::vector<std::vector<uint32_t>>> ans(3);
+    ThreadPool::Instance().ParallelFor(0, 3, 1, [&](size_t from, size_t to) {
+        for (size_t prime = from; prime != to; ++prime) {
+            if (prime == 0) {
+                ans[0] = NumberTheoreticTransform<kNttPrimes[0]>::Convolve(first, second, resultSize, count);
+            } else if (prime == 1) {
+                ans[1] = NumberTheoreticTransform<kNttPrimes[1]>::Convolve(first, second, resultSize, count);
+            } else {
+                ans[2] = NumberTheoreticTransform<kNttPrimes[2]>::Convolve(first, second, resultSize, count);
+            }
+        }
+    });
+    return ans;
+}
+
+// The x < kNttPrimesProduct with these residues (Garner)
+inline unsigned __int128 CombineResidues(uint64_t r0, uint64_t r1, uint64_t r2) {
+    constexpr uint64_t p0 = kNttPrimes[0], p1 = kNttPrimes[1], p2 = kNttPrimes[2];
+    constexpr uint64_t inverse0 = PowerMod(p0, p1 - 2, p1);
+    constexpr uint64_t inverse01 = PowerMod(p0 * p1 % p2, p2 - 2, p2);
+    uint64_t x01 = r0 + p0 * ((r1 + p1 - r0 % p1) * inverse0 % p1);
+    uint64_t t = (r2 + p2 - x01 % p2) * inverse01 % p2;
+    return x01 + static_cast<unsigned __int128>(p0 * p1) * t;
+}
+
+template<typename ValueType>
+void MultiplySchoolbook(const ValueType* first, size_t firstSize, const ValueType* second, size_t secondSize,
+                ValueType* out) {
+    for (size_t i = 0; i != firstSize; ++i) {
+        if (first[i] == ValueType(0)) {
+            continue;
+        }
+        ValueType* row = out + i;
+        for (size_t j = 0; j != secondSize; ++j) {
+            row[j] += first[i] * second[j];
+        }
+    }
+}
+
+// out[0, 2 * size - 1) += first * second, both of length size
+template<typename ValueType>
+void Karatsuba(const ValueType* first, const ValueType* second, size_t size, ValueType* out) {
+    if (size <= kKaratsubaLimit) {
+        MultiplySchoolbook(first, size, second, size, out);
+        return;
+    }
+    size_t low = size / 2, high = size - low;
+    std::vector<ValueType> firstSum(first + low, first + size), secondSum(second + low, second + size);
+    for (size_t i = 0; i != low; ++i) {
+        firstSum[i] += first[i];
+        secondSum[i] += second[i];
+    }
+    std::vector<ValueType> lowProduct(2 * low - 1, ValueType(0)), highProduct(2 * high - 1, ValueType(0));
+    std::vector<ValueType> middle(2 * high - 1, ValueType(0));
+    Karatsuba(first, second, low, lowProduct.data());
+    Karatsuba(first + low, second + low, high, highProduct.data());
+    Karatsuba(firstSum.data(), secondSum.data(), high, middle.data());
+    for (size_t i = 0; i != lowProduct.size(); ++i) {
+        out[i] += lowProduct[i];
+        middle[i] -= lowProduct[i];
+    }
+    for (size_t i = 0; i != highProduct.size(); ++i) {
+        out[2 * low + i] += highProduct[i];
+        middle[i] -= highProduct[i];
+    }
+    for (size_t i = 0; i != middle.size(); ++i) {
+        out[low + i] += middle[i];
+    }
+}
+
+// Karatsuba on blocks of the longer operand as long as the shorter one
+template<typename ValueType>
+std::vector<ValueType> MultiplyKaratsuba(const std::vector<ValueType>& first, const std::vector<ValueType>& second) {
+    const std::vector<ValueType>& longer = first.size() >= second.size() ? first : second;
+    const std::vector<ValueType>& shorter = first.size() >= second.size() ? second : first;
+    size_t block = shorter.size();
+    std::vector<ValueType> ans(first.size() + second.size() - 1, ValueType(0));
+    std::vector<ValueType> padded(block, ValueType(0));
+    std::vector<ValueType> product(2 * block - 1);
+    for (size_t start = 0; start < longer.size(); start += block) {
+        size_t length = std::min(block, longer.size() - start);
+        const ValueType* part = longer.data() + start;
+        if (length != block) {
+            std::fill(std::copy(part, part + length, padded.begin()), padded.end(), ValueType(0));
+            part = padded.data();
+        }
+        std::fill(product.begin(), product.end(), ValueType(0));
+        Karatsuba(part, shorter.data(), block, product.data());
+        size_t used = std::min(product.size(), ans.size() - start);
+        for (size_t i = 0; i != used; ++i) {
+            ans[start + i] += product[i];
+        }
+    }
+    return ans;
+}
+
+template<uint32_t Modulus>
+std::vector<ModularInteger<Modulus>> MultiplyModularCoefficients(const std::vector<ModularInteger<Modulus>>& first,
+                                                                 const std::vector<ModularInteger<Modulus>>& second) {
+    auto residues = [](const std::vector<ModularInteger<Modulus>>& values) {
+        std::vector<std::vector<uint32_t>> ans(1);
+        ans[0].reserve(values.size());
+        for (ModularInteger<Modulus> value : values) {
+            ans[0].push_back(value.Value());
+        }
+        return ans;
+    };
+    size_t resultSize = first.size() + second.size() - 1;
+    std::vector<std::vector<uint32_t>> firstResidues = residues(first), secondResidues;
+    if (&first != &second) {
+        secondResidues = residues(second);
+    }
+    const std::vector<std::vector<uint32_t>>* other = &first != &second ? &secondResidues : nullptr;
+    std::vector<ModularInteger<Modulus>> ans(resultSize);
+    if (TransformSize(resultSize) <= NumberTheoreticTransform<Modulus>::kMaxSize) {
+        std::vector<uint32_t> product =
+            NumberTheoreticTransform<Modulus>::Convolve(firstResidues, other, resultSize, 1)[0];
+        for (size_t i = 0; i != resultSize; ++i) {
+            ans[i] = ModularInteger<Modulus>::FromResidue(product[i]);
+        }
+        return ans;
+    }
+    // Residues are below 2^30, sums of up to 2^26 of their products stay below kNttPrimesProduct
+    auto product = ThreePrimeConvolve(firstResidues, other, resultSize, 1);
+    for (size_t i = 0; i != resultSize; ++i) {
+        unsigned __int128 value = CombineResidues(product[0][0][i], product[1][0][i], product[2][0][i]);
+        ans[i] = ModularInteger<Modulus>::FromResidue(static_cast<uint32_t>(value % Modulus));
+    }
+    return ans;
+}
+
+// Exact modulo 2^64, like the schoolbook product with wrapping arithmetic. When the result can't
+// exceed half of kNttPrimesProduct in absolute value the coefficients go in directly and the CRT
+// result is read as signed. Otherwise they are cut into pieces of their 64-bit two's complement,
+// two of 32 bits while the shorter operand is below about 2^21 terms and three of 22 bits (good
+// to about 2^40) beyond; piece products that only reach bits above 2^64 are skipped.
+template<typename ValueType>
+std::vector<ValueType> MultiplyIntegerCoefficients(const std::vector<ValueType>& first,
+                                                   const std::vector<ValueType>& second) {
+    auto largest = [](const std::vector<ValueType>& values) {
+        uint64_t ans = 0;
+        for (ValueType value : values) {
+            uint64_t magnitude = static_cast<uint64_t>(value);
+            if constexpr (std::is_signed_v<ValueType>) {
+                magnitude = value < 0 ? -static_cast<uint64_t>(value) : magnitude;
+            }
+            ans = std::max(ans, magnitude);
+        }
+        return ans;
+    };
+    size_t resultSize = first.size() + second.size() - 1;
+    size_t shorter = std::min(first.size(), second.size());
+    bool square = &first == &second;
+    std::vector<ValueType> ans(resultSize);
+    unsigned __int128 bound = static_cast<unsigned __int128>(largest(first)) * largest(second);
+    if (bound < kNttPrimesProduct / 2 / shorter) {
+        std::vector<std::vector<ValueType>> firstPieces{first}, secondPieces;
+        if (!square) {
+            secondPieces.push_back(second);
+        }
+        auto product = ThreePrimeConvolve(firstPieces, square ? nullptr : &secondPieces, resultSize, 1);
+        for (size_t i = 0; i != resultSize; ++i) {
+            unsigned __int128 value = CombineResidues(product[0][0][i], product[1][0][i], product[2][0][i]);
+            // Negative results wrap around to below 2^64 as in two's complement
+            ans[i] = static_cast<ValueType>(static_cast<uint64_t>(value > kNttPrimesProduct / 2 ?
+                                                                  value - kNttPrimesProduct : value));
+        }
+        return ans;
+    }
+    unsigned __int128 largestPiece = static_cast<unsigned __int128>(~0U) * ~0U;
+    size_t pieces = largestPiece * 2 < kNttPrimesProduct / shorter ? 2 : 3;
+    size_t bits = pieces == 2 ? 32 : 22;
+    auto split = [&](const std::vector<ValueType>& values) {
+        std::vector<std::vector<uint32_t>> ans(pieces, std::vector<uint32_t>(values.size()));
+        for (size_t i = 0; i != values.size(); ++i) {
+            uint64_t value = static_cast<uint64_t>(values[i]);
+            for (size_t piece = 0; piece != pieces; ++piece) {
+                ans[piece][i] = static_cast<uint32_t>(value >> (piece * bits) & ((uint64_t(1) << bits) - 1));
+            }
+        }
+        return ans;
+    };
+    std::vector<std::vector<uint32_t>> firstPieces = split(first), secondPieces;
+    if (!square) {
+        secondPieces = split(second);
+    }
+    auto product = ThreePrimeConvolve(firstPieces, square ? nullptr : &secondPieces, resultSize, pieces);
+    for (size_t i = 0; i != resultSize; ++i) {
+        uint64_t value = 0;
+        for (size_t piece = 0; piece != pieces; ++piece) {
+            unsigned __int128 part = CombineResidues(product[0][piece][i], product[1][piece][i], product[2][piece][i]);
+            value += static_cast<uint64_t>(part) << (piece * bits);
+        }
+        ans[i] = static_cast<ValueType>(value);
+    }
+    return ans;
+}
+
+// Both real operands go into one complex FFT as real and imaginary parts, the spectrum of the
+// product is recovered from it by symmetry, and a second FFT brings it back: two transforms
+// instead of three. Computed in double whatever the coefficient type.
+template<typename ValueType>
+std::vector<ValueType> MultiplyFloatingCoefficients(const std::vector<ValueType>& first,
+                                                    const std::vector<ValueType>& second) {
+    using Number = ComplexNumber<double>;
+    size_t resultSize = first.size() + second.size() - 1;
+    size_t size = TransformSize(resultSize);
+    std::vector<Number> roots(std::max<size_t>(size, 2));
+    const double pi = std::acos(-1.0);
+    for (size_t j = 0; j != size / 2; ++j) {
+        roots[size / 2 + j] = Number(std::cos(pi * j / (size / 2)), std::sin(pi * j / (size / 2)));
+    }
+    for (size_t level = size / 4; level != 0; level /= 2) {
+        for (size_t j = 0; j != level; ++j) {
+            roots[level + j] = roots[2 * (level + j)];
+        }
+    }
+    // Bit-reversal permutation, then decimation in time: natural order in and out
+    auto transform = [&](std::vector<Number>& data) {
+        for (size_t i = 1, j = 0; i != size; ++i) {
+            size_t bit = size >> 1;
+            for (; j & bit; bit >>= 1) {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j) {
+                std::swap(data[i], data[j]);
+            }
+        }
+        for (size_t half = 1; half != size; half *= 2) {
+            for (size_t block = 0; block != size; block += 2 * half) {
+                Number* low = data.data() + block;
+                Number* high = low + half;
+                for (size_t j = 0; j != half; ++j) {
+                    Number v = high[j] * roots[half + j];
+                    high[j] = low[j] - v;
+                    low[j] = low[j] + v;
+                }
+            }
+        }
+    };
+
+    std::vector<Number> packed(size);
+    for (size_t i = 0; i != first.size(); ++i) {
+        packed[i].re = static_cast<double>(first[i]);
+    }
+    for (size_t i = 0; i != second.size(); ++i) {
+        packed[i].im = static_cast<double>(second[i]);
+    }
+    transform(packed);
+    // With X the spectrum of first + i * second and Y[k] = conj(X[-k]), first has (X + Y) / 2
+    // and second (X - Y) / 2i, so the product has (X^2 - Y^2) / 4i. Conjugated for the inverse.
+    std::vector<Number> spectrum(size);
+    for (size_t k = 0; k != size; ++k) {
+        Number x = packed[k], y = packed[(size - k) & (size - 1)].conj();
+        Number square = x * x - y * y;
+        spectrum[k] = Number(square.im / 4, square.re / 4);
+    }
+    transform(spectrum);
+    std::vector<ValueType> ans(resultSize);
+    for (size_t i = 0; i != resultSize; ++i) {
+        ans[i] = static_cast<ValueType>(spectrum[i].re / size);
+    }
+    return ans;
+}
+
+// first * second as coefficient arrays, lowest power first; passing the same vector twice
+// squares it with fewer transforms
+template<typename ValueType>
+std::vector<ValueType> MultiplyCoefficients(const std::vector<ValueType>& first, const std::vector<ValueType>& second) {
+    if (first.empty() || second.empty()) {
+        return {};
+    }
+    size_t shorter = std::min(first.size(), second.size());
+    if (shorter < kSchoolbookLimit) {
+        std::vector<ValueType> ans(first.size() + second.size() - 1, ValueType(0));
+        MultiplySchoolbook(first.data(), first.size(), second.data(), second.size(), ans.data());
+        return ans;
+    }
+    if constexpr (IsModularInteger<ValueType>::value) {
+        bool direct = TransformSize(first.size() + second.size() - 1) <=
+                      NumberTheoreticTransform<ValueType::kModulus>::kMaxSize;
+        if (shorter >= (direct ? kNttLimit : kModularCrtLimit)) {
+            return MultiplyModularCoefficients(first, second);
+        }
+    } else if constexpr (std::is_integral_v<ValueType> && !std::is_same_v<ValueType, bool> &&
+                         sizeof(ValueType) <= sizeof(uint64_t)) {
+        if (shorter >= kIntegerCrtLimit) {
+            return MultiplyIntegerCoefficients(first, second);
+        }
+    } else if constexpr (std::is_same_v<ValueType, float> || std::is_same_v<ValueType, double>) {
+        if (shorter >= kFourierLimit) {
+            return MultiplyFloatingCoefficients(first, second);
+        }
+    }
+    return MultiplyKaratsuba(first, second);
+}
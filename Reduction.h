@@ -0,0 +1,339 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "MatrixSimd.h"
+#include "ThreadPool.h"
+
+// Reductions over contiguous arrays. Floating-point sums are compensated twice: Kahan summation
+// in kReductionLanes independent lanes inside a block, then pairwise merging of the block
+// results in index order. Blocks have a fixed size, so a result doesn't depend on how many
+// threads computed it. Kernels are always_inline structs run through RunReduction, which
+// compiles them once per SIMD level like the batched kernels in MatrixBatch.h.
+
+constexpr size_t kReductionBlock = static_cast<size_t>(1) << 14;
+constexpr size_t kReductionLanes = 32;
+
+// Value is sum - compensation, compensation carries the rounding errors Kahan summation saw
+template<typename ValueType>
+struct KahanPartial {
+    ValueType sum = ValueType();
+    ValueType compensation = ValueType();
+
+    [[nodiscard]] ValueType Value() const {
+        return sum - compensation;
+    }
+};
+
+// Exact merge of the two leading parts (TwoSum), the error joins the compensations
+template<typename ValueType>
+KahanPartial<ValueType> MergeKahan(const KahanPartial<ValueType>& first, const KahanPartial<ValueType>& second) {
+    if constexpr (std::is_floating_point_v<ValueType>) {
+        ValueType sum = first.sum + second.sum;
+        ValueType shifted = sum - first.sum;
+        ValueType error = (first.sum - (sum - shifted)) + (second.sum - shifted);
+        return {sum, first.compensation + second.compensation - error};
+    } else {
+        return {first.sum + second.sum, ValueType()};
+    }
+}
+
+struct IdentityTransform {
+    template<typename ValueType>
+    ValueType operator()(ValueType value) const {
+        return value;
+    }
+};
+
+struct AbsoluteTransform {
+    template<typename ValueType>
+    ValueType operator()(ValueType value) const {
+        return value < ValueType() ? -value : value;
+    }
+};
+
+struct SquareTransform {
+    template<typename ValueType>
+    ValueType operator()(ValueType value) const {
+        return value * value;
+    }
+};
+
+// Sum of transform(x[i]) over [0, count)
+template<typename ValueType, typename Transform>
+struct KahanSumKernel {
+    __attribute__((always_inline))
+    static inline KahanPartial<ValueType> Run(const ValueType* x, size_t count) {
+        Transform transform;
+        if constexpr (!std::is_floating_point_v<ValueType>) {
+            ValueType sum = ValueType();
+            for (size_t i = 0; i != count; ++i) {
+                sum += transform(x[i]);
+            }
+            return {sum, ValueType()};
+        } else {
+            ValueType sum[kReductionLanes]{}, compensation[kReductionLanes]{};
+            size_t i = 0;
+            for (; i + kReductionLanes <= count; i += kReductionLanes) {
+                for (size_t lane = 0; lane != kReductionLanes; ++lane) {
+                    ValueType y = transform(x[i + lane]) - compensation[lane];
+                    ValueType t = sum[lane] + y;
+                    compensation[lane] = (t - sum[lane]) - y;
+                    sum[lane] = t;
+                }
+            }
+            KahanPartial<ValueType> ans{sum[0], compensation[0]};
+            for (size_t lane = 1; lane != kReductionLanes; ++lane) {
+                ans = MergeKahan(ans, {sum[lane], compensation[lane]});
+            }
+            for (; i != count; ++i) {
+                ValueType y = transform(x[i]) - ans.compensation;
+                ValueType t = ans.sum + y;
+                ans.compensation = (t - ans.sum) - y;
+                ans.sum = t;
+            }
+            return ans;
+        }
+    }
+};
+
+// {min, max} of x[0, count), count > 0
+template<typename ValueType>
+struct MinMaxKernel {
+    __attribute__((always_inline))
+    static inline std::pair<ValueType, ValueType> Run(const ValueType* x, size_t count) {
+        ValueType low[kReductionLanes], high[kReductionLanes];
+        std::fill(low, low + kReductionLanes, x[0]);
+        std::fill(high, high + kReductionLanes, x[0]);
+        size_t i = 0;
+        for (; i + kReductionLanes <= count; i += kReductionLanes) {
+            for (size_t lane = 0; lane != kReductionLanes; ++lane) {
+                low[lane] = x[i + lane] < low[lane] ? x[i + lane] : low[lane];
+                high[lane] = high[lane] < x[i + lane] ? x[i + lane] : high[lane];
+            }
+        }
+        ValueType lowest = *std::min_element(low, low + kReductionLanes);
+        ValueType highest = *std::max_element(high, high + kReductionLanes);
+        for (; i != count; ++i) {
+            lowest = std::min(lowest, x[i]);
+            highest = std::max(highest, x[i]);
+        }
+        return {lowest, highest};
+    }
+};
+
+// Kahan-adds transform(row[j]) into column j of sum / compensation, one contiguous row at a time
+template<typename ValueType, typename Transform>
+struct ColumnKahanKernel {
+    __attribute__((always_inline))
+    static inline void Add(ValueType value, ValueType& sum, ValueType& compensation) {
+        if constexpr (std::is_floating_point_v<ValueType>) {
+            ValueType y = value - compensation;
+            ValueType t = sum + y;
+            compensation = (t - sum) - y;
+            sum = t;
+        } else {
+            sum += value;
+        }
+    }
+
+    __attribute__((always_inline))
+    static inline void Run(const ValueType* __restrict row, size_t columns, ValueType* __restrict sum,
+                           ValueType* __restrict compensation) {
+        Transform transform;
+        size_t j = 0;
+        for (; j + kReductionLanes <= columns; j += kReductionLanes) {
+            for (size_t lane = 0; lane != kReductionLanes; ++lane) {
+                Add(transform(row[j + lane]), sum[j + lane], compensation[j + lane]);
+            }
+        }
+        for (; j != columns; ++j) {
+            Add(transform(row[j]), sum[j], compensation[j]);
+        }
+    }
+};
+
+// Whether some |a[i] - b[i]| > absolute + relative * |b[i]|, NaNs never compare equal
+template<typename ValueType>
+struct MismatchKernel {
+    __attribute__((always_inline))
+    static inline bool Differs(ValueType a, ValueType b, ValueType absolute, ValueType relative) {
+        ValueType difference = a < b ? b - a : a - b;
+        ValueType magnitude = b < ValueType() ? -b : b;
+        return !(difference <= absolute + relative * magnitude);
+    }
+
+    __attribute__((always_inline))
+    static inline bool Run(const ValueType* a, const ValueType* b, size_t count, ValueType absolute,
+                           ValueType relative) {
+        // Flags are kept as ValueType so the whole loop stays in one vector width
+        ValueType flags[kReductionLanes]{};
+        size_t i = 0;
+        for (; i + kReductionLanes <= count; i += kReductionLanes) {
+            for (size_t lane = 0; lane != kReductionLanes; ++lane) {
+                flags[lane] = Differs(a[i + lane], b[i + lane], absolute, relative) ? ValueType(1) : flags[lane];
+            }
+        }
+        bool ans = false;
+        for (size_t lane = 0; lane != kReductionLanes; ++lane) {
+            ans |= flags[lane] != ValueType();
+        }
+        for (; i != count; ++i) {
+            ans |= Differs(a[i], b[i], absolute, relative);
+        }
+        return ans;
+    }
+};
+
+template<typename Kernel, typename... Args>
+auto RunReductionGeneric(Args... args) {
+    return Kernel::Run(args...);
+}
+
+#ifdef MATRIX_SIMD_X86
+template<typename Kernel, typename... Args>
+__attribute__((target("avx2,fma")))
+auto RunReductionAvx2(Args... args) {
+    return Kernel::Run(args...);
+}
+
+template<typename Kernel, typename... Args>
+__attribute__((target("avx512f")))
+auto RunReductionAvx512(Args... args) {
+    return Kernel::Run(args...);
+}
+#endif
+
+template<typename Kernel, typename... Args>
+auto RunReduction(Args... args) {
+#ifdef MATRIX_SIMD_X86
+    switch (CurrentSimdLevel()) {
+        case SimdLevel::Avx512:
+            return RunReductionAvx512<Kernel>(args...);
+        case SimdLevel::Avx2:
+            return RunReductionAvx2<Kernel>(args...);
+        default:
+            break;
+    }
+#endif
+    return RunReductionGeneric<Kernel>(args...);
+}
+
+// Reduces [0, count) in blocks of blockSize: partials[b] = block(from, to) on the pool, then the
+// partials are merged pairwise in index order. Returns empty when count is 0.
+template<typename Partial, typename Block, typename Merge>
+Partial ReduceBlocks(size_t count, size_t blockSize, Partial empty, Block block, Merge merge) {
+    size_t blocks = (count + blockSize - 1) / blockSize;
+    if (blocks == 0) {
+        return empty;
+    }
+    std::vector<Partial> partials(blocks, empty);
+    size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / blockSize, static_cast<size_t>(1));
+    ThreadPool::Instance().ParallelFor(0, blocks, grain, [&](size_t from, size_t to) {
+        for (size_t b = from; b != to; ++b) {
+            partials[b] = block(b * blockSize, std::min(count, (b + 1) * blockSize));
+        }
+    });
+    for (size_t width = 1; width < blocks; width *= 2) {
+        for (size_t i = 0; i + width < blocks; i += 2 * width) {
+            partials[i] = merge(partials[i], partials[i + width]);
+        }
+    }
+    return partials[0];
+}
+
+template<typename ValueType, typename Transform = IdentityTransform>
+ValueType ReduceSum(const ValueType* x, size_t count) {
+    KahanPartial<ValueType> ans = ReduceBlocks(count, kReductionBlock, KahanPartial<ValueType>(),
+                                               [&](size_t from, size_t to) {
+        return RunReduction<KahanSumKernel<ValueType, Transform>>(x + from, to - from);
+    }, MergeKahan<ValueType>);
+    return ans.Value();
+}
+
+// count > 0
+template<typename ValueType>
+std::pair<ValueType, ValueType> ReduceMinMax(const ValueType* x, size_t count) {
+    return ReduceBlocks(count, kReductionBlock, std::make_pair(x[0], x[0]), [&](size_t from, size_t to) {
+        return RunReduction<MinMaxKernel<ValueType>>(x + from, to - from);
+    }, [](const std::pair<ValueType, ValueType>& first, const std::pair<ValueType, ValueType>& second) {
+        return std::make_pair(std::min(first.first, second.first), std::max(first.second, second.second));
+    });
+}
+
+// Sum of x[0], x[stride], ... (count elements), e.g. a diagonal. Every element is on its own
+// cache line, so there is nothing to vectorize and blocks are summed with plain Kahan loops.
+template<typename ValueType>
+ValueType ReduceStridedSum(const ValueType* x, size_t count, size_t stride) {
+    KahanPartial<ValueType> ans = ReduceBlocks(count, kReductionBlock, KahanPartial<ValueType>(),
+                                               [&](size_t from, size_t to) {
+        KahanPartial<ValueType> partial;
+        for (size_t i = from; i != to; ++i) {
+            partial = MergeKahan(partial, {x[i * stride], ValueType()});
+        }
+        return partial;
+    }, MergeKahan<ValueType>);
+    return ans.Value();
+}
+
+// At most this many row blocks in ReduceColumns, keeps the accumulators small for wide arrays
+constexpr size_t kColumnReductionBlocks = 64;
+
+// Column sums of transform(a[i][j]) for a rows x columns array with rows lda apart. Every block
+// of rows walks its rows front to back into its own column accumulators, then the blocks are
+// merged pairwise.
+
+template<typename ValueType, typename Transform = IdentityTransform>
+std::vector<ValueType> ReduceColumns(const ValueType* a, size_t rows, size_t columns, size_t lda) {
+    using Partial = std::vector<KahanPartial<ValueType>>;
+    size_t blockRows = std::max((kReductionBlock + columns - 1) / std::max(columns, static_cast<size_t>(1)),
+                                (rows + kColumnReductionBlocks - 1) / kColumnReductionBlocks);
+    Partial total = ReduceBlocks(rows, std::max(blockRows, static_cast<size_t>(1)), Partial(columns),
+                                 [&](size_t from, size_t to) {
+        std::vector<ValueType> sum(columns), compensation(columns);
+        for (size_t i = from; i != to; ++i) {
+            RunReduction<ColumnKahanKernel<ValueType, Transform>>(a + i * lda, columns, sum.data(),
+                                                                  compensation.data());
+        }
+        Partial ans(columns);
+        for (size_t j = 0; j != columns; ++j) {
+            ans[j] = {sum[j], compensation[j]};
+        }
+        return ans;
+    }, [](Partial first, const Partial& second) {
+        for (size_t j = 0; j != first.size(); ++j) {
+            first[j] = MergeKahan(first[j], second[j]);
+        }
+        return first;
+    });
+    std::vector<ValueType> ans(columns);
+    for (size_t j = 0; j != columns; ++j) {
+        ans[j] = total[j].Value();
+    }
+    return ans;
+}
+
+// Compares a and b element-wise with tolerance, the pool stops handing out work once a
+// mismatch is found and blocks check the flag every kMismatchStep elements
+constexpr size_t kMismatchStep = 1024;
+
+template<typename ValueType>
+bool ReduceApproxEqual(const ValueType* a, const ValueType* b, size_t count, ValueType absolute,
+                       ValueType relative) {
+    std::atomic<bool> mismatch{false};
+    size_t grain = std::max(ThreadPool::Instance().MinTaskSize(), kMismatchStep);
+    ThreadPool::Instance().ParallelFor(0, count, grain, [&](size_t from, size_t to) {
+        for (size_t i = from; i < to && !mismatch.load(std::memory_order_relaxed); i += kMismatchStep) {
+            size_t length = std::min(kMismatchStep, to - i);
+            if (RunReduction<MismatchKernel<ValueType>>(a + i, b + i, length, absolute, relative)) {
+                mismatch.store(true, std::memory_order_relaxed);
+            }
+        }
+    });
+    return !mismatch.load();
+}
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Matrix.h"
+#include "MatrixNorms.h"
+
+// Usage: ReductionBenchmark [sizes...] [--simd=scalar|avx2|avx512]
+// Prints the bandwidth of the reductions in MatrixNorms.h on n x n double matrices next to a
+// plain serial loop summing the same data, and how long ApproxEqual takes to reject matrices
+// that differ in their first row.
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (!ParseSimdFlag(arg)) {
+            sizes.push_back(std::stoul(arg));
+        }
+    }
+    if (sizes.empty()) {
+        sizes = {256, 1024, 4096};
+    }
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    std::cout << std::setw(6) << "n" << std::setw(10) << "serial" << std::setw(10) << "sum" << std::setw(10)
+              << "frob" << std::setw(10) << "max" << std::setw(10) << "rows" << std::setw(10) << "columns"
+              << std::setw(10) << "equal" << "   (GB/s)" << std::setw(14) << "reject (us)\n";
+    for (size_t n : sizes) {
+        Matrix<double> a(n, n);
+        for (size_t i = 0; i != n; ++i) {
+            for (size_t j = 0; j != n; ++j) {
+                a[i][j] = dist(rng);
+            }
+        }
+        Matrix<double> b = a;
+        size_t repeats = std::max((static_cast<size_t>(1) << 28) / (n * n), static_cast<size_t>(1));
+        double bytes = 8.0 * n * n;
+        volatile double sink = 0;
+
+        double serialTime = Seconds([&] {
+            double sum = 0;
+            for (size_t i = 0; i != n * n; ++i) {
+                sum += a.Data()[i];
+            }
+            sink = sum;
+        }, repeats);
+        double sumTime = Seconds([&] { sink = Sum(a); }, repeats);
+        double frobeniusTime = Seconds([&] { sink = FrobeniusNorm(a); }, repeats);
+        double maxTime = Seconds([&] { sink = MaxNorm(a); }, repeats);
+        double rowTime = Seconds([&] { sink = RowSums(a)[0]; }, repeats);
+        double columnTime = Seconds([&] { sink = ColumnSums(a)[0]; }, repeats);
+        double equalTime = Seconds([&] { sink = ApproxEqual(a, b, 1e-12); }, repeats);
+        b[0][n / 2] += 1;
+        double rejectTime = Seconds([&] { sink = ApproxEqual(a, b, 1e-12); }, repeats);
+
+        std::cout << std::setw(6) << n << std::fixed << std::setprecision(2)
+                  << std::setw(10) << bytes / serialTime * 1e-9
+                  << std::setw(10) << bytes / sumTime * 1e-9
+                  << std::setw(10) << bytes / frobeniusTime * 1e-9
+                  << std::setw(10) << bytes / maxTime * 1e-9
+                  << std::setw(10) << bytes / rowTime * 1e-9
+                  << std::setw(10) << bytes / columnTime * 1e-9
+                  << std::setw(10) << 2 * bytes / equalTime * 1e-9
+                  << std::setw(23) << rejectTime * 1e6 << '\n';
+    }
+}
@@ -0,0 +1,524 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+// Compressed sparse storage. CSR keeps the nonzeros row by row, CSC column by column; the
+// rows (columns) are the "lines" of the format. Line i occupies [Offsets()[i], Offsets()[i + 1])
+// of Indices() (column or row numbers, ascending) and Values(). Everything is O(nnz + lines).
+enum class SparseFormat {
+    Csr,
+    Csc
+};
+
+template<typename ValueType = double>
+class SparseMatrix {
+ public:
+    using value_type = ValueType;
+    // (row, column, value), duplicates are summed
+    using Entry = std::tuple<size_t, size_t, ValueType>;
+
+    SparseMatrix(size_t rows, size_t columns, SparseFormat format = SparseFormat::Csr);
+
+    SparseMatrix(size_t rows, size_t columns, std::vector<Entry> entries, SparseFormat format = SparseFormat::Csr);
+
+    // Keeps the nonzero elements of dense
+    explicit SparseMatrix(const Matrix<ValueType>& dense, SparseFormat format = SparseFormat::Csr);
+
+    explicit operator Matrix<ValueType>() const;
+
+    [[nodiscard]] size_t Rows() const;
+
+    [[nodiscard]] size_t Columns() const;
+
+    [[nodiscard]] size_t NonZeros() const;
+
+    [[nodiscard]] SparseFormat Format() const;
+
+    const std::vector<size_t>& Offsets() const;
+
+    const std::vector<size_t>& Indices() const;
+
+    const std::vector<ValueType>& Values() const;
+
+    // Binary search inside the line, zero for absent elements
+    ValueType At(size_t i, size_t j) const;
+
+    SparseMatrix Converted(SparseFormat format) const;
+
+    bool operator==(const SparseMatrix& other) const;
+
+    bool operator!=(const SparseMatrix& other) const;
+
+    // Sparse matrix by dense vector, rows of CSR run in parallel
+    std::vector<ValueType> operator*(const std::vector<ValueType>& vector) const;
+
+    Matrix<ValueType> operator*(const Matrix<ValueType>& other) const;
+
+    // Gustavson's row by row product, one pass counts the nonzeros of every result row,
+    // the second one fills them in place. The result has the format of *this.
+    SparseMatrix operator*(const SparseMatrix& other) const;
+
+    SparseMatrix& operator*=(ValueType other);
+
+    ValueType Tr() const;
+
+    // Keeps the format, a counting sort over the lines
+    SparseMatrix Transponed() const;
+
+    SparseMatrix& Transpone();
+ private:
+    SparseMatrix(size_t rows, size_t columns, SparseFormat format, std::vector<size_t> offsets,
+                 std::vector<size_t> indices, std::vector<ValueType> values);
+
+    [[nodiscard]] size_t Lines() const;
+
+    [[nodiscard]] size_t LineLength() const;
+
+    [[nodiscard]] size_t AverageNonZeros() const;
+
+    // Calls function(from, to) for ranges of lines, workPerLine is roughly the elements one line touches
+    template<typename Function>
+    void ForEachLineRange(size_t workPerLine, Function&& function) const;
+
+    // The same nonzeros stored along the other dimension
+    void Flip(std::vector<size_t>& flippedOffsets, std::vector<size_t>& flippedIndices,
+              std::vector<ValueType>& flippedValues) const;
+
+    // Product of row-compressed left (lines x inner) and right (inner x width), row-compressed
+    static SparseMatrix MultiplyLines(const SparseMatrix& left, const SparseMatrix& right, size_t width);
+
+    size_t rows = 0;
+    size_t columns = 0;
+    SparseFormat format = SparseFormat::Csr;
+    std::vector<size_t> offsets;
+    std::vector<size_t> indices;
+    std::vector<ValueType> values;
+};
+
+template<typename ValueType>
+SparseMatrix<ValueType>::SparseMatrix(size_t rows, size_t columns, SparseFormat format) :
+    rows(rows), columns(columns), format(format) {
+    offsets.assign(Lines() + 1, 0);
+}
+
+template<typename ValueType>
+SparseMatrix<ValueType>::SparseMatrix(size_t rows, size_t columns, SparseFormat format,
+                                      std::vector<size_t> offsets, std::vector<size_t> indices,
+                                      std::vector<ValueType> values) :
+    rows(rows), columns(columns), format(format), offsets(std::move(offsets)),
+    indices(std::move(indices)), values(std::move(values)) {}
+
+template<typename ValueType>
+SparseMatrix<ValueType>::SparseMatrix(size_t rows, size_t columns, std::vector<Entry> entries,
+                                      SparseFormat format) :
+    SparseMatrix(rows, columns, format) {
+    for (auto& [row, column, value] : entries) {
+        if (row >= rows || column >= columns) {
+            THROW(out_of_range, "Entry is out of matrix")
+        }
+        if (format == SparseFormat::Csc) {
+            std::swap(row, column);
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& first, const Entry& second) {
+        return std::tie(std::get<0>(first), std::get<1>(first)) <
+               std::tie(std::get<0>(second), std::get<1>(second));
+    });
+    indices.reserve(entries.size());
+    values.reserve(entries.size());
+    for (size_t k = 0; k != entries.size(); ++k) {
+        const auto& [line, index, value] = entries[k];
+        if (k != 0 && std::get<0>(entries[k - 1]) == line && std::get<1>(entries[k - 1]) == index) {
+            values.back() += value;
+            continue;
+        }
+        indices.push_back(index);
+        values.push_back(value);
+        ++offsets[line + 1];
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+}
+
+template<typename ValueType>
+SparseMatrix<ValueType>::SparseMatrix(const Matrix<ValueType>& dense, SparseFormat format) :
+    SparseMatrix(dense.Rows(), dense.Columns(), SparseFormat::Csr) {
+    ForEachLineRange(columns, [&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            const ValueType* row = dense.Data() + i * dense.Stride();
+            offsets[i + 1] = static_cast<size_t>(std::count_if(row, row + columns, [](const ValueType& value) {
+                return value != ValueType(0);
+            }));
+        }
+    });
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    indices.resize(offsets.back());
+    values.resize(offsets.back());
+    ForEachLineRange(columns, [&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            const ValueType* row = dense.Data() + i * dense.Stride();
+            size_t position = offsets[i];
+            for (size_t j = 0; j != columns; ++j) {
+                if (row[j] != ValueType(0)) {
+                    indices[position] = j;
+                    values[position++] = row[j];
+                }
+            }
+        }
+    });
+    if (format != SparseFormat::Csr) {
+        *this = Converted(format);
+    }
+}
+
+template<typename ValueType>
+SparseMatrix<ValueType>::operator Matrix<ValueType>() const {
+    Matrix<ValueType> ans(Rows(), Columns());
+    ForEachLineRange(AverageNonZeros(), [&](size_t from, size_t to) {
+        for (size_t line = from; line != to; ++line) {
+            for (size_t k = offsets[line]; k != offsets[line + 1]; ++k) {
+                if (format == SparseFormat::Csr) {
+                    ans[line][indices[k]] = values[k];
+                } else {
+                    ans[indices[k]][line] = values[k];
+                }
+            }
+        }
+    });
+    return ans;
+}
+
+template<typename ValueType>
+size_t SparseMatrix<ValueType>::Rows() const {
+    return rows;
+}
+
+template<typename ValueType>
+size_t SparseMatrix<ValueType>::Columns() const {
+    return columns;
+}
+
+template<typename ValueType>
+size_t SparseMatrix<ValueType>::NonZeros() const {
+    return values.size();
+}
+
+template<typename ValueType>
+SparseFormat SparseMatrix<ValueType>::Format() const {
+    return format;
+}
+
+template<typename ValueType>
+const std::vector<size_t>& SparseMatrix<ValueType>::Offsets() const {
+    return offsets;
+}
+
+template<typename ValueType>
+const std::vector<size_t>& SparseMatrix<ValueType>::Indices() const {
+    return indices;
+}
+
+template<typename ValueType>
+const std::vector<ValueType>& SparseMatrix<ValueType>::Values() const {
+    return values;
+}
+
+template<typename ValueType>
+size_t SparseMatrix<ValueType>::Lines() const {
+    return format == SparseFormat::Csr ? rows : columns;
+}
+
+template<typename ValueType>
+size_t SparseMatrix<ValueType>::LineLength() const {
+    return format == SparseFormat::Csr ? columns : rows;
+}
+
+template<typename ValueType>
+size_t SparseMatrix<ValueType>::AverageNonZeros() const {
+    return std::max(NonZeros() / std::max(Lines(), static_cast<size_t>(1)), static_cast<size_t>(1));
+}
+
+template<typename ValueType>
+template<typename Function>
+void SparseMatrix<ValueType>::ForEachLineRange(size_t workPerLine, Function&& function) const {
+    size_t grain = ThreadPool::Instance().MinTaskSize() / std::max(workPerLine, static_cast<size_t>(1));
+    ThreadPool::Instance().ParallelFor(0, Lines(), grain, function);
+}
+
+template<typename ValueType>
+ValueType SparseMatrix<ValueType>::At(size_t i, size_t j) const {
+    if (i >= Rows() || j >= Columns()) {
+        THROW(out_of_range, "Element is out of matrix")
+    }
+    if (format == SparseFormat::Csc) {
+        std::swap(i, j);
+    }
+    auto first = indices.begin() + static_cast<std::ptrdiff_t>(offsets[i]);
+    auto last = indices.begin() + static_cast<std::ptrdiff_t>(offsets[i + 1]);
+    auto found = std::lower_bound(first, last, j);
+    if (found == last || *found != j) {
+        return ValueType(0);
+    }
+    return values[static_cast<size_t>(found - indices.begin())];
+}
+
+template<typename ValueType>
+void SparseMatrix<ValueType>::Flip(std::vector<size_t>& flippedOffsets, std::vector<size_t>& flippedIndices,
+                                   std::vector<ValueType>& flippedValues) const {
+    flippedOffsets.assign(LineLength() + 1, 0);
+    for (size_t index : indices) {
+        ++flippedOffsets[index + 1];
+    }
+    std::partial_sum(flippedOffsets.begin(), flippedOffsets.end(), flippedOffsets.begin());
+    flippedIndices.resize(NonZeros());
+    flippedValues.resize(NonZeros());
+    std::vector<size_t> next(flippedOffsets.begin(), flippedOffsets.end() - 1);
+    for (size_t line = 0; line != Lines(); ++line) {
+        for (size_t k = offsets[line]; k != offsets[line + 1]; ++k) {
+            size_t position = next[indices[k]]++;
+            flippedIndices[position] = line;
+            flippedValues[position] = values[k];
+        }
+    }
+}
+
+template<typename ValueType>
+SparseMatrix<ValueType> SparseMatrix<ValueType>::Converted(SparseFormat other) const {
+    if (other == format) {
+        return *this;
+    }
+    SparseMatrix ans(rows, columns, other, {}, {}, {});
+    Flip(ans.offsets, ans.indices, ans.values);
+    return ans;
+}
+
+template<typename ValueType>
+bool SparseMatrix<ValueType>::operator==(const SparseMatrix& other) const {
+    if (Rows() != other.Rows() || Columns() != other.Columns()) {
+        return false;
+    }
+    if (format != other.format) {
+        return *this == other.Converted(format);
+    }
+    return offsets == other.offsets && indices == other.indices && values == other.values;
+}
+
+template<typename ValueType>
+bool SparseMatrix<ValueType>::operator!=(const SparseMatrix& other) const {
+    return !(*this == other);
+}
+
+template<typename ValueType>
+std::vector<ValueType> SparseMatrix<ValueType>::operator*(const std::vector<ValueType>& vector) const {
+    if (Columns() != vector.size()) {
+        THROW(out_of_range, "Can't multiply")
+    }
+    std::vector<ValueType> ans(Rows(), ValueType(0));
+    if (format == SparseFormat::Csc) {
+        // Columns scatter into the same rows, convert once for repeated products
+        for (size_t j = 0; j != Columns(); ++j) {
+            for (size_t k = offsets[j]; k != offsets[j + 1]; ++k) {
+                ans[indices[k]] += values[k] * vector[j];
+            }
+        }
+        return ans;
+    }
+    ForEachLineRange(AverageNonZeros(), [&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            ValueType sum(0);
+            for (size_t k = offsets[i]; k != offsets[i + 1]; ++k) {
+                sum += values[k] * vector[indices[k]];
+            }
+            ans[i] = sum;
+        }
+    });
+    return ans;
+}
+
+template<typename ValueType>
+Matrix<ValueType> SparseMatrix<ValueType>::operator*(const Matrix<ValueType>& other) const {
+    if (Columns() != other.Rows()) {
+        THROW(out_of_range, "Can't multiply")
+    }
+    if (format == SparseFormat::Csc) {
+        return Converted(SparseFormat::Csr) * other;
+    }
+    Matrix<ValueType> ans(Rows(), other.Columns());
+    size_t width = other.Columns();
+    ForEachLineRange(AverageNonZeros() * width, [&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            ValueType* out = ans.Data() + i * ans.Stride();
+            for (size_t k = offsets[i]; k != offsets[i + 1]; ++k) {
+                const ValueType* row = other.Data() + indices[k] * other.Stride();
+                const ValueType value = values[k];
+                for (size_t j = 0; j != width; ++j) {
+                    out[j] += value * row[j];
+                }
+            }
+        }
+    });
+    return ans;
+}
+
+template<typename ValueType>
+SparseMatrix<ValueType> SparseMatrix<ValueType>::MultiplyLines(const SparseMatrix& left, const SparseMatrix& right,
+                                                               size_t width) {
+    constexpr size_t kUnmarked = static_cast<size_t>(-1);
+    size_t lines = left.Lines();
+    std::vector<size_t> offsets(lines + 1, 0);
+    size_t work = left.AverageNonZeros() * right.AverageNonZeros();
+
+    // Symbolic pass: nonzeros of every result line
+    left.ForEachLineRange(work, [&](size_t from, size_t to) {
+        std::vector<size_t> marker(width, kUnmarked);
+        for (size_t i = from; i != to; ++i) {
+            size_t count = 0;
+            for (size_t k = left.offsets[i]; k != left.offsets[i + 1]; ++k) {
+                size_t inner = left.indices[k];
+                for (size_t p = right.offsets[inner]; p != right.offsets[inner + 1]; ++p) {
+                    if (marker[right.indices[p]] != i) {
+                        marker[right.indices[p]] = i;
+                        ++count;
+                    }
+                }
+            }
+            offsets[i + 1] = count;
+        }
+    });
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    // Numeric pass: every line accumulates into a dense row, then its indices are sorted
+    std::vector<size_t> indices(offsets.back());
+    std::vector<ValueType> values(offsets.back());
+    left.ForEachLineRange(work, [&](size_t from, size_t to) {
+        std::vector<size_t> marker(width, kUnmarked);
+        std::vector<ValueType> accumulator(width);
+        for (size_t i = from; i != to; ++i) {
+            size_t position = offsets[i];
+            for (size_t k = left.offsets[i]; k != left.offsets[i + 1]; ++k) {
+                size_t inner = left.indices[k];
+                const ValueType value = left.values[k];
+                for (size_t p = right.offsets[inner]; p != right.offsets[inner + 1]; ++p) {
+                    size_t j = right.indices[p];
+                    if (marker[j] != i) {
+                        marker[j] = i;
+                        indices[position++] = j;
+                        accumulator[j] = value * right.values[p];
+                    } else {
+                        accumulator[j] += value * right.values[p];
+                    }
+                }
+            }
+            auto first = indices.begin() + static_cast<std::ptrdiff_t>(offsets[i]);
+            std::sort(first, indices.begin() + static_cast<std::ptrdiff_t>(position));
+            for (size_t p = offsets[i]; p != position; ++p) {
+                values[p] = accumulator[indices[p]];
+            }
+        }
+    });
+    return {lines, width, SparseFormat::Csr, std::move(offsets), std::move(indices), std::move(values)};
+}
+
+template<typename ValueType>
+SparseMatrix<ValueType> SparseMatrix<ValueType>::operator*(const SparseMatrix& other) const {
+    if (Columns() != other.Rows()) {
+        THROW(out_of_range, "Can't multiply")
+    }
+    if (other.format != format) {
+        return *this * other.Converted(format);
+    }
+    if (format == SparseFormat::Csr) {
+        return MultiplyLines(*this, other, other.Columns());
+    }
+    // (A * B)^T = B^T * A^T, and the CSC arrays of a matrix are the CSR arrays of its transpose
+    SparseMatrix ans = MultiplyLines(other, *this, Rows());
+    std::swap(ans.rows, ans.columns);
+    ans.format = SparseFormat::Csc;
+    return ans;
+}
+
+template<typename ValueType>
+SparseMatrix<ValueType>& SparseMatrix<ValueType>::operator*=(ValueType other) {
+    for (auto& value : values) {
+        value *= other;
+    }
+    return *this;
+}
+
+template<typename ValueType>
+ValueType SparseMatrix<ValueType>::Tr() const {
+    ValueType ans{};
+    for (size_t i = 0; i != std::min(Rows(), Columns()); ++i) {
+        ans += At(i, i);
+    }
+    return ans;
+}
+
+template<typename ValueType>
+SparseMatrix<ValueType> SparseMatrix<ValueType>::Transponed() const {
+    SparseMatrix ans(columns, rows, format, {}, {}, {});
+    Flip(ans.offsets, ans.indices, ans.values);
+    return ans;
+}
+
+template<typename ValueType>
+SparseMatrix<ValueType>& SparseMatrix<ValueType>::Transpone() {
+    *this = Transponed();
+    return *this;
+}
+
+// Dense by sparse, rows of the result are independent
+template<typename ValueType>
+Matrix<ValueType> operator*(const Matrix<ValueType>& first, const SparseMatrix<ValueType>& second) {
+    if (first.Columns() != second.Rows()) {
+        THROW(out_of_range, "Can't multiply")
+    }
+    if (second.Format() == SparseFormat::Csc) {
+        return first * second.Converted(SparseFormat::Csr);
+    }
+    Matrix<ValueType> ans(first.Rows(), second.Columns());
+    const auto& offsets = second.Offsets();
+    const auto& indices = second.Indices();
+    const auto& values = second.Values();
+    size_t work = std::max(first.Columns() + second.NonZeros(), static_cast<size_t>(1));
+    ThreadPool::Instance().ParallelFor(0, first.Rows(), ThreadPool::Instance().MinTaskSize() / work,
+                                       [&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            const ValueType* row = first.Data() + i * first.Stride();
+            ValueType* out = ans.Data() + i * ans.Stride();
+            for (size_t k = 0; k != first.Columns(); ++k) {
+                if (row[k] == ValueType(0)) {
+                    continue;
+                }
+                for (size_t p = offsets[k]; p != offsets[k + 1]; ++p) {
+                    out[indices[p]] += row[k] * values[p];
+                }
+            }
+        }
+    });
+    return ans;
+}
+
+// One "row column value" line per stored element
+template<typename ValueType>
+std::ostream& operator<<(std::ostream& out, const SparseMatrix<ValueType>& mrx) {
+    const auto& offsets = mrx.Offsets();
+    for (size_t line = 0; line + 1 < offsets.size(); ++line) {
+        for (size_t k = offsets[line]; k != offsets[line + 1]; ++k) {
+            size_t index = mrx.Indices()[k];
+            if (mrx.Format() == SparseFormat::Csr) {
+                out << line << ' ' << index << ' ' << mrx.Values()[k] << '\n';
+            } else {
+                out << index << ' ' << line << ' ' << mrx.Values()[k] << '\n';
+            }
+        }
+    }
+    return out;
+}
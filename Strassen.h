@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "Gemm.h"
+#include "MatrixStorage.h"
+#include "ThreadPool.h"
+
+// Strassen-Winograd multiplication of square matrices: 7 half-size products and 15 additions per
+// level instead of 8 products. Recursion stops once blocks are at most StrassenCutoff<ValueType>()
+// wide and falls back to Gemm. Only exact types and double use it by default, float loses too much
+// precision per level.
+template<typename ValueType>
+struct UsesStrassen {
+    static constexpr bool value = std::is_same_v<ValueType, double> ||
+                                  (std::is_integral_v<ValueType> && !std::is_same_v<ValueType, bool>);
+};
+
+// Operands at least this wide go through Strassen, blocks at most this wide go to Gemm
+template<typename ValueType>
+size_t& StrassenCutoff() {
+    static size_t cutoff = std::is_integral_v<ValueType> ? 512 : 2048;
+    return cutoff;
+}
+
+// Recursion levels whose 7 products run concurrently, each of them needs its own workspace
+template<typename ValueType>
+size_t& StrassenParallelLevels() {
+    static size_t levels = 1;
+    return levels;
+}
+
+// out = x + y (x - y when subtract) for h x h blocks
+template<typename ValueType>
+void StrassenCombine(size_t h, const ValueType* x, size_t ldx, const ValueType* y, size_t ldy,
+                     bool subtract, ValueType* out, size_t ldo) {
+    size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / std::max(h, static_cast<size_t>(1)),
+                            static_cast<size_t>(1));
+    ThreadPool::Instance().ParallelFor(0, h, grain, [&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            const ValueType* xRow = x + i * ldx;
+            const ValueType* yRow = y + i * ldy;
+            ValueType* outRow = out + i * ldo;
+            if (subtract) {
+                for (size_t j = 0; j != h; ++j) {
+                    outRow[j] = xRow[j] - yRow[j];
+                }
+            } else {
+                for (size_t j = 0; j != h; ++j) {
+                    outRow[j] = xRow[j] + yRow[j];
+                }
+            }
+        }
+    });
+}
+
+// Elements of workspace needed by StrassenMultiply with these parameters
+inline size_t StrassenWorkspaceSize(size_t n, size_t levels, size_t parallelLevels) {
+    if (levels == 0) {
+        return 0;
+    }
+    size_t h = n / 2;
+    if (parallelLevels == 0) {
+        return 2 * h * h + StrassenWorkspaceSize(h, levels - 1, 0);
+    }
+    return 11 * h * h + 7 * StrassenWorkspaceSize(h, levels - 1, parallelLevels - 1);
+}
+
+// c = a * b for n x n blocks, n must be divisible by 2^levels
+template<typename ValueType>
+void StrassenMultiply(size_t n, const ValueType* a, size_t lda, const ValueType* b, size_t ldb,
+                      ValueType* c, size_t ldc, size_t levels, size_t parallelLevels, ValueType* work) {
+    if (levels == 0) {
+        for (size_t i = 0; i != n; ++i) {
+            std::fill(c + i * ldc, c + i * ldc + n, ValueType(0));
+        }
+        Gemm(n, n, n, ValueType(1), a, lda, static_cast<size_t>(1), b, ldb, static_cast<size_t>(1), c, ldc);
+        return;
+    }
+    size_t h = n / 2;
+    const ValueType *a11 = a, *a12 = a + h, *a21 = a + h * lda, *a22 = a + h * lda + h;
+    const ValueType *b11 = b, *b12 = b + h, *b21 = b + h * ldb, *b22 = b + h * ldb + h;
+    ValueType *c11 = c, *c12 = c + h, *c21 = c + h * ldc, *c22 = c + h * ldc + h;
+    auto add = [h](const ValueType* x, size_t ldx, const ValueType* y, size_t ldy, ValueType* out, size_t ldo) {
+        StrassenCombine(h, x, ldx, y, ldy, false, out, ldo);
+    };
+    auto sub = [h](const ValueType* x, size_t ldx, const ValueType* y, size_t ldy, ValueType* out, size_t ldo) {
+        StrassenCombine(h, x, ldx, y, ldy, true, out, ldo);
+    };
+
+    if (parallelLevels == 0 || ThreadPool::Instance().ThreadCount() == 1) {
+        // Schedule from Boyer, Dumas, Pernet, Zhou: two h x h temporaries, products land in c
+        ValueType* x = work;
+        ValueType* y = work + h * h;
+        ValueType* next = work + 2 * h * h;
+        auto multiply = [&](const ValueType* l, size_t ldl, const ValueType* r, size_t ldr, ValueType* out, size_t ldo) {
+            StrassenMultiply(h, l, ldl, r, ldr, out, ldo, levels - 1, static_cast<size_t>(0), next);
+        };
+        sub(a11, lda, a21, lda, x, h);          // S3
+        sub(b22, ldb, b12, ldb, y, h);          // T3
+        multiply(x, h, y, h, c21, ldc);         // P7
+        add(a21, lda, a22, lda, x, h);          // S1
+        sub(b12, ldb, b11, ldb, y, h);          // T1
+        multiply(x, h, y, h, c22, ldc);         // P5
+        sub(x, h, a11, lda, x, h);              // S2
+        sub(b22, ldb, y, h, y, h);              // T2
+        multiply(x, h, y, h, c12, ldc);         // P6
+        sub(a12, lda, x, h, x, h);              // S4
+        multiply(x, h, b22, ldb, c11, ldc);     // P3
+        multiply(a11, lda, b11, ldb, x, h);     // P1
+        add(x, h, c12, ldc, c12, ldc);          // U2 = P1 + P6
+        add(c12, ldc, c21, ldc, c21, ldc);      // U3 = U2 + P7
+        add(c12, ldc, c22, ldc, c12, ldc);      // U4 = U2 + P5
+        add(c21, ldc, c22, ldc, c22, ldc);      // U7 = U3 + P5
+        add(c12, ldc, c11, ldc, c12, ldc);      // U5 = U4 + P3
+        sub(y, h, b21, ldb, y, h);              // T4
+        multiply(a22, lda, y, h, c11, ldc);     // P4
+        sub(c21, ldc, c11, ldc, c21, ldc);      // U6 = U3 - P4
+        multiply(a12, lda, b21, ldb, c11, ldc); // P2
+        add(x, h, c11, ldc, c11, ldc);          // U1 = P1 + P2
+        return;
+    }
+
+    // All operands are formed first so the seven products can run at once
+    ValueType* s = work;
+    ValueType* t = s + 4 * h * h;
+    ValueType* p = t + 4 * h * h;
+    ValueType* next = p + 3 * h * h;
+    size_t childWork = StrassenWorkspaceSize(h, levels - 1, parallelLevels - 1);
+    ValueType *s1 = s, *s2 = s + h * h, *s3 = s + 2 * h * h, *s4 = s + 3 * h * h;
+    ValueType *t1 = t, *t2 = t + h * h, *t3 = t + 2 * h * h, *t4 = t + 3 * h * h;
+    ValueType *p1 = p, *p3 = p + h * h, *p4 = p + 2 * h * h;
+    add(a21, lda, a22, lda, s1, h);
+    sub(s1, h, a11, lda, s2, h);
+    sub(a11, lda, a21, lda, s3, h);
+    sub(a12, lda, s2, h, s4, h);
+    sub(b12, ldb, b11, ldb, t1, h);
+    sub(b22, ldb, t1, h, t2, h);
+    sub(b22, ldb, b12, ldb, t3, h);
+    sub(t2, h, b21, ldb, t4, h);
+
+    struct Product {
+        const ValueType* left;
+        size_t ldl;
+        const ValueType* right;
+        size_t ldr;
+        ValueType* out;
+        size_t ldo;
+    };
+    const Product products[7] = {
+        {a11, lda, b11, ldb, p1, h},
+        {a12, lda, b21, ldb, c11, ldc},
+        {s4, h, b22, ldb, p3, h},
+        {a22, lda, t4, h, p4, h},
+        {s1, h, t1, h, c22, ldc},
+        {s2, h, t2, h, c12, ldc},
+        {s3, h, t3, h, c21, ldc}
+    };
+    ThreadPool::Instance().ParallelFor(0, 7, 1, [&](size_t from, size_t to) {
+        for (size_t i = from; i != to; ++i) {
+            const Product& product = products[i];
+            StrassenMultiply(h, product.left, product.ldl, product.right, product.ldr,
+                             product.out, product.ldo, levels - 1, parallelLevels - 1, next + i * childWork);
+        }
+    });
+
+    add(c11, ldc, p1, h, c11, ldc);   // U1 = P1 + P2
+    add(c12, ldc, p1, h, c12, ldc);   // U2 = P1 + P6
+    add(c21, ldc, c12, ldc, c21, ldc); // U3 = U2 + P7
+    add(c12, ldc, c22, ldc, c12, ldc); // U4 = U2 + P5
+    add(c21, ldc, c22, ldc, c22, ldc); // U7 = U3 + P5
+    add(c12, ldc, p3, h, c12, ldc);   // U5 = U4 + P3
+    sub(c21, ldc, p4, h, c21, ldc);   // U6 = U3 - P4
+}
+
+// c = a * b for n x n row-major matrices, all scratch memory is allocated up front
+template<typename ValueType>
+void Strassen(size_t n, const ValueType* a, size_t lda, const ValueType* b, size_t ldb, ValueType* c, size_t ldc) {
+    size_t cutoff = std::max(StrassenCutoff<ValueType>(), static_cast<size_t>(1));
+    size_t levels = 0;
+    while ((n >> levels) > cutoff) {
+        ++levels;
+    }
+    size_t block = ((n - 1) >> levels) + 1;
+    size_t padded = block << levels;
+    size_t parallelLevels = ThreadPool::Instance().ThreadCount() == 1 ? 0 :
+                            std::min(StrassenParallelLevels<ValueType>(), levels);
+    ArenaScope scope;
+    std::vector<ValueType, ArenaAllocator<ValueType>> work(StrassenWorkspaceSize(padded, levels, parallelLevels));
+    if (padded == n) {
+        StrassenMultiply(n, a, lda, b, ldb, c, ldc, levels, parallelLevels, work.data());
+        return;
+    }
+
+    // Zero padding up to a multiple of 2^levels, only the border is wasted work
+    std::vector<ValueType, ArenaAllocator<ValueType>> buffers(3 * padded * padded, ValueType(0));
+    ValueType* paddedA = buffers.data();
+    ValueType* paddedB = paddedA + padded * padded;
+    ValueType* paddedC = paddedB + padded * padded;
+    for (size_t i = 0; i != n; ++i) {
+        std::copy(a + i * lda, a + i * lda + n, paddedA + i * padded);
+        std::copy(b + i * ldb, b + i * ldb + n, paddedB + i * padded);
+    }
+    StrassenMultiply(padded, paddedA, padded, paddedB, padded, paddedC, padded, levels, parallelLevels, work.data());
+    for (size_t i = 0; i != n; ++i) {
+        std::copy(paddedC + i * padded, paddedC + i * padded + n, c + i * ldc);
+    }
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MatrixProfiler.h"
+
+// Process-wide work-stealing pool, started on first use.
+// Every worker owns a deque: it takes its own tasks from the back and steals from the front of
+// the others. A thread waiting in ParallelFor runs queued tasks instead of sleeping, so nested
+// parallel regions (a parallel task calling ParallelFor again) can't deadlock.
+class ThreadPool {
+ public:
+    static ThreadPool& Instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        Stop();
+    }
+
+    // Threads taking part in ParallelFor, the calling one included
+    [[nodiscard]] size_t ThreadCount() const {
+        return threadCount;
+    }
+
+    // Not safe while ParallelFor is running somewhere, workers are restarted lazily
+    void SetThreadCount(size_t count) {
+        Stop();
+        threadCount = std::max(count, static_cast<size_t>(1));
+    }
+
+    // Callers shouldn't split work into tasks smaller than this (in elements touched)
+    [[nodiscard]] size_t MinTaskSize() const {
+        return minTaskSize;
+    }
+
+    void SetMinTaskSize(size_t size) {
+        minTaskSize = std::max(size, static_cast<size_t>(1));
+    }
+
+    // Calls function(from, to) on disjoint subranges covering [first, last), at least grain long.
+    // Runs inline when the range is shorter than two grains or the pool has one thread.
+    // The first exception thrown by any chunk is rethrown here after all chunks finished.
+    template<typename Function>
+    void ParallelFor(size_t first, size_t last, size_t grain, Function&& function);
+
+ private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    static constexpr size_t kNotWorker = static_cast<size_t>(-1);
+    static constexpr size_t kChunksPerThread = 4;
+
+    ThreadPool() : threadCount(std::max(std::thread::hardware_concurrency(), 1u)) {}
+
+    static size_t& WorkerIndex() {
+        thread_local size_t index = kNotWorker;
+        return index;
+    }
+
+    void Start();
+
+    void Stop();
+
+    void Submit(std::function<void()> task);
+
+    bool RunOne();
+
+    void WorkerLoop(size_t index);
+
+    size_t threadCount;
+    size_t minTaskSize = 1 << 14;
+
+    std::mutex startMutex;
+    std::atomic<bool> started{false};
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue{0};
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    std::atomic<size_t> queued{0};
+    bool stopping = false;
+};
+
+inline void ThreadPool::Start() {
+    std::lock_guard lock(startMutex);
+    if (started.load()) {
+        return;
+    }
+    stopping = false;
+    size_t count = threadCount - 1;
+    queues.clear();
+    for (size_t i = 0; i != count; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i != count; ++i) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+    started.store(true);
+}
+
+inline void ThreadPool::Stop() {
+    std::lock_guard lock(startMutex);
+    if (!started.load()) {
+        return;
+    }
+    {
+        std::lock_guard sleepLock(sleepMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    started.store(false);
+}
+
+inline void ThreadPool::Submit(std::function<void()> task) {
+    size_t index = WorkerIndex();
+    if (index == kNotWorker) {
+        index = nextQueue.fetch_add(1) % queues.size();
+    }
+    {
+        std::lock_guard lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1);
+    {
+        std::lock_guard lock(sleepMutex);
+    }
+    wakeUp.notify_one();
+}
+
+inline bool ThreadPool::RunOne() {
+    size_t self = WorkerIndex();
+    std::function<void()> task;
+    if (self != kNotWorker) {
+        std::lock_guard lock(queues[self]->mutex);
+        if (!queues[self]->tasks.empty()) {
+            task = std::move(queues[self]->tasks.back());
+            queues[self]->tasks.pop_back();
+        }
+    }
+    size_t start = self == kNotWorker ? 0 : self + 1;
+    for (size_t i = 0; !task && i != queues.size(); ++i) {
+        Queue& victim = *queues[(start + i) % queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    queued.fetch_sub(1);
+    task();
+    return true;
+}
+
+inline void ThreadPool::WorkerLoop(size_t index) {
+    WorkerIndex() = index;
+    while (true) {
+        if (RunOne()) {
+            continue;
+        }
+        std::unique_lock lock(sleepMutex);
+        wakeUp.wait(lock, [this] { return stopping || queued.load() != 0; });
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+template<typename Function>
+void ThreadPool::ParallelFor(size_t first, size_t last, size_t grain, Function&& function) {
+    if (first >= last) {
+        return;
+    }
+    size_t count = last - first;
+    grain = std::max(grain, static_cast<size_t>(1));
+#ifdef MATRIX_PROFILING
+    ProfileScope* profile = ProfileScope::Current();
+    auto regionStart = ProfileScope::Clock::now();
+#endif
+    if (threadCount == 1 || count / grain < 2) {
+        function(first, last);
+#ifdef MATRIX_PROFILING
+        if (profile) {
+            uint64_t elapsed = ProfileScope::Nanoseconds(regionStart);
+            profile->Counters().AddRegion(1, 1, elapsed, elapsed);
+        }
+#endif
+        return;
+    }
+    if (!started.load()) {
+        Start();
+    }
+
+    // Rounded down, so evenly split chunks are never shorter than grain
+    size_t chunks = std::min(count / grain, threadCount * kChunksPerThread);
+    std::atomic<size_t> remaining(chunks);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+#ifdef MATRIX_PROFILING
+    // Bit per thread that ran a chunk (worker index + 1, the caller is 0) and their total time
+    std::atomic<uint64_t> threadMask(0);
+    std::atomic<uint64_t> busy(0);
+#endif
+    auto runChunk = [&](size_t chunk) {
+#ifdef MATRIX_PROFILING
+        auto chunkStart = ProfileScope::Clock::now();
+        threadMask.fetch_or(uint64_t(1) << (WorkerIndex() + 1) % 64, std::memory_order_relaxed);
+#endif
+        try {
+            function(first + count * chunk / chunks, first + count * (chunk + 1) / chunks);
+        } catch (...) {
+            std::lock_guard lock(errorMutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+#ifdef MATRIX_PROFILING
+        busy.fetch_add(ProfileScope::Nanoseconds(chunkStart), std::memory_order_relaxed);
+#endif
+        remaining.fetch_sub(1);
+    };
+
+    for (size_t chunk = 1; chunk != chunks; ++chunk) {
+        Submit([&runChunk, chunk] { runChunk(chunk); });
+    }
+    runChunk(0);
+    while (remaining.load() != 0) {
+        if (!RunOne()) {
+            std::this_thread::yield();
+        }
+    }
+#ifdef MATRIX_PROFILING
+    if (profile) {
+        profile->Counters().AddRegion(chunks, __builtin_popcountll(threadMask.load()),
+                                      ProfileScope::Nanoseconds(regionStart), busy.load());
+    }
+#endif
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
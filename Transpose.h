@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "MatrixSimd.h"
+#include "ThreadPool.h"
+
+// Cache-oblivious transposition: blocks are halved along the longer side until they fit in L1,
+// then moved with in-register 4x4 (double) / 8x8 (float) transposes where the CPU allows.
+
+constexpr size_t kTransposeBlock = 32;
+
+// Splits n roughly in half, keeping the first part a multiple of 8 so SIMD tiles stay whole
+inline size_t TransposeSplit(size_t n) {
+    size_t half = n / 2;
+    return half >= 8 ? half / 8 * 8 : half;
+}
+
+// dst = src^T for a small rows x cols block
+template<typename ValueType>
+void TransposeTile(size_t rows, size_t cols, const ValueType* src, size_t lds, ValueType* dst, size_t ldd) {
+    const SimdKernels<ValueType>& simd = SimdKernels<ValueType>::Get();
+    size_t fullRows = 0, fullCols = 0;
+    if (simd.transpose != nullptr) {
+        fullRows = rows / simd.tile * simd.tile;
+        fullCols = cols / simd.tile * simd.tile;
+        for (size_t i = 0; i != fullRows; i += simd.tile) {
+            for (size_t j = 0; j != fullCols; j += simd.tile) {
+                simd.transpose(src + i * lds + j, lds, dst + j * ldd + i, ldd);
+            }
+        }
+    }
+    for (size_t i = 0; i != rows; ++i) {
+        for (size_t j = i < fullRows ? fullCols : 0; j != cols; ++j) {
+            dst[j * ldd + i] = src[i * lds + j];
+        }
+    }
+}
+
+template<typename ValueType>
+void TransposeRecursive(size_t rows, size_t cols, const ValueType* src, size_t lds, ValueType* dst, size_t ldd) {
+    if (rows <= kTransposeBlock && cols <= kTransposeBlock) {
+        return TransposeTile(rows, cols, src, lds, dst, ldd);
+    }
+    if (rows >= cols) {
+        size_t half = TransposeSplit(rows);
+        TransposeRecursive(half, cols, src, lds, dst, ldd);
+        TransposeRecursive(rows - half, cols, src + half * lds, lds, dst + half, ldd);
+    } else {
+        size_t half = TransposeSplit(cols);
+        TransposeRecursive(rows, half, src, lds, dst, ldd);
+        TransposeRecursive(rows, cols - half, src + half, lds, dst + half * ldd, ldd);
+    }
+}
+
+// dst (cols x rows) = src (rows x cols)^T, bands of src rows go to different threads
+template<typename ValueType>
+void Transpose(size_t rows, size_t cols, const ValueType* src, size_t lds, ValueType* dst, size_t ldd) {
+    size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / std::max(cols, static_cast<size_t>(1)),
+                            kTransposeBlock);
+    ThreadPool::Instance().ParallelFor(0, rows, grain, [&](size_t from, size_t to) {
+        TransposeRecursive(to - from, cols, src + from * lds, lds, dst + from, ldd);
+    });
+}
+
+// Exchanges x (rows x cols) with y^T (y is cols x rows), both inside the same matrix
+template<typename ValueType>
+void TransposeSwap(size_t rows, size_t cols, ValueType* x, ValueType* y, size_t ld) {
+    if (rows > kTransposeBlock || cols > kTransposeBlock) {
+        if (rows >= cols) {
+            size_t half = TransposeSplit(rows);
+            TransposeSwap(half, cols, x, y, ld);
+            TransposeSwap(rows - half, cols, x + half * ld, y + half, ld);
+        } else {
+            size_t half = TransposeSplit(cols);
+            TransposeSwap(rows, half, x, y, ld);
+            TransposeSwap(rows, cols - half, x + half, y + half * ld, ld);
+        }
+        return;
+    }
+    const SimdKernels<ValueType>& simd = SimdKernels<ValueType>::Get();
+    if (simd.transpose != nullptr && rows % simd.tile == 0 && cols % simd.tile == 0) {
+        ValueType buffer[kTransposeBlock * kTransposeBlock];
+        TransposeTile(rows, cols, x, ld, buffer, rows);
+        TransposeTile(cols, rows, y, ld, x, ld);
+        for (size_t i = 0; i != cols; ++i) {
+            std::copy(buffer + i * rows, buffer + (i + 1) * rows, y + i * ld);
+        }
+        return;
+    }
+    for (size_t i = 0; i != rows; ++i) {
+        for (size_t j = 0; j != cols; ++j) {
+            std::swap(x[i * ld + j], y[j * ld + i]);
+        }
+    }
+}
+
+// In-place transposition of an n x n block, the diagonal blocks and the pairs of mirrored
+// off-diagonal blocks in one block row form a task
+template<typename ValueType>
+void TransposeSquareInPlace(size_t n, ValueType* data, size_t ld) {
+    constexpr size_t block = 2 * kTransposeBlock;
+    size_t blocks = (n + block - 1) / block;
+    ThreadPool::Instance().ParallelFor(0, blocks, 1, [&](size_t from, size_t to) {
+        for (size_t bi = from; bi != to; ++bi) {
+            size_t i = bi * block;
+            size_t height = std::min(block, n - i);
+            ValueType* diagonal = data + i * ld + i;
+            for (size_t r = 0; r != height; ++r) {
+                for (size_t c = r + 1; c != height; ++c) {
+                    std::swap(diagonal[r * ld + c], diagonal[c * ld + r]);
+                }
+            }
+            if (i + height != n) {
+                TransposeSwap(height, n - i - height, diagonal + height, diagonal + height * ld, ld);
+            }
+        }
+    });
+}
+
+// In-place transposition of a dense rows x cols matrix. Square ones are swapped block by block,
+// rectangular ones follow the cycles of k -> k * rows mod (N - 1), one bit of bookkeeping per element.
+template<typename ValueType>
+void TransposeInPlace(size_t rows, size_t cols, ValueType* data) {
+    if (rows == cols) {
+        return TransposeSquareInPlace(rows, data, cols);
+    }
+    size_t count = rows * cols;
+    if (rows == 1 || cols == 1) {
+        return;
+    }
+    size_t modulus = count - 1;
+    std::vector<bool> visited(count);
+    for (size_t start = 1; start != modulus; ++start) {
+        if (visited[start]) {
+            continue;
+        }
+        ValueType value = std::move(data[start]);
+        size_t position = start;
+        do {
+            position = static_cast<size_t>(static_cast<unsigned __int128>(position) * rows % modulus);
+            std::swap(value, data[position]);
+            visited[position] = true;
+        } while (position != start);
+    }
+}
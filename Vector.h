@@ -0,0 +1,344 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "Matrix.h"
+#include "MatrixSimd.h"
+#include "MatrixStorage.h"
+#include "Reduction.h"
+#include "ThreadPool.h"
+
+// Dense vector with the same aligned contiguous storage as Matrix, plus the level-1/2 kernels
+// (dot, axpy, norm, GEMV, GEVM). All of them stream memory once, so they are split over the
+// pool in chunks of at least MinTaskSize() elements and run the SIMD kernels from MatrixSimd.h.
+
+// Columns of a GEVM chunk processed against all rows before moving on, keeps that part of y in L1
+constexpr size_t kGevmColumnBlock = 2048;
+
+template<typename ValueType = double>
+class Vector {
+ public:
+    using container_type = std::vector<ValueType, AlignedAllocator<ValueType>>;
+    using value_type = ValueType;
+    using iterator = ValueType*;
+    using const_iterator = const ValueType*;
+
+    explicit Vector(size_t size = 0, ValueType value = ValueType());
+
+    Vector(std::initializer_list<ValueType> values);
+
+    explicit Vector(const std::vector<ValueType>& values);
+
+    [[nodiscard]] bool empty() const;
+
+    [[nodiscard]] size_t size() const;
+
+    ValueType* Data();
+
+    const ValueType* Data() const;
+
+    iterator begin();
+
+    const_iterator begin() const;
+
+    iterator end();
+
+    const_iterator end() const;
+
+    ValueType& operator[](size_t idx);
+
+    const ValueType& operator[](size_t idx) const;
+
+    bool operator==(const Vector& other) const;
+
+    bool operator!=(const Vector& other) const;
+
+    Vector operator-() const;
+
+    Vector& operator+=(const Vector& other);
+
+    Vector& operator-=(const Vector& other);
+
+    Vector& operator*=(ValueType other);
+
+    Vector& operator/=(ValueType other);
+
+    // this += alpha * x
+    Vector& Axpy(ValueType alpha, const Vector& x);
+
+    // Summed in fixed blocks merged in index order, so the result doesn't depend on the thread count
+    ValueType Dot(const Vector& other) const;
+
+    // Euclidean norm. Floating point vectors whose sum of squares overflows or underflows are
+    // rescaled by their largest magnitude first.
+    ValueType Norm() const;
+ private:
+    container_type contents;
+};
+
+template<typename ValueType>
+Vector<ValueType>::Vector(size_t size, ValueType value) : contents(size, value) {}
+
+template<typename ValueType>
+Vector<ValueType>::Vector(std::initializer_list<ValueType> values) : contents(values.begin(), values.end()) {}
+
+template<typename ValueType>
+Vector<ValueType>::Vector(const std::vector<ValueType>& values) : contents(values.begin(), values.end()) {}
+
+template<typename ValueType>
+bool Vector<ValueType>::empty() const {
+    return contents.empty();
+}
+
+template<typename ValueType>
+size_t Vector<ValueType>::size() const {
+    return contents.size();
+}
+
+template<typename ValueType>
+ValueType* Vector<ValueType>::Data() {
+    return contents.data();
+}
+
+template<typename ValueType>
+const ValueType* Vector<ValueType>::Data() const {
+    return contents.data();
+}
+
+template<typename ValueType>
+typename Vector<ValueType>::iterator Vector<ValueType>::begin() {
+    return Data();
+}
+
+template<typename ValueType>
+typename Vector<ValueType>::const_iterator Vector<ValueType>::begin() const {
+    return Data();
+}
+
+template<typename ValueType>
+typename Vector<ValueType>::iterator Vector<ValueType>::end() {
+    return Data() + size();
+}
+
+template<typename ValueType>
+typename Vector<ValueType>::const_iterator Vector<ValueType>::end() const {
+    return Data() + size();
+}
+
+template<typename ValueType>
+ValueType& Vector<ValueType>::operator[](size_t idx) {
+    return contents[idx];
+}
+
+template<typename ValueType>
+const ValueType& Vector<ValueType>::operator[](size_t idx) const {
+    return contents[idx];
+}
+
+template<typename ValueType>
+bool Vector<ValueType>::operator==(const Vector& other) const {
+    return contents == other.contents;
+}
+
+template<typename ValueType>
+bool Vector<ValueType>::operator!=(const Vector& other) const {
+    return !(*this == other);
+}
+
+template<typename ValueType>
+Vector<ValueType> Vector<ValueType>::operator-() const {
+    Vector ans(*this);
+    return ans *= ValueType(-1);
+}
+
+template<typename ValueType>
+Vector<ValueType>& Vector<ValueType>::operator+=(const Vector& other) {
+    if (size() != other.size()) {
+        THROW(out_of_range, "Vectors differ in size")
+    }
+    VectorAdd(Data(), other.Data(), size());
+    return *this;
+}
+
+template<typename ValueType>
+Vector<ValueType>& Vector<ValueType>::operator-=(const Vector& other) {
+    if (size() != other.size()) {
+        THROW(out_of_range, "Vectors differ in size")
+    }
+    VectorSubtract(Data(), other.Data(), size());
+    return *this;
+}
+
+template<typename ValueType>
+Vector<ValueType>& Vector<ValueType>::operator*=(ValueType other) {
+    VectorMultiply(Data(), other, size());
+    return *this;
+}
+
+template<typename ValueType>
+Vector<ValueType>& Vector<ValueType>::operator/=(ValueType other) {
+    VectorDivide(Data(), other, size());
+    return *this;
+}
+
+template<typename ValueType>
+Vector<ValueType>& Vector<ValueType>::Axpy(ValueType alpha, const Vector& x) {
+    if (size() != x.size()) {
+        THROW(out_of_range, "Vectors differ in size")
+    }
+    ThreadPool::Instance().ParallelFor(0, size(), ThreadPool::Instance().MinTaskSize(), [&](size_t from, size_t to) {
+        VectorAxpy(Data() + from, alpha, x.Data() + from, to - from);
+    });
+    return *this;
+}
+
+template<typename ValueType>
+ValueType Vector<ValueType>::Dot(const Vector& other) const {
+    if (size() != other.size()) {
+        THROW(out_of_range, "Vectors differ in size")
+    }
+    return ReduceBlocks(size(), kReductionBlock, ValueType(), [&](size_t from, size_t to) {
+        return VectorDot(Data() + from, other.Data() + from, to - from);
+    }, [](ValueType first, ValueType second) { return first + second; });
+}
+
+template<typename ValueType>
+ValueType Vector<ValueType>::Norm() const {
+    using std::sqrt;
+    ValueType squares = Dot(*this);
+    if constexpr (std::is_floating_point_v<ValueType>) {
+        using Limits = std::numeric_limits<ValueType>;
+        if (squares == ValueType() || !(squares < Limits::max() && squares > Limits::min() / Limits::epsilon())) {
+            using std::abs;
+            using std::max;
+            ValueType scale = ReduceBlocks(size(), kReductionBlock, ValueType(), [&](size_t from, size_t to) {
+                ValueType ans = ValueType();
+                for (size_t i = from; i != to; ++i) {
+                    ans = max(ans, abs(contents[i]));
+                }
+                return ans;
+            }, [](ValueType first, ValueType second) { return max(first, second); });
+            if (scale == ValueType() || !(scale <= Limits::max())) {
+                return scale;
+            }
+            squares = ReduceBlocks(size(), kReductionBlock, ValueType(), [&](size_t from, size_t to) {
+                ValueType ans = ValueType();
+                for (size_t i = from; i != to; ++i) {
+                    ValueType scaled = contents[i] / scale;
+                    ans += scaled * scaled;
+                }
+                return ans;
+            }, [](ValueType first, ValueType second) { return first + second; });
+            return scale * sqrt(squares);
+        }
+    }
+    return sqrt(squares);
+}
+
+template<typename ValueType>
+Vector<ValueType> operator+(Vector<ValueType> first, const Vector<ValueType>& second) {
+    return first += second;
+}
+
+template<typename ValueType>
+Vector<ValueType> operator-(Vector<ValueType> first, const Vector<ValueType>& second) {
+    return first -= second;
+}
+
+template<typename ValueType>
+Vector<ValueType> operator*(Vector<ValueType> first, ValueType second) {
+    return first *= second;
+}
+
+template<typename ValueType>
+Vector<ValueType> operator*(ValueType first, Vector<ValueType> second) {
+    return second *= first;
+}
+
+template<typename ValueType>
+Vector<ValueType> operator/(Vector<ValueType> first, ValueType second) {
+    return first /= second;
+}
+
+template<typename ValueType>
+ValueType Dot(const Vector<ValueType>& first, const Vector<ValueType>& second) {
+    return first.Dot(second);
+}
+
+template<typename ValueType>
+ValueType Norm(const Vector<ValueType>& vector) {
+    return vector.Norm();
+}
+
+// y = a * x for a rows x columns matrix with rows lda apart. Each task takes a strip of rows and
+// walks it kDotRows rows at a time, so every loaded element of x feeds several FMAs.
+template<typename ValueType>
+void Gemv(size_t rows, size_t columns, const ValueType* a, size_t lda, const ValueType* x, ValueType* y) {
+    size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / std::max(columns, static_cast<size_t>(1)),
+                            kDotRows);
+    ThreadPool::Instance().ParallelFor(0, rows, grain, [&](size_t from, size_t to) {
+        size_t i = from;
+        for (; i + kDotRows <= to; i += kDotRows) {
+            VectorDotRows(a + i * lda, lda, x, columns, y + i);
+        }
+        for (; i != to; ++i) {
+            y[i] = VectorDot(a + i * lda, x, columns);
+        }
+    });
+}
+
+// y = x * a, i.e. a^T x without transposing. Tasks own disjoint column ranges and add the rows
+// of a scaled by x[i] into their part of y, kDotRows rows per pass, so no partial results have
+// to be merged.
+template<typename ValueType>
+void Gevm(size_t rows, size_t columns, const ValueType* x, const ValueType* a, size_t lda, ValueType* y) {
+    std::fill(y, y + columns, ValueType());
+    size_t grain = std::max(ThreadPool::Instance().MinTaskSize() / std::max(rows, static_cast<size_t>(1)),
+                            static_cast<size_t>(64));
+    ThreadPool::Instance().ParallelFor(0, columns, grain, [&](size_t from, size_t to) {
+        for (size_t begin = from; begin < to; begin += kGevmColumnBlock) {
+            size_t width = std::min(kGevmColumnBlock, to - begin);
+            size_t i = 0;
+            for (; i + kDotRows <= rows; i += kDotRows) {
+                VectorAxpyRows(y + begin, x + i, a + i * lda + begin, lda, width);
+            }
+            for (; i != rows; ++i) {
+                VectorAxpy(y + begin, x[i], a + i * lda + begin, width);
+            }
+        }
+    });
+}
+
+template<typename ValueType>
+Vector<ValueType> operator*(const Matrix<ValueType>& matrix, const Vector<ValueType>& vector) {
+    if (matrix.Columns() != vector.size()) {
+        THROW(out_of_range, "Can't multiply")
+    }
+    Vector<ValueType> ans(matrix.Rows());
+    Gemv(matrix.Rows(), matrix.Columns(), matrix.Data(), matrix.Stride(), vector.Data(), ans.Data());
+    return ans;
+}
+
+template<typename ValueType>
+Vector<ValueType> operator*(const Vector<ValueType>& vector, const Matrix<ValueType>& matrix) {
+    if (matrix.Rows() != vector.size()) {
+        THROW(out_of_range, "Can't multiply")
+    }
+    Vector<ValueType> ans(matrix.Columns());
+    Gevm(matrix.Rows(), matrix.Columns(), vector.Data(), matrix.Data(), matrix.Stride(), ans.Data());
+    return ans;
+}
+
+template<typename ValueType>
+std::ostream& operator<<(std::ostream& out, const Vector<ValueType>& vector) {
+    for (const ValueType& i : vector) {
+        out << i << ' ';
+    }
+    return out << '\n';
+}
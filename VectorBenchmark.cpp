@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Matrix.h"
+#include "Vector.h"
+
+// Usage: VectorBenchmark [sizes...] [--simd=scalar|avx2|avx512]
+// Prints the memory bandwidth of Matrix * Vector (GEMV), Vector * Matrix (GEVM) and the old
+// Matrix * (n x 1 Matrix) product on n x n double matrices, next to a STREAM-style
+// triad a = b + s * c on arrays of the same size as the upper bound.
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (!ParseSimdFlag(arg)) {
+            sizes.push_back(std::stoul(arg));
+        }
+    }
+    if (sizes.empty()) {
+        sizes = {256, 1024, 4096, 8192};
+    }
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    std::cout << std::setw(6) << "n" << std::setw(10) << "triad" << std::setw(10) << "gemv" << std::setw(10)
+              << "gevm" << std::setw(10) << "n x 1" << "   (GB/s)\n";
+    for (size_t n : sizes) {
+        Matrix<double> a(n, n), column(n, 1);
+        Vector<double> x(n), y(n);
+        for (size_t i = 0; i != n; ++i) {
+            for (size_t j = 0; j != n; ++j) {
+                a[i][j] = dist(rng);
+            }
+            x[i] = dist(rng);
+            column[i][0] = x[i];
+        }
+        // About 2^31 bytes streamed per measurement
+        size_t repeats = std::max((static_cast<size_t>(1) << 28) / (n * n), static_cast<size_t>(1));
+        double bytes = 8.0 * n * n;
+
+        std::vector<double> b(a.Data(), a.Data() + n * n), c(b), triad(n * n);
+        double triadTime = Seconds([&] {
+            ThreadPool::Instance().ParallelFor(0, n * n, ThreadPool::Instance().MinTaskSize(),
+                                               [&](size_t from, size_t to) {
+                for (size_t i = from; i != to; ++i) {
+                    triad[i] = b[i] + 3.0 * c[i];
+                }
+            });
+        }, repeats);
+        double gemvTime = Seconds([&] { y = a * x; }, repeats);
+        double gevmTime = Seconds([&] { y = x * a; }, repeats);
+        Matrix<double> product(n, 1);
+        double columnTime = Seconds([&] { product = a * column; }, std::max(repeats / 8, static_cast<size_t>(1)));
+
+        std::cout << std::setw(6) << n << std::fixed << std::setprecision(2)
+                  << std::setw(10) << 3 * bytes / triadTime * 1e-9
+                  << std::setw(10) << bytes / gemvTime * 1e-9
+                  << std::setw(10) << bytes / gevmTime * 1e-9
+                  << std::setw(10) << bytes / columnTime * 1e-9 << '\n';
+    }
+}